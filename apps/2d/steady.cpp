@@ -29,7 +29,9 @@
 #include "Init.h"
 #include "MatrixHelper2d.h"
 #include "PatchSolvers/DftPatchSolver.h"
+#include "PatchSolvers/FacrPatchSolver.h"
 #include "PatchSolvers/FftwPatchSolver.h"
+#include "PatchSolvers/PatchSolverFactory.h"
 #include "PatchSolvers/FishpackPatchSolver.h"
 #include "PolyChebPrec.h"
 #include "QuadInterpolator.h"
@@ -161,6 +163,14 @@ int main(int argc, char *argv[])
 #endif
 	args::Flag f_cheb(parser, "", "cheb preconditioner", {"cheb"});
 	args::Flag f_dft(parser, "", "dft", {"dft"});
+	args::Flag f_facr(parser, "", "use the FACR patch solver", {"facr"});
+	args::ValueFlag<string> f_wisdom(parser, "prefix",
+	                                 "load and save fftw wisdom from files with this prefix",
+	                                 {"wisdom"});
+	args::Flag f_autotune(parser, "", "time the patch solvers and use the fastest", {"autotune"});
+	args::ValueFlag<string> f_autotune_cache(parser, "file_name",
+	                                         "cache the autotuned patch solver in this file",
+	                                         {"autotune_cache"});
 
 	int num_procs;
 	MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
@@ -285,14 +295,30 @@ int main(int argc, char *argv[])
 		nfuny = [](double x, double y) { return M_PI * cosl(M_PI * y) * cosl(2 * M_PI * x); };
 	}
 
+	Tools::Timer timer;
+
+	// shared fftw wisdom
+	shared_ptr<FftwWisdom> wisdom;
+	if (f_wisdom) {
+		wisdom.reset(new FftwWisdom(args::get(f_wisdom), n, 2));
+		wisdom->load(MPI_COMM_WORLD);
+	}
+
 	// set the patch solver
 	shared_ptr<PatchSolver<2>> p_solver;
 	if (f_dft) {
 		p_solver.reset(new DftPatchSolver<2>(*dc));
+	} else if (f_facr) {
+		p_solver.reset(new FacrPatchSolver<2>(*dc, 0, wisdom));
+	} else if (f_autotune) {
+		PatchSolverFactory<2> factory(f_autotune_cache ? args::get(f_autotune_cache) : "",
+		                              &timer);
+		factory.setWisdom(wisdom);
+		p_solver = factory.getSolver(*dc);
 	} else if (f_fish) {
 		//	p_solver.reset(new FishpackPatchSolver());
 	} else {
-		p_solver.reset(new FftwPatchSolver<2>(*dc));
+		p_solver.reset(new FftwPatchSolver<2>(*dc, 0, wisdom));
 	}
 
 	// patch operator
@@ -309,7 +335,6 @@ int main(int argc, char *argv[])
 #ifdef ENABLE_MUELU_CUDA
 	if (f_meulucuda) { MueLuCudaWrapper::initialize(); }
 #endif
-	Tools::Timer timer;
 	for (int loop = 0; loop < loop_count; loop++) {
 		timer.start("Domain Initialization");
 
@@ -608,6 +633,7 @@ int main(int argc, char *argv[])
 #ifdef ENABLE_MUELU_CUDA
 	if (f_meulucuda) { MueLuCudaWrapper::finalize(); }
 #endif
+	if (wisdom != nullptr) { wisdom->save(MPI_COMM_WORLD); }
 	if (my_global_rank == 0) { cout << timer; }
 	PetscFinalize();
 	return 0;
@@ -27,7 +27,9 @@
 #include "MatrixHelper.h"
 #include "OctTree.h"
 #include "PatchSolvers/DftPatchSolver.h"
+#include "PatchSolvers/FacrPatchSolver.h"
 #include "PatchSolvers/FftwPatchSolver.h"
+#include "PatchSolvers/PatchSolverFactory.h"
 #include "PolyChebPrec.h"
 #include "SchurHelper.h"
 #include "SchurMatrixHelper.h"
@@ -156,12 +158,26 @@ int main(int argc, char *argv[])
 	                                    {"muelucuda"});
 #endif
 	args::Flag              f_scharz(parser, "", "use schwarz preconditioner", {"schwarz"});
+#ifdef HAVE_FFTWF
+	args::Flag f_single_schwarz(parser, "",
+	                            "use single precision patch solves in the schwarz preconditioner",
+	                            {"single_schwarz"});
+#endif
 	args::ValueFlag<string> f_gmg(parser, "config_file", "use GMG preconditioner", {"gmg"});
 	args::Flag              f_cfft(parser, "", "use GMG preconditioner", {"cfft"});
 	args::Flag              f_pbm(parser, "", "use GMG preconditioner", {"pbm"});
 	args::Flag              f_ibd(parser, "", "use GMG preconditioner", {"ibd"});
 	args::Flag              f_cheb(parser, "", "cheb preconditioner", {"cheb"});
 	args::Flag              f_dft(parser, "", "dft", {"dft"});
+	args::Flag              f_facr(parser, "", "use the FACR patch solver", {"facr"});
+	args::ValueFlag<string> f_wisdom(parser, "prefix",
+	                                 "load and save fftw wisdom from files with this prefix",
+	                                 {"wisdom"});
+	args::Flag              f_autotune(parser, "", "time the patch solvers and use the fastest",
+                          {"autotune"});
+	args::ValueFlag<string> f_autotune_cache(parser, "file_name",
+	                                         "cache the autotuned patch solver in this file",
+	                                         {"autotune_cache"});
 
 	int num_procs;
 	MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
@@ -289,7 +305,19 @@ int main(int argc, char *argv[])
 	if (f_amgx) { amgxsolver = new AmgxWrapper(args::get(f_amgx)); }
 #endif
 
+	// shared fftw wisdom
+	shared_ptr<FftwWisdom> wisdom;
+	if (f_wisdom) {
+		wisdom.reset(new FftwWisdom(args::get(f_wisdom), n, 3));
+		wisdom->load(MPI_COMM_WORLD);
+	}
+
 	Tools::Timer timer;
+
+	// the patch solvers are only timed on the first loop, the later loops reuse the choice
+	PatchSolverFactory<3> factory(f_autotune_cache ? args::get(f_autotune_cache) : "", &timer);
+	factory.setWisdom(wisdom);
+
 	for (int loop = 0; loop < loop_count; loop++) {
 		timer.start("Domain Initialization");
 		BalancedLevelsGenerator<3> blg(t, n);
@@ -306,8 +334,14 @@ int main(int argc, char *argv[])
 
 		if (f_dft) {
 			p_solver.reset(new DftPatchSolver<3>(*dc));
+		} else if (f_facr) {
+			p_solver.reset(new FacrPatchSolver<3>(*dc, 0, wisdom));
+		} else if (f_autotune && factory.getChoice().empty()) {
+			p_solver = factory.getSolver(*dc);
+		} else if (f_autotune) {
+			p_solver = PatchSolverFactory<3>::makeSolver(factory.getChoice(), *dc, 0, wisdom);
 		} else {
-			p_solver.reset(new FftwPatchSolver<3>(*dc));
+			p_solver.reset(new FftwPatchSolver<3>(*dc, 0, wisdom));
 		}
 		shared_ptr<SchurHelper<3>> sch(new SchurHelper<3>(*dc, p_solver, p_operator, p_interp));
 		MatrixHelper               mh(*dc);
@@ -325,13 +359,14 @@ int main(int argc, char *argv[])
 		timer.stop("Domain Initialization");
 
 		// Create the gamma and diff vectors
-		PW<Vec>                 gamma = sch->getNewSchurVec();
-		PW<Vec>                 diff  = sch->getNewSchurVec();
-		PW<Vec>                 b     = sch->getNewSchurVec();
-		PW<Mat>                 A;
-		shared_ptr<FuncWrap<3>> w;
-		shared_ptr<SchwarzPrec> sp;
-		shared_ptr<GMG::Helper> gh;
+		PW<Vec>                    gamma = sch->getNewSchurVec();
+		PW<Vec>                    diff  = sch->getNewSchurVec();
+		PW<Vec>                    b     = sch->getNewSchurVec();
+		PW<Mat>                    A;
+		shared_ptr<FuncWrap<3>>    w;
+		shared_ptr<SchwarzPrec>    sp;
+		shared_ptr<SchurHelper<3>> sp_sch;
+		shared_ptr<GMG::Helper>    gh;
 
 		// Create linear problem for the Belos solver
 		PW<KSP> solver;
@@ -413,7 +448,15 @@ int main(int argc, char *argv[])
 				PC pc;
 				KSPGetPC(solver, &pc);
 				if (f_scharz) {
-					sp.reset(new SchwarzPrec(sch.get(), &*dc));
+					sp_sch = sch;
+#ifdef HAVE_FFTWF
+					if (f_single_schwarz) {
+						shared_ptr<FftwPatchSolver<3>> sp_solver(new FftwPatchSolver<3>(*dc));
+						sp_solver->setSinglePrecision(true);
+						sp_sch.reset(new SchurHelper<3>(*dc, sp_solver, p_operator, p_interp));
+					}
+#endif
+					sp.reset(new SchwarzPrec(sp_sch.get(), &*dc));
 					sp->getPrec(pc);
 				}
 				if (f_gmg) {
@@ -561,6 +604,7 @@ int main(int argc, char *argv[])
 #ifdef ENABLE_AMGX
 	if (amgxsolver != nullptr) { delete amgxsolver; }
 #endif
+	if (wisdom != nullptr) { wisdom->save(MPI_COMM_WORLD); }
 	if (my_global_rank == 0) { cout << timer; }
 	PetscFinalize();
 	return 0;
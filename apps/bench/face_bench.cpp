@@ -0,0 +1,156 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "Utils.h"
+#include "args.hxx"
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <petscsys.h>
+#include <string>
+#include <vector>
+
+// ============================================================== //
+// benchmark driver for reading and writing the sides of patches //
+// ============================================================== //
+
+using namespace std;
+
+/**
+ * @brief Copy one side of every patch out, or add a scaled face back to the same side
+ */
+template <size_t D> struct FaceKernels {
+	template <int N> struct Kernel {
+		typedef void (*Function)(double *, int, int, Side<D>, double *, bool);
+		static void run(double *patches, int n, int num_patches, Side<D> s, double *faces,
+		                bool read)
+		{
+			const int patch_size = pow(Utils::patchSize<N>(n), D);
+			const int face_size  = pow(Utils::patchSize<N>(n), D - 1);
+			for (int i = 0; i < num_patches; i++) {
+				double *patch = patches + i * patch_size;
+				double *face  = faces + i * face_size;
+				if (read) {
+					Utils::copyFromFace<D, N>(patch, n, s, face);
+				} else {
+					Utils::addToFace<D, N>(patch, n, s, 0.5, face);
+				}
+			}
+		}
+	};
+};
+/**
+ * @brief Time one side, with the generic and the specialized kernels
+ *
+ * @return the time per run for generic read, specialized read, generic add, specialized add
+ */
+template <size_t D>
+array<double, 4> timeSide(vector<double> &patches, vector<double> &faces, int n, int num_patches,
+                          Side<D> s, int reps)
+{
+	array<double, 4> times;
+	int              i = 0;
+	for (bool read : {true, false}) {
+		for (bool specialized : {false, true}) {
+			auto kernel = Utils::getKernel<FaceKernels<D>::template Kernel>(n, specialized);
+			// warm up
+			kernel(&patches[0], n, num_patches, s, &faces[0], read);
+			double start = MPI_Wtime();
+			for (int r = 0; r < reps; r++) {
+				kernel(&patches[0], n, num_patches, s, &faces[0], read);
+			}
+			times[i++] = (MPI_Wtime() - start) / reps;
+		}
+	}
+	return times;
+}
+template <size_t D> void runBench(int n, int num_patches, int reps)
+{
+	int my_global_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_global_rank);
+
+	vector<double> patches(num_patches * (int) pow(n, D));
+	vector<double> faces(num_patches * (int) pow(n, D - 1));
+	for (size_t i = 0; i < patches.size(); i++) {
+		patches[i] = 1.0 / (i + 1);
+	}
+
+	string names[] = {"west", "east", "south", "north", "bottom", "top"};
+	if (my_global_rank == 0) {
+		// the number of face cells that each kernel touches in one run
+		double cells = num_patches * pow(n, D - 1);
+		cout << "dimension: " << D << ", patches: " << num_patches << ", n: " << n << endl;
+		cout << "throughput in million face cells per second" << endl;
+		cout << setw(8) << "side" << setw(16) << "read generic" << setw(20)
+		     << "read specialized" << setw(16) << "add generic" << setw(20) << "add specialized"
+		     << endl;
+		for (Side<D> s : Side<D>::getValues()) {
+			array<double, 4> times = timeSide<D>(patches, faces, n, num_patches, s, reps);
+			cout << setw(8) << names[s.toInt()];
+			for (int i = 0; i < 4; i++) {
+				cout << setw(i % 2 == 0 ? 16 : 20) << cells / times[i] / 1e6;
+			}
+			cout << endl;
+		}
+	}
+}
+int main(int argc, char *argv[])
+{
+	PetscInitialize(nullptr, nullptr, nullptr, nullptr);
+	args::ArgumentParser parser(
+	"Time reading and adding to the sides of patches through Utils::FaceView");
+
+	args::HelpFlag       help(parser, "help", "Display this help menu", {'h', "help"});
+	args::ValueFlag<int> f_n(parser, "n", "number of cells in each direction, in each patch",
+	                         {'n'});
+	args::ValueFlag<int> f_l(parser, "reps", "number of timed runs (default is 100)", {'l'});
+	args::ValueFlag<int> f_p(parser, "patches", "number of patches (default is 512)",
+	                         {"patches"});
+
+	int my_global_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_global_rank);
+
+	try {
+		parser.ParseCLI(argc, argv);
+	} catch (args::Help) {
+		if (my_global_rank == 0) std::cout << parser;
+		PetscFinalize();
+		return 0;
+	} catch (args::ParseError e) {
+		if (my_global_rank == 0) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+		}
+		PetscFinalize();
+		return 1;
+	}
+
+	int n           = f_n ? args::get(f_n) : 16;
+	int reps        = f_l ? args::get(f_l) : 100;
+	int num_patches = f_p ? args::get(f_p) : 512;
+
+	runBench<2>(n, num_patches, reps);
+	runBench<3>(n, num_patches, reps);
+
+	PetscFinalize();
+	return 0;
+}
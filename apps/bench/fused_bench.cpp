@@ -0,0 +1,164 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "BalancedLevelsGenerator.h"
+#include "DomainCollection.h"
+#include "Init.h"
+#include "OctTree.h"
+#include "PatchSolvers/PatchSolverFactory.h"
+#include "SchurHelper.h"
+#include "SevenPtPatchOperator.h"
+#include "TriLinInterp.h"
+#include "args.hxx"
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <petscsys.h>
+#include <petscvec.h>
+#include <string>
+
+// ============================================================== //
+// benchmark driver for the fused and two pass solve+interpolate //
+// ============================================================== //
+
+using namespace std;
+
+/**
+ * @brief Time solveAndInterpolateWithInterface
+ *
+ * @return the average wall time of one call in seconds
+ */
+double timeSolve(SchurHelper<3> &sch, Vec f, Vec u, Vec gamma, Vec interp, int reps)
+{
+	// warm up
+	sch.solveAndInterpolateWithInterface(f, u, gamma, interp);
+	MPI_Barrier(MPI_COMM_WORLD);
+	double start = MPI_Wtime();
+	for (int i = 0; i < reps; i++) {
+		sch.solveAndInterpolateWithInterface(f, u, gamma, interp);
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+	return (MPI_Wtime() - start) / reps;
+}
+int main(int argc, char *argv[])
+{
+	PetscInitialize(nullptr, nullptr, nullptr, nullptr);
+	args::ArgumentParser parser(
+	"Compare interpolating each patch right after it is solved with interpolating all of the "
+	"patches after they are all solved");
+
+	args::HelpFlag       help(parser, "help", "Display this help menu", {'h', "help"});
+	args::ValueFlag<int> f_n(parser, "n", "number of cells in each direction, in each domain",
+	                         {'n'});
+	args::ValueFlag<int> f_l(parser, "reps", "number of timed solves (default is 10)", {'l'});
+	args::ValueFlag<string> f_mesh(parser, "file_name", "read in a mesh", {"mesh"});
+	args::ValueFlag<int>    f_div(parser, "divide", "refine the mesh this many times", {"divide"});
+	args::ValueFlag<string> f_solver(parser, "name", "the patch solver (default is fftw)",
+	                                 {"solver"});
+	args::ValueFlag<int>    f_batch(parser, "count",
+                                 "the maximum batch size of the fftw patch solver", {"batch"});
+
+	int my_global_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_global_rank);
+
+	try {
+		parser.ParseCLI(argc, argv);
+	} catch (args::Help) {
+		if (my_global_rank == 0) std::cout << parser;
+		PetscFinalize();
+		return 0;
+	} catch (args::ParseError e) {
+		if (my_global_rank == 0) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+		}
+		PetscFinalize();
+		return 1;
+	}
+
+	int    n           = f_n ? args::get(f_n) : 32;
+	int    reps        = f_l ? args::get(f_l) : 10;
+	string solver_name = f_solver ? args::get(f_solver) : "fftw";
+
+	Tree<3> t;
+	if (f_mesh) { t = Tree<3>(args::get(f_mesh)); }
+	if (f_div) {
+		for (int i = 0; i < args::get(f_div); i++) {
+			t.refineLeaves();
+		}
+	}
+	int num_procs;
+	MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+	BalancedLevelsGenerator<3> blg(t, n);
+	if (num_procs > 1) { blg.zoltanBalance(); }
+	DomainCollection<3> dc(blg.levels[t.num_levels - 1], n);
+
+	shared_ptr<PatchSolver<3>> p_solver = PatchSolverFactory<3>::makeSolver(solver_name, dc);
+	if (f_batch) {
+		auto fftw_solver = dynamic_pointer_cast<FftwPatchSolver<3>>(p_solver);
+		if (fftw_solver != nullptr) { fftw_solver->setBatched(true, args::get(f_batch)); }
+	}
+	shared_ptr<PatchOperator<3>> p_operator(new SevenPtPatchOperator());
+	shared_ptr<Interpolator<3>>  p_interp(new TriLinInterp());
+	SchurHelper<3>               sch(dc, p_solver, p_operator, p_interp);
+
+	PW<Vec> u      = dc.getNewDomainVec();
+	PW<Vec> f      = dc.getNewDomainVec();
+	PW<Vec> exact  = dc.getNewDomainVec();
+	PW<Vec> gamma  = sch.getNewSchurVec();
+	PW<Vec> interp = sch.getNewSchurVec();
+	PW<Vec> fused  = sch.getNewSchurVec();
+
+	function<double(double, double, double)> ffun = [](double x, double y, double z) {
+		return -77.0 / 36 * M_PI * M_PI * sin(M_PI * x) * cos(2.0 / 3 * M_PI * y)
+		       * sin(5.0 / 6 * M_PI * z);
+	};
+	function<double(double, double, double)> gfun = [](double x, double y, double z) {
+		return sin(M_PI * x) * cos(2.0 / 3 * M_PI * y) * sin(5.0 / 6 * M_PI * z);
+	};
+	Init::initDirichlet(dc, n, f, exact, ffun, gfun);
+	VecSet(gamma, 1.0);
+
+	sch.setFused(false);
+	double two_pass_time = timeSolve(sch, f, u, gamma, interp, reps);
+	sch.setFused(true);
+	double fused_time = timeSolve(sch, f, u, gamma, fused, reps);
+
+	// the two should only differ by the order that the values are added in
+	double diff;
+	VecAXPY(fused, -1.0, interp);
+	VecNorm(fused, NORM_INFINITY, &diff);
+
+	if (my_global_rank == 0) {
+		cout << "patches on rank 0: " << sch.getSchurDomains().size() << ", n: " << n << endl;
+		cout << setw(24) << "solve+interpolate" << setw(16) << "time (sec)" << setw(12)
+		     << "speedup" << endl;
+		cout << setw(24) << "two pass" << setw(16) << two_pass_time << setw(12) << 1.0 << endl;
+		cout << setw(24) << "fused" << setw(16) << fused_time << setw(12)
+		     << two_pass_time / fused_time << endl;
+		cout << "max difference: " << diff << endl;
+	}
+
+	PetscFinalize();
+	return 0;
+}
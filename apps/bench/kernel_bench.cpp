@@ -0,0 +1,216 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "BalancedLevelsGenerator.h"
+#include "BilinearInterpolator.h"
+#include "DomainCollection.h"
+#include "FivePtPatchOperator.h"
+#include "OctTree.h"
+#include "PatchSolvers/FftwPatchSolver.h"
+#include "SchurHelper.h"
+#include "SevenPtPatchOperator.h"
+#include "TriLinInterp.h"
+#include "args.hxx"
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <petscsys.h>
+#include <petscvec.h>
+#include <string>
+
+// ================================================================ //
+// benchmark driver for the kernels compiled for fixed patch sizes //
+// ================================================================ //
+
+using namespace std;
+
+/**
+ * @brief The operator and interpolator for each dimension
+ */
+template <size_t D> struct BenchKernels;
+template <> struct BenchKernels<2> {
+	typedef FivePtPatchOperator  Op;
+	typedef BilinearInterpolator Interp;
+};
+template <> struct BenchKernels<3> {
+	typedef SevenPtPatchOperator Op;
+	typedef TriLinInterp         Interp;
+};
+/**
+ * @brief The times of one kernel with the generic and the specialized versions
+ */
+struct KernelTimes {
+	double generic;
+	double specialized;
+	double diff;
+};
+/**
+ * @brief Time a function, with the generic and the specialized kernels
+ *
+ * @param set_specialized switches between the two versions
+ * @param run runs the kernel once and writes its output to out
+ * @param out the output of the kernel
+ * @param reps the number of timed runs
+ */
+KernelTimes timeKernel(function<void(bool)> set_specialized, function<void()> run, Vec out,
+                       int reps)
+{
+	KernelTimes times;
+	PW<Vec>     generic_out;
+	VecDuplicate(out, &generic_out);
+	for (bool specialized : {false, true}) {
+		set_specialized(specialized);
+		// warm up
+		run();
+		MPI_Barrier(MPI_COMM_WORLD);
+		double start = MPI_Wtime();
+		for (int i = 0; i < reps; i++) {
+			run();
+		}
+		MPI_Barrier(MPI_COMM_WORLD);
+		double time = (MPI_Wtime() - start) / reps;
+		if (specialized) {
+			times.specialized = time;
+		} else {
+			times.generic = time;
+			VecCopy(out, generic_out);
+		}
+	}
+	// the outputs can only differ in rounding
+	VecAXPY(generic_out, -1.0, out);
+	VecNorm(generic_out, NORM_INFINITY, &times.diff);
+	return times;
+}
+template <size_t D> void runBench(Tree<D> &t, int n, int reps)
+{
+	int num_procs;
+	MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+	int my_global_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_global_rank);
+
+	BalancedLevelsGenerator<D> blg(t, n);
+	if (num_procs > 1) { blg.zoltanBalance(); }
+	DomainCollection<D> dc(blg.levels[t.num_levels - 1], n);
+
+	// the per-patch path is the one that adds the interface values with the gamma kernel
+	shared_ptr<FftwPatchSolver<D>> p_solver(new FftwPatchSolver<D>(dc));
+	p_solver->setBatched(false);
+	shared_ptr<typename BenchKernels<D>::Op>     p_operator(new typename BenchKernels<D>::Op());
+	shared_ptr<typename BenchKernels<D>::Interp> p_interp(new typename BenchKernels<D>::Interp());
+	SchurHelper<D> sch(dc, p_solver, p_operator, p_interp);
+
+	const PatchTable<D> &table  = sch.getPatchTable();
+	PW<Vec>              u      = dc.getNewDomainVec();
+	PW<Vec>              f      = dc.getNewDomainVec();
+	PW<Vec>              gamma  = sch.getNewSchurDistVec();
+	PW<Vec>              interp = sch.getNewSchurDistVec();
+	VecSetRandom(u, nullptr);
+	VecSetRandom(f, nullptr);
+	VecSetRandom(gamma, nullptr);
+
+	KernelTimes op_times
+	= timeKernel([&](bool s) { p_operator->setSpecialized(s); },
+	             [&]() { p_operator->apply(table, u, gamma, f); }, f, reps);
+	function<void()> interpolate = [&]() {
+		VecSet(interp, 0);
+		p_interp->interpolate(table, u, interp);
+	};
+	KernelTimes interp_times
+	= timeKernel([&](bool s) { p_interp->setSpecialized(s); }, interpolate, interp, reps);
+	PW<Vec>     u_solve = dc.getNewDomainVec();
+	KernelTimes solve_times
+	= timeKernel([&](bool s) { p_solver->setSpecialized(s); },
+	             [&]() { p_solver->domainSolve(sch.getSchurDomains(), f, u_solve, gamma); },
+	             u_solve, reps);
+
+	if (my_global_rank == 0) {
+		cout << "dimension: " << D << ", patches on rank 0: " << table.size() << ", n: " << n
+		     << endl;
+		cout << setw(16) << "kernel" << setw(16) << "generic (sec)" << setw(20)
+		     << "specialized (sec)" << setw(12) << "speedup" << setw(16) << "max diff" << endl;
+		string      names[] = {"operator", "interpolator", "patch solver"};
+		KernelTimes times[] = {op_times, interp_times, solve_times};
+		for (int i = 0; i < 3; i++) {
+			cout << setw(16) << names[i] << setw(16) << times[i].generic << setw(20)
+			     << times[i].specialized << setw(12) << times[i].generic / times[i].specialized
+			     << setw(16) << times[i].diff << endl;
+		}
+	}
+}
+int main(int argc, char *argv[])
+{
+	PetscInitialize(nullptr, nullptr, nullptr, nullptr);
+	args::ArgumentParser parser(
+	"Compare the kernels compiled for fixed patch sizes with the generic kernels");
+
+	args::HelpFlag       help(parser, "help", "Display this help menu", {'h', "help"});
+	args::ValueFlag<int> f_n(parser, "n", "number of cells in each direction, in each domain",
+	                         {'n'});
+	args::ValueFlag<int> f_l(parser, "reps", "number of timed runs (default is 10)", {'l'});
+	args::ValueFlag<string> f_mesh(parser, "file_name", "read in a mesh", {"mesh"});
+	args::ValueFlag<int>    f_div(parser, "divide", "refine the mesh this many times", {"divide"});
+	args::Flag              f_two(parser, "two", "use the two dimensional kernels", {"two"});
+
+	int my_global_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_global_rank);
+
+	try {
+		parser.ParseCLI(argc, argv);
+	} catch (args::Help) {
+		if (my_global_rank == 0) std::cout << parser;
+		PetscFinalize();
+		return 0;
+	} catch (args::ParseError e) {
+		if (my_global_rank == 0) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+		}
+		PetscFinalize();
+		return 1;
+	}
+
+	int n    = f_n ? args::get(f_n) : 32;
+	int reps = f_l ? args::get(f_l) : 10;
+
+	if (f_two) {
+		Tree<2> t;
+		if (f_mesh) { t = Tree<2>(args::get(f_mesh)); }
+		if (f_div) {
+			for (int i = 0; i < args::get(f_div); i++) {
+				t.refineLeaves();
+			}
+		}
+		runBench<2>(t, n, reps);
+	} else {
+		Tree<3> t;
+		if (f_mesh) { t = Tree<3>(args::get(f_mesh)); }
+		if (f_div) {
+			for (int i = 0; i < args::get(f_div); i++) {
+				t.refineLeaves();
+			}
+		}
+		runBench<3>(t, n, reps);
+	}
+
+	PetscFinalize();
+	return 0;
+}
@@ -0,0 +1,306 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "BalancedLevelsGenerator.h"
+#include "DomainCollection.h"
+#include "Init.h"
+#include "OctTree.h"
+#include "PatchSolvers/PatchSolverFactory.h"
+#include "SchurHelper.h"
+#include "SevenPtPatchOperator.h"
+#include "TriLinInterp.h"
+#include "args.hxx"
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <petscmat.h>
+#include <petscsys.h>
+#include <petscvec.h>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// ========================================== //
+// benchmark driver for PatchSolver<3> solves //
+// ========================================== //
+
+using namespace std;
+
+/**
+ * @brief A patch solver, and the vectors needed to call domainSolve on it, for one mesh
+ */
+class PatchBench
+{
+	private:
+	shared_ptr<DomainCollection<3>> dc;
+	shared_ptr<SchurHelper<3>>      sch;
+	PW<Vec>                         f;
+	PW<Vec>                         u;
+	PW<Vec>                         gamma;
+
+	public:
+	/**
+	 * @brief Create a new PatchBench
+	 *
+	 * @param t the mesh
+	 * @param n the number of cells in each direction, in each domain
+	 * @param solver the name of the patch solver, one of PatchSolverFactory::getSolverNames()
+	 * @param neumann use neumann boundary conditions
+	 */
+	PatchBench(Tree<3> &t, int n, string solver, bool neumann)
+	{
+		BalancedLevelsGenerator<3> blg(t, n);
+		int                        num_procs;
+		MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+		if (num_procs > 1) { blg.zoltanBalance(); }
+		dc.reset(new DomainCollection<3>(blg.levels[t.num_levels - 1], n));
+		if (neumann) { dc->setNeumann(); }
+
+		shared_ptr<PatchSolver<3>>   p_solver = PatchSolverFactory<3>::makeSolver(solver, *dc);
+		shared_ptr<PatchOperator<3>> p_operator(new SevenPtPatchOperator());
+		shared_ptr<Interpolator<3>>  p_interp(new TriLinInterp());
+		sch.reset(new SchurHelper<3>(*dc, p_solver, p_operator, p_interp));
+
+		u             = dc->getNewDomainVec();
+		f             = dc->getNewDomainVec();
+		gamma         = sch->getNewSchurDistVec();
+		PW<Vec> exact = dc->getNewDomainVec();
+
+		function<double(double, double, double)> ffun = [](double x, double y, double z) {
+			return -77.0 / 36 * M_PI * M_PI * sin(M_PI * x) * cos(2.0 / 3 * M_PI * y)
+			       * sin(5.0 / 6 * M_PI * z);
+		};
+		function<double(double, double, double)> gfun = [](double x, double y, double z) {
+			return sin(M_PI * x) * cos(2.0 / 3 * M_PI * y) * sin(5.0 / 6 * M_PI * z);
+		};
+		Init::initDirichlet(*dc, n, f, exact, ffun, gfun);
+		VecSet(gamma, 1.0);
+	}
+	/**
+	 * @brief Time domainSolve over all the patches on this rank
+	 *
+	 * @return the average wall time of one domainSolve in seconds
+	 */
+	double time(int reps)
+	{
+		PatchSolver<3> &solver = *sch->getSolver();
+		// warm up
+		solver.domainSolve(sch->getSchurDomains(), f, u, gamma);
+		MPI_Barrier(MPI_COMM_WORLD);
+		double start = MPI_Wtime();
+		for (int i = 0; i < reps; i++) {
+			solver.domainSolve(sch->getSchurDomains(), f, u, gamma);
+		}
+		MPI_Barrier(MPI_COMM_WORLD);
+		return (MPI_Wtime() - start) / reps;
+	}
+	/**
+	 * @brief Time domainSolveMulti with num_rhs copies of the right hand side
+	 *
+	 * @return the average wall time of one domainSolveMulti in seconds
+	 */
+	double timeMulti(int num_rhs, int reps)
+	{
+		PW<Mat>  f_mat = dc->getNewDomainMat(num_rhs);
+		PW<Mat>  u_mat = dc->getNewDomainMat(num_rhs);
+		PW<Mat>  gamma_mat;
+		PetscInt domain_size, gamma_size, f_lda;
+		VecGetLocalSize(f, &domain_size);
+		VecGetLocalSize(gamma, &gamma_size);
+		MatCreateSeqDense(PETSC_COMM_SELF, gamma_size, num_rhs, nullptr, &gamma_mat);
+		MatDenseGetLDA(f_mat, &f_lda);
+
+		const double *f_view;
+		double *      f_mat_view, *gamma_mat_view;
+		VecGetArrayRead(f, &f_view);
+		MatDenseGetArray(f_mat, &f_mat_view);
+		MatDenseGetArray(gamma_mat, &gamma_mat_view);
+		for (int j = 0; j < num_rhs; j++) {
+			for (int i = 0; i < domain_size; i++) {
+				f_mat_view[j * f_lda + i] = f_view[i];
+			}
+			for (int i = 0; i < gamma_size; i++) {
+				gamma_mat_view[j * gamma_size + i] = 1.0;
+			}
+		}
+		MatDenseRestoreArray(f_mat, &f_mat_view);
+		MatDenseRestoreArray(gamma_mat, &gamma_mat_view);
+		VecRestoreArrayRead(f, &f_view);
+
+		PatchSolver<3> &solver = *sch->getSolver();
+		// warm up
+		solver.domainSolveMulti(sch->getSchurDomains(), f_mat, u_mat, gamma_mat);
+		MPI_Barrier(MPI_COMM_WORLD);
+		double start = MPI_Wtime();
+		for (int i = 0; i < reps; i++) {
+			solver.domainSolveMulti(sch->getSchurDomains(), f_mat, u_mat, gamma_mat);
+		}
+		MPI_Barrier(MPI_COMM_WORLD);
+		return (MPI_Wtime() - start) / reps;
+	}
+	int getNumPatches()
+	{
+		return sch->getSchurDomains().size();
+	}
+};
+int main(int argc, char *argv[])
+{
+	PetscInitialize(nullptr, nullptr, nullptr, nullptr);
+	args::ArgumentParser parser("Time the patch solvers on a mesh");
+
+	args::HelpFlag       help(parser, "help", "Display this help menu", {'h', "help"});
+	args::ValueFlag<int> f_n(parser, "n", "number of cells in each direction, in each domain",
+	                         {'n'});
+	args::ValueFlag<int> f_l(parser, "reps", "number of timed solves (default is 10)", {'l'});
+	args::ValueFlag<string> f_mesh(parser, "file_name", "read in a mesh", {"mesh"});
+	args::ValueFlag<int>    f_div(parser, "divide", "refine the mesh this many times", {"divide"});
+	args::ValueFlag<int>    f_threads(parser, "threads",
+                                   "maximum number of threads to time (default is all)",
+                                   {"threads"});
+	args::Flag              f_neumann(parser, "", "use neumann boundary conditions", {"neumann"});
+	args::Flag              f_dft(parser, "", "time the DftPatchSolver", {"dft"});
+	args::Flag              f_facr(parser, "", "time the FacrPatchSolver", {"facr"});
+	args::Flag              f_compare(parser, "",
+                         "compare the patch solvers for n = 2, 4, ..., n, and n",
+                         {"compare"});
+	args::ValueFlag<int>    f_rhs(parser, "k",
+                               "compare k separate solves with one solve of k right hand sides",
+                               {"rhs"});
+
+	int my_global_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_global_rank);
+
+	try {
+		parser.ParseCLI(argc, argv);
+	} catch (args::Help) {
+		if (my_global_rank == 0) std::cout << parser;
+		PetscFinalize();
+		return 0;
+	} catch (args::ParseError e) {
+		if (my_global_rank == 0) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+		}
+		PetscFinalize();
+		return 1;
+	}
+
+	int n    = f_n ? args::get(f_n) : 32;
+	int reps = f_l ? args::get(f_l) : 10;
+
+	Tree<3> t;
+	if (f_mesh) { t = Tree<3>(args::get(f_mesh)); }
+	if (f_div) {
+		for (int i = 0; i < args::get(f_div); i++) {
+			t.refineLeaves();
+		}
+	}
+	int max_threads = 1;
+#ifdef _OPENMP
+	max_threads = omp_get_max_threads();
+#endif
+	if (f_threads) { max_threads = args::get(f_threads); }
+
+	if (f_compare) {
+		// time both solvers with all the threads for increasing patch sizes
+#ifdef _OPENMP
+		omp_set_num_threads(max_threads);
+#endif
+		vector<string> names = PatchSolverFactory<3>::getSolverNames();
+		if (my_global_rank == 0) {
+			cout << setw(6) << "n";
+			for (const string &name : names) {
+				cout << setw(16) << name + " (sec)";
+			}
+			cout << setw(10) << "fastest" << endl;
+		}
+		// the powers of two, and then n itself if it is not one of them
+		vector<int> sizes;
+		for (int bench_n = 2; bench_n <= n; bench_n *= 2) {
+			sizes.push_back(bench_n);
+		}
+		if (sizes.empty() || sizes.back() != n) { sizes.push_back(n); }
+		for (int bench_n : sizes) {
+			double best_time = 0;
+			string best;
+			if (my_global_rank == 0) { cout << setw(6) << bench_n; }
+			for (const string &name : names) {
+				double time = PatchBench(t, bench_n, name, f_neumann).time(reps);
+				if (best.empty() || time < best_time) {
+					best_time = time;
+					best      = name;
+				}
+				if (my_global_rank == 0) { cout << setw(16) << time; }
+			}
+			if (my_global_rank == 0) { cout << setw(10) << best << endl; }
+		}
+		PetscFinalize();
+		return 0;
+	}
+
+	string solver_name = "fftw";
+	if (f_dft) { solver_name = "dft"; }
+	if (f_facr) { solver_name = "facr"; }
+
+	if (f_rhs) {
+		// time both ways of solving for 1, 2, 4, ..., k right hand sides
+		PatchBench bench(t, n, solver_name, f_neumann);
+		if (my_global_rank == 0) {
+			cout << setw(6) << "rhs" << setw(16) << "separate (sec)" << setw(16) << "multi (sec)"
+			     << setw(12) << "speedup" << endl;
+		}
+		double single_time = bench.time(reps);
+		for (int num_rhs = 1; num_rhs <= args::get(f_rhs); num_rhs *= 2) {
+			double separate_time = num_rhs * single_time;
+			double multi_time    = bench.timeMulti(num_rhs, reps);
+			if (my_global_rank == 0) {
+				cout << setw(6) << num_rhs << setw(16) << separate_time << setw(16) << multi_time
+				     << setw(12) << separate_time / multi_time << endl;
+			}
+		}
+		PetscFinalize();
+		return 0;
+	}
+
+	PatchBench bench(t, n, solver_name, f_neumann);
+	if (my_global_rank == 0) {
+		cout << "patches per rank: " << bench.getNumPatches() << ", n: " << n << endl;
+		cout << setw(8) << "threads" << setw(16) << "time (sec)" << setw(12) << "speedup" << endl;
+	}
+	double serial_time = 0;
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+#ifdef _OPENMP
+		omp_set_num_threads(threads);
+#endif
+		double time = bench.time(reps);
+		if (threads == 1) { serial_time = time; }
+		if (my_global_rank == 0) {
+			cout << setw(8) << threads << setw(16) << time << setw(12) << serial_time / time
+			     << endl;
+		}
+	}
+
+	PetscFinalize();
+	return 0;
+}
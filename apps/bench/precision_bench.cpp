@@ -0,0 +1,199 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "BalancedLevelsGenerator.h"
+#include "DomainCollection.h"
+#include "FunctionWrapper.h"
+#include "GMG/Helper.h"
+#include "Init.h"
+#include "MatrixHelper.h"
+#include "OctTree.h"
+#include "PatchSolvers/FftwPatchSolver.h"
+#include "SchurHelper.h"
+#include "SevenPtPatchOperator.h"
+#include "TriLinInterp.h"
+#include "args.hxx"
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <json.hpp>
+#include <memory>
+#include <petscksp.h>
+#include <petscsys.h>
+#include <petscvec.h>
+#include <string>
+#include <vector>
+
+// =============================================================== //
+// compare preconditioner convergence with double and float solves //
+// =============================================================== //
+
+using namespace std;
+using nlohmann::json;
+
+int main(int argc, char *argv[])
+{
+	PetscInitialize(nullptr, nullptr, nullptr, nullptr);
+	args::ArgumentParser parser(
+	"Solve the full system with single and double precision patch solves in the preconditioner");
+
+	args::HelpFlag       help(parser, "help", "Display this help menu", {'h', "help"});
+	args::ValueFlag<int> f_n(parser, "n", "number of cells in each direction, in each domain",
+	                         {'n'});
+	args::ValueFlag<double> f_t(
+	parser, "tolerance", "set the tolerance of the iterative solver (default is 1e-10)", {'t'});
+	args::ValueFlag<string> f_mesh(parser, "file_name", "read in a mesh", {"mesh"});
+	args::ValueFlag<int>    f_div(parser, "divide", "refine the mesh this many times", {"divide"});
+	args::ValueFlag<string> f_gmg(parser, "config_file",
+	                              "use the GMG preconditioner instead of the schwarz preconditioner",
+	                              {"gmg"});
+
+	int my_global_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_global_rank);
+
+	try {
+		parser.ParseCLI(argc, argv);
+	} catch (args::Help) {
+		if (my_global_rank == 0) std::cout << parser;
+		PetscFinalize();
+		return 0;
+	} catch (args::ParseError e) {
+		if (my_global_rank == 0) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+		}
+		PetscFinalize();
+		return 1;
+	}
+
+	int    n   = f_n ? args::get(f_n) : 16;
+	double tol = f_t ? args::get(f_t) : 1e-10;
+
+	Tree<3> t;
+	if (f_mesh) { t = Tree<3>(args::get(f_mesh)); }
+	if (f_div) {
+		for (int i = 0; i < args::get(f_div); i++) {
+			t.refineLeaves();
+		}
+	}
+	BalancedLevelsGenerator<3> blg(t, n);
+	int                        num_procs;
+	MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+	if (num_procs > 1) { blg.zoltanBalance(); }
+	vector<shared_ptr<DomainCollection<3>>> dcs(t.num_levels);
+	for (int i = 0; i < t.num_levels; i++) {
+		dcs[i].reset(new DomainCollection<3>(blg.levels[t.num_levels - 1 - i], n));
+	}
+	shared_ptr<DomainCollection<3>> dc = dcs[0];
+
+	PW<Vec> f     = dc->getNewDomainVec();
+	PW<Vec> u     = dc->getNewDomainVec();
+	PW<Vec> exact = dc->getNewDomainVec();
+	PW<Vec> error = dc->getNewDomainVec();
+
+	function<double(double, double, double)> ffun = [](double x, double y, double z) {
+		return -77.0 / 36 * M_PI * M_PI * sin(M_PI * x) * cos(2.0 / 3 * M_PI * y)
+		       * sin(5.0 / 6 * M_PI * z);
+	};
+	function<double(double, double, double)> gfun = [](double x, double y, double z) {
+		return sin(M_PI * x) * cos(2.0 / 3 * M_PI * y) * sin(5.0 / 6 * M_PI * z);
+	};
+	Init::initDirichlet(*dc, n, f, exact, ffun, gfun);
+
+	MatrixHelper mh(*dc);
+	PW<Mat>      A = mh.formCRSMatrix();
+
+	shared_ptr<PatchOperator<3>> p_operator(new SevenPtPatchOperator());
+	shared_ptr<Interpolator<3>>  p_interp(new TriLinInterp());
+
+	vector<string> precisions = {"double"};
+#ifdef HAVE_FFTWF
+	precisions.push_back("single");
+#else
+	if (my_global_rank == 0) { cout << "fftw3f not found, only timing double precision" << endl; }
+#endif
+
+	if (my_global_rank == 0) {
+		cout << setw(10) << "precision" << setw(12) << "iterations" << setw(16) << "time (sec)"
+		     << setw(16) << "error" << endl;
+	}
+	for (const string &precision : precisions) {
+		shared_ptr<FftwPatchSolver<3>> p_solver(new FftwPatchSolver<3>(*dc));
+		shared_ptr<SchurHelper<3>>     sch;
+		shared_ptr<GMG::Helper>        gh;
+		shared_ptr<SchwarzPrec>        sp;
+
+		PW<KSP> solver;
+		KSPCreate(MPI_COMM_WORLD, &solver);
+		KSPSetOperators(solver, A, A);
+		KSPSetFromOptions(solver);
+		KSPSetTolerances(solver, tol, PETSC_DEFAULT, PETSC_DEFAULT, 5000);
+		PC pc;
+		KSPGetPC(solver, &pc);
+		if (f_gmg) {
+			// the gmg operators stay in double, only the smoothers change precision
+			string config_file = args::get(f_gmg) + "." + precision;
+			if (my_global_rank == 0) {
+				ifstream config_stream(args::get(f_gmg));
+				json     config_j;
+				config_stream >> config_j;
+				config_j["smoother_precision"] = precision;
+				ofstream out(config_file);
+				out << config_j;
+			}
+			MPI_Barrier(MPI_COMM_WORLD);
+			sch.reset(new SchurHelper<3>(*dc, p_solver, p_operator, p_interp));
+			gh.reset(new GMG::Helper(n, dcs, sch, config_file));
+			gh->getPrec(pc);
+		} else {
+#ifdef HAVE_FFTWF
+			p_solver->setSinglePrecision(precision == "single");
+#endif
+			sch.reset(new SchurHelper<3>(*dc, p_solver, p_operator, p_interp));
+			sp.reset(new SchwarzPrec(sch.get(), dc.get()));
+			sp->getPrec(pc);
+		}
+		PCSetUp(pc);
+
+		VecScale(u, 0);
+		MPI_Barrier(MPI_COMM_WORLD);
+		double start = MPI_Wtime();
+		KSPSolve(solver, f, u);
+		MPI_Barrier(MPI_COMM_WORLD);
+		double time = MPI_Wtime() - start;
+
+		int its;
+		KSPGetIterationNumber(solver, &its);
+		VecAXPBYPCZ(error, -1.0, 1.0, 0.0, exact, u);
+		double error_norm;
+		VecNorm(error, NORM_2, &error_norm);
+		double exact_norm;
+		VecNorm(exact, NORM_2, &exact_norm);
+		if (my_global_rank == 0) {
+			cout << setw(10) << precision << setw(12) << its << setw(16) << time << setw(16)
+			     << error_norm / exact_norm << endl;
+		}
+	}
+
+	PetscFinalize();
+	return 0;
+}
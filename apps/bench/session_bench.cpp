@@ -0,0 +1,162 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "Init.h"
+#include "OctTree.h"
+#include "PoissonSession.h"
+#include "SevenPtPatchOperator.h"
+#include "Timer.h"
+#include "TriLinInterp.h"
+#include "args.hxx"
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <petscsys.h>
+#include <petscvec.h>
+#include <string>
+
+// ====================================================== //
+// benchmark driver for repeated solves on a fixed mesh //
+// ====================================================== //
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+	int     petsc_argc;
+	int *   petsc_argc_ptr = nullptr;
+	char ** petsc_argv;
+	char ***petsc_argv_ptr = nullptr;
+	string  delim          = "::";
+	for (int i = 0; i < argc; i++) {
+		if (argv[i] == delim) {
+			int tmp        = argc;
+			argc           = i;
+			petsc_argc     = tmp - i;
+			petsc_argc_ptr = &petsc_argc;
+			petsc_argv     = &argv[i];
+			petsc_argv_ptr = &petsc_argv;
+		}
+	}
+	// use :: to delimit petsc options at end
+	PetscInitialize(petsc_argc_ptr, petsc_argv_ptr, nullptr, nullptr);
+	args::ArgumentParser parser("Set up a PoissonSession once, and time solves with it");
+
+	args::HelpFlag       help(parser, "help", "Display this help menu", {'h', "help"});
+	args::ValueFlag<int> f_n(parser, "n", "number of cells in each direction, in each domain",
+	                         {'n'});
+	args::ValueFlag<int> f_l(parser, "solves", "number of right hand sides (default is 10)",
+	                         {'l'});
+	args::ValueFlag<string> f_mesh(parser, "file_name", "read in a mesh", {"mesh"});
+	args::ValueFlag<int>    f_div(parser, "divide", "refine the mesh this many times", {"divide"});
+	args::ValueFlag<double> f_t(
+	parser, "tolerance", "set the tolerance of the iterative solver (default is 1e-10)", {'t'});
+	args::ValueFlag<string> f_gmg(parser, "config_file", "use GMG preconditioner", {"gmg"});
+	args::Flag              f_wrapper(parser, "wrapper", "use a function wrapper", {"wrap"});
+	args::ValueFlag<string> f_solver(
+	parser, "name", "the patch solver, or autotune (default is fftw)", {"solver"});
+	args::Flag f_noguess(parser, "", "start each solve from zero interface values", {"noguess"});
+	args::ValueFlag<int> f_recycle(parser, "k", "recycle the corrections of the last k solves",
+	                               {"recycle"});
+
+	int my_global_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_global_rank);
+
+	try {
+		parser.ParseCLI(argc, argv);
+	} catch (args::Help) {
+		if (my_global_rank == 0) std::cout << parser;
+		PetscFinalize();
+		return 0;
+	} catch (args::ParseError e) {
+		if (my_global_rank == 0) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+		}
+		PetscFinalize();
+		return 1;
+	}
+
+	int    n           = f_n ? args::get(f_n) : 16;
+	int    num_solves  = f_l ? args::get(f_l) : 10;
+	double tol         = f_t ? args::get(f_t) : 1e-10;
+	string solver_name = f_solver ? args::get(f_solver) : "fftw";
+
+	Tree<3> t;
+	if (f_mesh) { t = Tree<3>(args::get(f_mesh)); }
+	if (f_div) {
+		for (int i = 0; i < args::get(f_div); i++) {
+			t.refineLeaves();
+		}
+	}
+
+	Tools::Timer                 timer;
+	shared_ptr<PatchOperator<3>> p_operator(new SevenPtPatchOperator());
+	shared_ptr<Interpolator<3>>  p_interp(new TriLinInterp());
+	PoissonSession<3>            session(p_operator, p_interp, &timer);
+	session.setPatchSolver(solver_name);
+	session.setMatrixFree(f_wrapper);
+	session.setTolerance(tol);
+	session.setReuseGuess(!f_noguess);
+	if (f_gmg) { session.setGmgConfig(args::get(f_gmg)); }
+	if (f_recycle) { session.setRecycle(args::get(f_recycle)); }
+	session.setup(t, n);
+
+	DomainCollection<3> &dc    = session.getDomainCollection();
+	PW<Vec>              u     = dc.getNewDomainVec();
+	PW<Vec>              f     = dc.getNewDomainVec();
+	PW<Vec>              exact = dc.getNewDomainVec();
+	PW<Vec>              error = dc.getNewDomainVec();
+
+	// each right hand side is a small change from the last one, like the steps of a time
+	// dependent problem
+	double error_norm = 0;
+	for (int i = 0; i < num_solves; i++) {
+		double                                   shift = 0.01 * i;
+		function<double(double, double, double)> ffun  = [=](double x, double y, double z) {
+			return -77.0 / 36 * M_PI * M_PI * sin(M_PI * (x + shift)) * cos(2.0 / 3 * M_PI * y)
+			       * sin(5.0 / 6 * M_PI * z);
+		};
+		function<double(double, double, double)> gfun = [=](double x, double y, double z) {
+			return sin(M_PI * (x + shift)) * cos(2.0 / 3 * M_PI * y) * sin(5.0 / 6 * M_PI * z);
+		};
+		Init::initDirichlet(dc, n, f, exact, ffun, gfun);
+
+		session.solve(f, u);
+
+		double exact_norm;
+		VecAXPBYPCZ(error, -1.0, 1.0, 0.0, exact, u);
+		VecNorm(error, NORM_2, &error_norm);
+		VecNorm(exact, NORM_2, &exact_norm);
+		error_norm /= exact_norm;
+		if (my_global_rank == 0) {
+			cout << "Solve " << i << ", iterations: " << session.getIterations() << endl;
+		}
+	}
+
+	if (my_global_rank == 0) {
+		cout << "Error (2-norm) of the last solve: " << error_norm << endl;
+		cout << timer;
+	}
+
+	PetscFinalize();
+	return 0;
+}
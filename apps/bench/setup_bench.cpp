@@ -0,0 +1,177 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "BalancedLevelsGenerator.h"
+#include "DomainCollection.h"
+#include "IdIndex.h"
+#include "OctTree.h"
+#include "PatchSolvers/PatchSolverFactory.h"
+#include "SchurHelper.h"
+#include "SevenPtPatchOperator.h"
+#include "TriLinInterp.h"
+#include "args.hxx"
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <petscsys.h>
+#include <string>
+#include <vector>
+
+// ======================================================== //
+// benchmark driver for the setup of the domains and ifaces //
+// ======================================================== //
+
+using namespace std;
+
+/**
+ * @brief Time the insertion and lookup of a set of ids in a map type
+ *
+ * The ids are inserted in order, given sequential values, and then each one is looked up, which
+ * is what the indexing code does with its reverse maps.
+ *
+ * @return the average wall time of one pass in seconds
+ */
+template <class Map> double timeIndex(const vector<int> &ids, int reps)
+{
+	int    sum   = 0;
+	double start = MPI_Wtime();
+	for (int r = 0; r < reps; r++) {
+		Map rev_map;
+		for (size_t i = 0; i < ids.size(); i++) {
+			rev_map[ids[i]] = i;
+		}
+		for (int id : ids) {
+			sum += rev_map.at(id);
+		}
+	}
+	double time = (MPI_Wtime() - start) / reps;
+	// keep the lookups from being optimized away
+	if (sum == -1) { cout << sum << endl; }
+	return time;
+}
+int main(int argc, char *argv[])
+{
+	PetscInitialize(nullptr, nullptr, nullptr, nullptr);
+	args::ArgumentParser parser("Time the setup of the domains and interfaces for a mesh");
+
+	args::HelpFlag       help(parser, "help", "Display this help menu", {'h', "help"});
+	args::ValueFlag<int> f_n(parser, "n", "number of cells in each direction, in each domain",
+	                         {'n'});
+	args::ValueFlag<int> f_l(parser, "reps", "number of timed setups (default is 5)", {'l'});
+	args::ValueFlag<string> f_mesh(parser, "file_name", "read in a mesh", {"mesh"});
+	args::ValueFlag<int>    f_div(parser, "divide", "refine the mesh this many times", {"divide"});
+
+	int my_global_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_global_rank);
+
+	try {
+		parser.ParseCLI(argc, argv);
+	} catch (args::Help) {
+		if (my_global_rank == 0) std::cout << parser;
+		PetscFinalize();
+		return 0;
+	} catch (args::ParseError e) {
+		if (my_global_rank == 0) {
+			std::cerr << e.what() << std::endl;
+			std::cerr << parser;
+		}
+		PetscFinalize();
+		return 1;
+	}
+
+	int n    = f_n ? args::get(f_n) : 4;
+	int reps = f_l ? args::get(f_l) : 5;
+
+	Tree<3> t;
+	if (f_mesh) { t = Tree<3>(args::get(f_mesh)); }
+	if (f_div) {
+		for (int i = 0; i < args::get(f_div); i++) {
+			t.refineLeaves();
+		}
+	}
+	int num_procs;
+	MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+	shared_ptr<PatchOperator<3>> p_operator(new SevenPtPatchOperator());
+	shared_ptr<Interpolator<3>>  p_interp(new TriLinInterp());
+
+	double levels_time = 0;
+	double dc_time     = 0;
+	double sch_time    = 0;
+	int    num_patches = 0;
+	for (int r = 0; r < reps; r++) {
+		MPI_Barrier(MPI_COMM_WORLD);
+		double start = MPI_Wtime();
+
+		BalancedLevelsGenerator<3> blg(t, n);
+		if (num_procs > 1) { blg.zoltanBalance(); }
+		MPI_Barrier(MPI_COMM_WORLD);
+		double levels_end = MPI_Wtime();
+
+		vector<shared_ptr<DomainCollection<3>>> dcs(t.num_levels);
+		for (int i = 0; i < t.num_levels; i++) {
+			dcs[i].reset(new DomainCollection<3>(blg.levels[t.num_levels - 1 - i], n));
+		}
+		MPI_Barrier(MPI_COMM_WORLD);
+		double dc_end = MPI_Wtime();
+
+		// the patch solver is created outside of the timed region, so that only the setup of the
+		// interfaces is timed
+		shared_ptr<PatchSolver<3>> p_solver = PatchSolverFactory<3>::makeSolver("dft", *dcs[0]);
+		MPI_Barrier(MPI_COMM_WORLD);
+		double sch_start = MPI_Wtime();
+		SchurHelper<3> sch(*dcs[0], p_solver, p_operator, p_interp);
+		MPI_Barrier(MPI_COMM_WORLD);
+		double sch_end = MPI_Wtime();
+
+		levels_time += levels_end - start;
+		dc_time += dc_end - levels_end;
+		sch_time += sch_end - sch_start;
+		num_patches = sch.getSchurDomains().size();
+	}
+
+	// the ids that the finest level is indexed with
+	BalancedLevelsGenerator<3> blg(t, n);
+	if (num_procs > 1) { blg.zoltanBalance(); }
+	vector<int> ids;
+	for (auto &p : blg.levels[t.num_levels - 1]) {
+		ids.push_back(p.first);
+	}
+	double map_time   = timeIndex<map<int, int>>(ids, 10 * reps);
+	double index_time = timeIndex<IdIndex>(ids, 10 * reps);
+
+	if (my_global_rank == 0) {
+		cout << "levels: " << t.num_levels << ", patches on rank 0: " << num_patches << endl;
+		cout << setw(24) << "phase" << setw(16) << "time (sec)" << endl;
+		cout << setw(24) << "levels" << setw(16) << levels_time / reps << endl;
+		cout << setw(24) << "domain collections" << setw(16) << dc_time / reps << endl;
+		cout << setw(24) << "schur helper" << setw(16) << sch_time / reps << endl;
+		cout << endl;
+		cout << setw(24) << "index" << setw(16) << "time (sec)" << setw(12) << "speedup" << endl;
+		cout << setw(24) << "std::map" << setw(16) << map_time << setw(12) << 1.0 << endl;
+		cout << setw(24) << "IdIndex" << setw(16) << index_time << setw(12)
+		     << map_time / index_time << endl;
+	}
+
+	PetscFinalize();
+	return 0;
+}
@@ -23,6 +23,7 @@
 #define BALANCELEVELGENERATOR_H
 #include "Domain.h"
 #include "OctTree.h"
+#include "SparseExchange.h"
 #include <deque>
 #include <iostream>
 #include <memory>
@@ -36,6 +37,8 @@ template <size_t D> class BalancedLevelsGenerator
 	void extractLevel(const Tree<D> &t, int level, int n);
 	void balanceLevel(int level);
 	void balanceLevelWithLower(int level);
+	void updateNbrRanks(std::map<int, std::shared_ptr<Domain<D>>> &level, int num_export,
+	                    ZOLTAN_ID_PTR export_ids, int *export_procs);
 
 	public:
 	using DomainMap = std::map<int, std::shared_ptr<Domain<D>>>;
@@ -287,11 +290,7 @@ template <size_t D> inline void BalancedLevelsGenerator<D>::balanceLevel(int lev
 	                             &exportToPart);
 
 	// update ranks of neighbors before migrating
-	for (int i = 0; i < numExport; i++) {
-		int curr_id   = exportGlobalIds[i];
-		int dest_rank = exportProcs[i];
-		levels[level - 1][curr_id]->updateRank(dest_rank);
-	}
+	updateNbrRanks(levels[level - 1], numExport, exportGlobalIds, exportProcs);
 
 	rc = Zoltan_Migrate(zz, numImport, importGlobalIds, importLocalIds, importProcs, importToPart,
 	                    numExport, exportGlobalIds, exportLocalIds, exportProcs, exportToPart);
@@ -523,12 +522,16 @@ template <size_t D> inline void BalancedLevelsGenerator<D>::balanceLevelWithLowe
 	                             &numExport, &exportGlobalIds, &exportLocalIds, &exportProcs,
 	                             &exportToPart);
 
-	// update ranks of neighbors before migrating
+	// update ranks of neighbors before migrating, the domains on the lower level are not moved
+	std::vector<ZOLTAN_ID_TYPE> upper_ids;
+	std::vector<int>            upper_procs;
 	for (int i = 0; i < numExport; i++) {
-		int curr_id   = exportGlobalIds[i];
-		int dest_rank = exportProcs[i];
-		levels.upper->at(curr_id)->updateRank(dest_rank);
+		if (levels.upper->count(exportGlobalIds[i])) {
+			upper_ids.push_back(exportGlobalIds[i]);
+			upper_procs.push_back(exportProcs[i]);
+		}
 	}
+	updateNbrRanks(*levels.upper, upper_ids.size(), upper_ids.data(), upper_procs.data());
 
 	rc = Zoltan_Migrate(zz, numImport, importGlobalIds, importLocalIds, importProcs, importToPart,
 	                    numExport, exportGlobalIds, exportLocalIds, exportProcs, exportToPart);
@@ -562,4 +565,61 @@ template <size_t D> inline void BalancedLevelsGenerator<D>::balanceLevelWithLowe
 		p.second->setPtrs(this->levels[level - 1]);
 	}
 }
+template <size_t D>
+inline void BalancedLevelsGenerator<D>::updateNbrRanks(DomainMap &level, int num_export,
+                                                       ZOLTAN_ID_PTR export_ids,
+                                                       int *         export_procs)
+{
+	// neighbors on this rank are updated directly, the ranks of the others are sent the id of the
+	// neighbor, the id of the domain that is moving, and its new rank
+	std::map<int, std::vector<int>> notices;
+	auto notify = [&](int rank, int nbr_id, int id, int new_rank) {
+		std::vector<int> &notice = notices[rank];
+		notice.push_back(nbr_id);
+		notice.push_back(id);
+		notice.push_back(new_rank);
+	};
+	for (int i = 0; i < num_export; i++) {
+		Domain<D> &d        = *level.at(export_ids[i]);
+		int        new_rank = export_procs[i];
+		for (Side<D> s : Side<D>::getValues()) {
+			if (!d.hasNbr(s)) { continue; }
+			switch (d.getNbrType(s)) {
+				case NbrType::Normal: {
+					NormalNbrInfo<D> &info = d.getNormalNbrInfo(s);
+					if (info.ptr != nullptr) {
+						info.ptr->getNormalNbrInfo(s.opposite()).updateRank(new_rank);
+					} else {
+						notify(info.rank, info.id, d.id, new_rank);
+					}
+				} break;
+				case NbrType::Coarse: {
+					CoarseNbrInfo<D> &info = d.getCoarseNbrInfo(s);
+					if (info.ptr != nullptr) {
+						info.ptr->getFineNbrInfo(s.opposite()).updateRank(new_rank,
+						                                                  info.quad_on_coarse);
+					} else {
+						notify(info.rank, info.id, d.id, new_rank);
+					}
+				} break;
+				case NbrType::Fine: {
+					FineNbrInfo<D> &info = d.getFineNbrInfo(s);
+					for (size_t j = 0; j < info.ids.size(); j++) {
+						if (info.ptrs[j] != nullptr) {
+							info.ptrs[j]->getCoarseNbrInfo(s.opposite()).updateRank(new_rank);
+						} else {
+							notify(info.ranks[j], info.ids[j], d.id, new_rank);
+						}
+					}
+				} break;
+			}
+		}
+	}
+	for (auto &p : Utils::sparseExchange(notices)) {
+		std::vector<int> &received = p.second;
+		for (size_t i = 0; i < received.size(); i += 3) {
+			level.at(received[i])->updateNbrRank(received[i + 1], received[i + 2]);
+		}
+	}
+}
 #endif
@@ -23,81 +23,70 @@
 #include "Utils.h"
 using namespace std;
 using namespace Utils;
-void BilinearInterpolator::interpolate(SchurDomain<2> &d, const Vec u, Vec interp)
+template <int N>
+template <int S>
+void BilinearInterpolator::InterpolateKernel<N>::visit()
 {
-	for (Side<2> s : Side<2>::getValues()) {
-		if (d.hasNbr(s)) {
-			std::deque<int>       idx;
-			std::deque<IfaceType> types;
-			d.getIfaceInfoPtr(s)->getIdxAndTypes(idx, types);
-			for (size_t i = 0; i < idx.size(); i++) {
-				interpolate(d, s, idx[i], types[i], u, interp);
-			}
-		}
-	}
-}
-void BilinearInterpolator::interpolate(SchurDomain<2> &d, Side<2> s, int local_index,
-                                       IfaceType itype, const Vec u, Vec interp)
-{
-	int     n = d.n;
-	double *interp_view;
-	VecGetArray(interp, &interp_view);
-	double *u_view;
-	VecGetArray(u, &u_view);
-	int idx = local_index * n;
+	// a compile-time constant in the specialized kernels
+	const int                       n = patchSize<N>(this->n);
+	FaceView<2, S, N, const double> face(patch, n);
+	// the half of the coarse face that a fine face is on
+	int off = itype.getOrthant() == 0 ? 0 : n;
 	switch (itype.toInt()) {
-		case IfaceType::normal: {
-			Slice<1> sl = getSlice<2>(d, u_view, s);
+		case IfaceType::normal:
+#pragma omp simd
 			for (int i = 0; i < n; i++) {
-				interp_view[idx + i] += 0.5 * sl({i});
+				interp[i] += 0.5 * face(i);
 			}
-		} break;
-		case IfaceType::coarse_to_coarse: {
-			Slice<1> sl = getSlice<2>(d, u_view, s);
-			// middle cases
+			break;
+		case IfaceType::coarse_to_coarse:
+#pragma omp simd
 			for (int i = 0; i < n; i++) {
-				interp_view[idx + i] += 1.0 / 3 * sl({i});
+				interp[i] += 1.0 / 3 * face(i);
 			}
-		} break;
-		case IfaceType::fine_to_coarse: {
-			Slice<1> sl = getSlice<2>(d, u_view, s);
-			if (itype.getOrthant() == 0) {
-				// middle cases
-				for (int i = 0; i < n; i += 2) {
-					interp_view[idx + i / 2] += 1.0 / 3 * sl({i}) + 1.0 / 3 * sl({i + 1});
-				}
-			} else {
-				// middle cases
-				for (int i = 0; i < n; i += 2) {
-					interp_view[idx + (n + i) / 2] += 1.0 / 3 * sl({i}) + 1.0 / 3 * sl({i + 1});
-				}
+			break;
+		case IfaceType::fine_to_coarse:
+			for (int i = 0; i < n; i += 2) {
+				interp[(off + i) / 2] += 1.0 / 3 * face(i) + 1.0 / 3 * face(i + 1);
 			}
-		} break;
-		case IfaceType::fine_to_fine: {
-			Slice<1> sl = getSlice<2>(d, u_view, s);
-			// middle cases
+			break;
+		case IfaceType::fine_to_fine:
 			for (int i = 0; i < n; i += 2) {
-				interp_view[idx + i] += 5.0 / 6 * sl({i}) - 1.0 / 6 * sl({i + 1});
+				interp[i] += 5.0 / 6 * face(i) - 1.0 / 6 * face(i + 1);
 			}
 			for (int i = 1; i < n; i += 2) {
-				interp_view[idx + i] += 5.0 / 6 * sl({i}) - 1.0 / 6 * sl({i - 1});
+				interp[i] += 5.0 / 6 * face(i) - 1.0 / 6 * face(i - 1);
 			}
-		} break;
-		case IfaceType::coarse_to_fine: {
-			Slice<1> sl = getSlice<2>(d, u_view, s);
-			if (itype.getOrthant() == 0) {
-				for (int i = 0; i < n; i++) {
-					interp_view[idx + i] += 2.0 / 6 * sl({i / 2});
-				}
-			} else {
-				// middle cases
-				for (int i = 0; i < n; i++) {
-					interp_view[idx + i] += 2.0 / 6 * sl({(n + i) / 2});
-				}
+			break;
+		case IfaceType::coarse_to_fine:
+			for (int i = 0; i < n; i++) {
+				interp[i] += 2.0 / 6 * face((off + i) / 2);
 			}
-		} break;
+			break;
 	}
-
-	VecRestoreArray(interp, &interp_view);
-	VecRestoreArray(u, &u_view);
+}
+template <int N>
+void BilinearInterpolator::InterpolateKernel<N>::run(int n, const PatchTable<2>::FacePlan &plan,
+                                                     IfaceType itype, const double *u_view,
+                                                     double *interp_view)
+{
+	InterpolateKernel<N> kernel
+	= {patchSize<N>(n), itype, u_view + plan.patch_start, interp_view + plan.interp_start};
+	visitSide(plan.side, kernel);
+}
+void BilinearInterpolator::interpolatePatch(const PatchTable<2> &patches, int patch,
+                                            const double *u_view, double *interp_view)
+{
+	int                            n      = patches.getN();
+	InterpolateKernel<0>::Function kernel = getKernel<InterpolateKernel>(n, specialized);
+	for (int i = patches.interpBegin(patch); i < patches.interpEnd(patch); i++) {
+		kernel(n, patches.getInterpPlan(i), patches.getInterpType(i), u_view, interp_view);
+	}
+}
+void BilinearInterpolator::interpolateIface(const PatchTable<2> &patches, int patch, Side<2> s,
+                                            int local_index, IfaceType itype,
+                                            const double *u_view, double *interp_view)
+{
+	getKernel<InterpolateKernel>(patches.getN(), specialized)(
+	patches.getN(), patches.getFacePlan(patch, s, local_index), itype, u_view, interp_view);
 }
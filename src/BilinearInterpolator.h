@@ -22,11 +22,48 @@
 #ifndef BILINEARINTERPOLATOR_H
 #define BILINEARINTERPOLATOR_H
 #include "Interpolator.h"
+/**
+ * @brief Interpolates the patches to the interface values.
+ *
+ * Each side is read through a Utils::FaceView, so the strides are compile-time constants. The
+ * kernel is compiled for the common patch sizes, see Utils::getKernel.
+ */
 class BilinearInterpolator : public Interpolator<2>
 {
+	private:
+	/**
+	 * @brief The interpolation from one side of a patch, compiled for patches of size N
+	 */
+	template <int N> struct InterpolateKernel {
+		typedef void (*Function)(int, const PatchTable<2>::FacePlan &, IfaceType, const double *,
+		                         double *);
+		int           n;
+		IfaceType     itype;
+		const double *patch;
+		double *      interp;
+		/**
+		 * @brief Interpolate from side S of the patch
+		 */
+		template <int S> void visit();
+		static void run(int n, const PatchTable<2>::FacePlan &plan, IfaceType itype,
+		                const double *u_view, double *interp_view);
+	};
+	bool specialized = true;
+
 	public:
-	void interpolate(SchurDomain<2> &d, const Vec u, Vec interp);
-	void interpolate(SchurDomain<2> &d, Side<2> s, int local_index, IfaceType itype, const Vec u,
-	                 Vec interp);
+	/**
+	 * @brief Set whether the kernels compiled for fixed patch sizes are used
+	 *
+	 * @param specialized true to use them for the sizes they exist for (the default), false to
+	 * always use the generic kernel
+	 */
+	void setSpecialized(bool specialized)
+	{
+		this->specialized = specialized;
+	}
+	void interpolatePatch(const PatchTable<2> &patches, int patch, const double *u_view,
+	                      double *interp_view);
+	void interpolateIface(const PatchTable<2> &patches, int patch, Side<2> s, int local_index,
+	                      IfaceType itype, const double *u_view, double *interp_view);
 };
 #endif
@@ -22,6 +22,7 @@
 #ifndef DOMAIN_H
 #define DOMAIN_H
 #include "BufferWriter.h"
+#include "IdIndex.h"
 #include "Serializable.h"
 #include "Side.h"
 #include <array>
@@ -76,14 +77,15 @@ template <size_t D> struct Domain : public Serializable {
 	FineNbrInfo<D> &  getFineNbrInfo(Side<D> s) const;
 	inline bool       hasNbr(Side<D> s) const;
 	inline bool       isNeumann(Side<D> s) const;
-	void              setLocalNeighborIndexes(std::map<int, int> &rev_map);
-	void              setGlobalNeighborIndexes(std::map<int, int> &rev_map);
+	void              setLocalNeighborIndexes(const IdIndex &rev_map);
+	void              setGlobalNeighborIndexes(const IdIndex &rev_map);
 	void              setNeumann();
 	std::vector<int>  getNbrIds();
 	int               serialize(char *buffer) const;
 	int               deserialize(char *buffer);
 	void              setPtrs(std::map<int, std::shared_ptr<Domain>> &domains);
 	void              updateRank(int rank);
+	void              updateNbrRank(int nbr_id, int rank);
 	inline bool       hasChildren()
 	{
 		return child_id[0] != -1;
@@ -95,8 +97,8 @@ template <size_t D> class NbrInfo : virtual public Serializable
 	virtual ~NbrInfo()                                                          = default;
 	virtual NbrType getNbrType()                                                = 0;
 	virtual void    getNbrIds(std::vector<int> &nbr_ids)                        = 0;
-	virtual void    setGlobalIndexes(std::map<int, int> &rev_map)               = 0;
-	virtual void    setLocalIndexes(std::map<int, int> &rev_map)                = 0;
+	virtual void    setGlobalIndexes(const IdIndex &rev_map)                    = 0;
+	virtual void    setLocalIndexes(const IdIndex &rev_map)                     = 0;
 	virtual void    setPtrs(std::map<int, std::shared_ptr<Domain<D>>> &domains) = 0;
 	virtual void    updateRankOnNeighbors(int new_rank, Side<D> s)              = 0;
 };
@@ -122,11 +124,11 @@ template <size_t D> class NormalNbrInfo : public NbrInfo<D>
 	{
 		nbr_ids.push_back(id);
 	};
-	void setGlobalIndexes(std::map<int, int> &rev_map)
+	void setGlobalIndexes(const IdIndex &rev_map)
 	{
 		global_index = rev_map.at(local_index);
 	}
-	void setLocalIndexes(std::map<int, int> &rev_map)
+	void setLocalIndexes(const IdIndex &rev_map)
 	{
 		local_index = rev_map.at(id);
 	}
@@ -185,11 +187,11 @@ template <size_t D> class CoarseNbrInfo : public NbrInfo<D>
 	{
 		nbr_ids.push_back(id);
 	};
-	void setGlobalIndexes(std::map<int, int> &rev_map)
+	void setGlobalIndexes(const IdIndex &rev_map)
 	{
 		global_index = rev_map.at(local_index);
 	}
-	void setLocalIndexes(std::map<int, int> &rev_map)
+	void setLocalIndexes(const IdIndex &rev_map)
 	{
 		local_index = rev_map.at(id);
 	}
@@ -251,13 +253,13 @@ template <size_t D> class FineNbrInfo : public NbrInfo<D>
 			nbr_ids.push_back(ids[i]);
 		}
 	};
-	void setGlobalIndexes(std::map<int, int> &rev_map)
+	void setGlobalIndexes(const IdIndex &rev_map)
 	{
 		for (size_t i = 0; i < global_indexes.size(); i++) {
 			global_indexes[i] = rev_map.at(local_indexes[i]);
 		}
 	}
-	void setLocalIndexes(std::map<int, int> &rev_map)
+	void setLocalIndexes(const IdIndex &rev_map)
 	{
 		for (size_t i = 0; i < local_indexes.size(); i++) {
 			local_indexes[i] = rev_map.at(ids[i]);
@@ -339,14 +341,14 @@ template <size_t D> inline bool Domain<D>::isNeumann(Side<D> s) const
 {
 	return neumann[s.toInt()];
 }
-template <size_t D> inline void Domain<D>::setLocalNeighborIndexes(std::map<int, int> &rev_map)
+template <size_t D> inline void Domain<D>::setLocalNeighborIndexes(const IdIndex &rev_map)
 {
 	id_local = rev_map.at(id);
 	for (Side<D> s : Side<D>::getValues()) {
 		if (hasNbr(s)) { getNbrInfoPtr(s)->setLocalIndexes(rev_map); }
 	}
 }
-template <size_t D> inline void Domain<D>::setGlobalNeighborIndexes(std::map<int, int> &rev_map)
+template <size_t D> inline void Domain<D>::setGlobalNeighborIndexes(const IdIndex &rev_map)
 {
 	id_global = rev_map.at(id_local);
 	for (Side<D> s : Side<D>::getValues()) {
@@ -459,4 +461,30 @@ template <size_t D> inline void Domain<D>::updateRank(int rank)
 		if (hasNbr(s)) { getNbrInfoPtr(s)->updateRankOnNeighbors(rank, s); }
 	}
 }
+/**
+ * @brief Set the rank of a neighbor, for when the neighbor is on another rank and is moved
+ *
+ * @param nbr_id the id of the neighbor
+ * @param rank the new rank of the neighbor
+ */
+template <size_t D> inline void Domain<D>::updateNbrRank(int nbr_id, int rank)
+{
+	for (Side<D> s : Side<D>::getValues()) {
+		if (!hasNbr(s)) { continue; }
+		switch (getNbrType(s)) {
+			case NbrType::Normal:
+				if (getNormalNbrInfo(s).id == nbr_id) { getNormalNbrInfo(s).updateRank(rank); }
+				break;
+			case NbrType::Coarse:
+				if (getCoarseNbrInfo(s).id == nbr_id) { getCoarseNbrInfo(s).updateRank(rank); }
+				break;
+			case NbrType::Fine: {
+				FineNbrInfo<D> &info = getFineNbrInfo(s);
+				for (size_t i = 0; i < info.ids.size(); i++) {
+					if (info.ids[i] == nbr_id) { info.updateRank(rank, i); }
+				}
+			} break;
+		}
+	}
+}
 #endif
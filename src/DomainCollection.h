@@ -22,6 +22,7 @@
 #ifndef DOMAINSIGNATURECOLLECTION_H
 #define DOMAINSIGNATURECOLLECTION_H
 #include "Domain.h"
+#include "IdIndex.h"
 #include "InterpCase.h"
 #include "OctTree.h"
 #include "PW.h"
@@ -29,6 +30,7 @@
 #include <map>
 #include <memory>
 #include <petscao.h>
+#include <petscmat.h>
 #include <petscvec.h>
 #include <set>
 #include <string>
@@ -47,41 +49,32 @@ template <size_t D> class DomainCollection
 	int  n = -1;
 	void indexDomainsLocal()
 	{
-		int                curr_i = 0;
-		std::vector<int>   map_vec;
-		std::vector<int>   off_proc_map_vec;
-		std::map<int, int> rev_map;
-		std::set<int>      offs;
-		if (!domains.empty()) {
-			std::set<int> todo;
-			for (auto &p : domains) {
-				todo.insert(p.first);
-			}
-			std::set<int> enqueued;
-			while (!todo.empty()) {
-				std::deque<int> queue;
-				queue.push_back(*todo.begin());
-				enqueued.insert(*todo.begin());
-				while (!queue.empty()) {
-					int i = queue.front();
-					todo.erase(i);
-					queue.pop_front();
-					map_vec.push_back(i);
-					Domain<D> &d = *domains[i];
-					rev_map[i]   = curr_i;
-					d.id_local   = curr_i;
-					curr_i++;
-					for (int i : d.getNbrIds()) {
-						if (!enqueued.count(i)) {
-							enqueued.insert(i);
-							if (domains.count(i)) {
-								queue.push_back(i);
-							} else {
-								if (!offs.count(i)) {
-									offs.insert(i);
-									off_proc_map_vec.push_back(i);
-								}
-							}
+		int              curr_i = 0;
+		std::vector<int> map_vec;
+		std::vector<int> off_proc_map_vec;
+		IdIndex          rev_map(domains.size());
+		// breadth first from the lowest id that has not been reached yet
+		IdIndex         enqueued(domains.size());
+		std::deque<int> queue;
+		for (auto &p : domains) {
+			if (enqueued.count(p.first)) { continue; }
+			queue.push_back(p.first);
+			enqueued[p.first] = 1;
+			while (!queue.empty()) {
+				int i = queue.front();
+				queue.pop_front();
+				map_vec.push_back(i);
+				Domain<D> &d = *domains.at(i);
+				rev_map[i]   = curr_i;
+				d.id_local   = curr_i;
+				curr_i++;
+				for (int i : d.getNbrIds()) {
+					if (!enqueued.count(i)) {
+						enqueued[i] = 1;
+						if (domains.count(i)) {
+							queue.push_back(i);
+						} else {
+							off_proc_map_vec.push_back(i);
 						}
 					}
 				}
@@ -123,7 +116,7 @@ template <size_t D> class DomainCollection
 
 		// get new global indices
 		AOApplicationToPetsc(ao, inds.size(), &inds[0]);
-		std::map<int, int> rev_map;
+		IdIndex rev_map(inds.size());
 		for (size_t i = 0; i < inds.size(); i++) {
 			rev_map[i] = inds[i];
 		}
@@ -202,6 +195,18 @@ template <size_t D> class DomainCollection
 		VecCreateMPI(MPI_COMM_WORLD, domains.size() * std::pow(n, D), PETSC_DETERMINE, &u);
 		return u;
 	}
+	/**
+	 * @brief Get a new dense matrix where each column has the layout of a domain vector
+	 *
+	 * @param num_rhs the number of columns
+	 */
+	PW_explicit<Mat> getNewDomainMat(int num_rhs) const
+	{
+		PW<Mat> u;
+		MatCreateDense(MPI_COMM_WORLD, domains.size() * std::pow(n, D), PETSC_DECIDE,
+		               PETSC_DETERMINE, num_rhs, nullptr, &u);
+		return u;
+	}
 
 	int getGlobalNumDomains()
 	{
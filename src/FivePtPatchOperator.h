@@ -22,110 +22,177 @@
 #ifndef FIVEPTPATCHOPERATOR_H
 #define FIVEPTPATCHOPERATOR_H
 #include "PatchOperator.h"
+#include "Utils.h"
+/**
+ * @brief Five point stencil operator.
+ *
+ * With a PatchArray the ghost values are already in place, and every row is a single loop. The
+ * kernels are compiled for the common patch sizes, see Utils::getKernel.
+ */
 class FivePtPatchOperator : public PatchOperator<2>
 {
+	private:
+	/**
+	 * @brief The stencil applied to one patch, compiled for patches of size N
+	 */
+	template <int N> struct ApplyKernel {
+		typedef void (*Function)(const PatchTable<2> &, int, const double *, const double *,
+		                         double *);
+		static void run(const PatchTable<2> &patches, int patch, const double *u_view,
+		                const double *gamma_view, double *f_view);
+	};
+	/**
+	 * @brief The stencil applied to one patch of a ghost-padded array, compiled for patches of
+	 * size N
+	 */
+	template <int N> struct PaddedKernel {
+		typedef void (*Function)(const PatchTable<2> &, int, const PatchArray<2> &, double *);
+		static void run(const PatchTable<2> &patches, int patch, const PatchArray<2> &u,
+		                double *f_view);
+	};
+	bool specialized = true;
+
 	public:
-	void apply(SchurDomain<2> &d, const Vec u, const Vec gamma, Vec f)
+	/**
+	 * @brief Set whether the kernels compiled for fixed patch sizes are used
+	 *
+	 * @param specialized true to use them for the sizes they exist for (the default), false to
+	 * always use the generic kernel
+	 */
+	void setSpecialized(bool specialized)
 	{
-		int     n     = d.n;
-		double  h_x   = d.domain.lengths[0] / n;
-		double  h_y   = d.domain.lengths[1] / n;
-		int     start = n * n * d.domain.id_local;
-		double *u_view, *f_view, *gamma_view;
-		VecGetArray(u, &u_view);
-		VecGetArray(f, &f_view);
-		double *f_ptr = f_view + start;
-		double *u_ptr = u_view + start;
-		VecGetArray(gamma, &gamma_view);
-		const double *boundary_north = nullptr;
-		if (d.hasNbr(Side<2>::north)) {
-			boundary_north = &gamma_view[d.n * d.getIfaceLocalIndex(Side<2>::north)];
-		}
-		const double *boundary_east = nullptr;
-		if (d.hasNbr(Side<2>::east)) {
-			boundary_east = &gamma_view[d.n * d.getIfaceLocalIndex(Side<2>::east)];
-		}
-		const double *boundary_south = nullptr;
-		if (d.hasNbr(Side<2>::south)) {
-			boundary_south = &gamma_view[d.n * d.getIfaceLocalIndex(Side<2>::south)];
-		}
-		const double *boundary_west = nullptr;
-		if (d.hasNbr(Side<2>::west)) {
-			boundary_west = &gamma_view[d.n * d.getIfaceLocalIndex(Side<2>::west)];
+		this->specialized = specialized;
+	}
+	void applyPatch(const PatchTable<2> &patches, int patch, const double *u_view,
+	                const double *gamma_view, double *f_view)
+	{
+		Utils::getKernel<ApplyKernel>(patches.getN(), specialized)(patches, patch, u_view,
+		                                                           gamma_view, f_view);
+	}
+	void applyPaddedPatch(const PatchTable<2> &patches, int patch, const PatchArray<2> &padded,
+	                      const double *u_view, const double *gamma_view, double *f_view)
+	{
+		Utils::getKernel<PaddedKernel>(patches.getN(), specialized)(patches, patch, padded,
+		                                                            f_view);
+	}
+};
+template <int N>
+inline void FivePtPatchOperator::ApplyKernel<N>::run(const PatchTable<2> &patches, int patch,
+                                                     const double *u_view,
+                                                     const double *gamma_view, double *f_view)
+{
+	int           n     = Utils::patchSize<N>(patches.getN());
+	double        h_x   = patches.getSpacing(patch, 0);
+	double        h_y   = patches.getSpacing(patch, 1);
+	int           start = n * n * patches.getLocalIndex(patch);
+	double *      f_ptr = f_view + start;
+	const double *u_ptr = u_view + start;
+	const double *boundary_north = nullptr;
+	if (patches.hasNbr(patch, Side<2>::north)) {
+		boundary_north = &gamma_view[n * patches.getIfaceLocalIndex(patch, Side<2>::north)];
+	}
+	const double *boundary_east = nullptr;
+	if (patches.hasNbr(patch, Side<2>::east)) {
+		boundary_east = &gamma_view[n * patches.getIfaceLocalIndex(patch, Side<2>::east)];
+	}
+	const double *boundary_south = nullptr;
+	if (patches.hasNbr(patch, Side<2>::south)) {
+		boundary_south = &gamma_view[n * patches.getIfaceLocalIndex(patch, Side<2>::south)];
+	}
+	const double *boundary_west = nullptr;
+	if (patches.hasNbr(patch, Side<2>::west)) {
+		boundary_west = &gamma_view[n * patches.getIfaceLocalIndex(patch, Side<2>::west)];
+	}
+	// integrate in x secton
+	double center, north, east, south, west;
+	// west
+	for (int j = 0; j < n; j++) {
+		west = 0;
+		if (boundary_west != nullptr) { west = boundary_west[j]; }
+		center = u_ptr[j * n];
+		east   = u_ptr[j * n + 1];
+		if (patches.isNeumann(patch, Side<2>::west) && boundary_west == nullptr) {
+			f_ptr[j * n] = (-h_x * west - center + east) / (h_x * h_x);
+		} else {
+			f_ptr[j * n] = (2 * west - 3 * center + east) / (h_x * h_x);
 		}
-		// integrate in x secton
-		double center, north, east, south, west;
-		// west
+	}
+	// middle
+	for (int i = 1; i < n - 1; i++) {
 		for (int j = 0; j < n; j++) {
-			west = 0;
-			if (boundary_west != nullptr) { west = boundary_west[j]; }
-			center = u_ptr[j * n];
-			east   = u_ptr[j * n + 1];
-			if (d.isNeumann(Side<2>::west) && !d.hasNbr(Side<2>::west)) {
-				f_ptr[j * n] = (-h_x * west - center + east) / (h_x * h_x);
-			} else {
-				f_ptr[j * n] = (2 * west - 3 * center + east) / (h_x * h_x);
-			}
-		}
-		// middle
-		for (int i = 1; i < n - 1; i++) {
-			for (int j = 0; j < n; j++) {
-				east   = u_ptr[j * n + i - 1];
-				center = u_ptr[j * n + i];
-				west   = u_ptr[j * n + i + 1];
+			east   = u_ptr[j * n + i - 1];
+			center = u_ptr[j * n + i];
+			west   = u_ptr[j * n + i + 1];
 
-				f_ptr[j * n + i] = (west - 2 * center + east) / (h_x * h_x);
-			}
+			f_ptr[j * n + i] = (west - 2 * center + east) / (h_x * h_x);
 		}
-		// east
-		for (int j = 0; j < n; j++) {
-			west   = u_ptr[j * n + n - 2];
-			center = u_ptr[j * n + n - 1];
-			east   = 0;
-			if (boundary_east != nullptr) { east = boundary_east[j]; }
-			if (d.isNeumann(Side<2>::east) && !d.hasNbr(Side<2>::east)) {
-				f_ptr[j * n + n - 1] = (west - center + h_x * east) / (h_x * h_x);
-			} else {
-				f_ptr[j * n + n - 1] = (west - 3 * center + 2 * east) / (h_x * h_x);
-			}
+	}
+	// east
+	for (int j = 0; j < n; j++) {
+		west   = u_ptr[j * n + n - 2];
+		center = u_ptr[j * n + n - 1];
+		east   = 0;
+		if (boundary_east != nullptr) { east = boundary_east[j]; }
+		if (patches.isNeumann(patch, Side<2>::east) && boundary_east == nullptr) {
+			f_ptr[j * n + n - 1] = (west - center + h_x * east) / (h_x * h_x);
+		} else {
+			f_ptr[j * n + n - 1] = (west - 3 * center + 2 * east) / (h_x * h_x);
 		}
-		// south
-		for (int i = 0; i < n; i++) {
-			south = 0;
-			if (boundary_south != nullptr) { south = boundary_south[i]; }
-			center = u_ptr[i];
-			north  = u_ptr[n + i];
-			if (d.isNeumann(Side<2>::south) && !d.hasNbr(Side<2>::south)) {
-				f_ptr[i] += (-h_y * south - center + north) / (h_y * h_y);
-			} else {
-				f_ptr[i] += (2 * south - 3 * center + north) / (h_y * h_y);
-			}
+	}
+	// south
+	for (int i = 0; i < n; i++) {
+		south = 0;
+		if (boundary_south != nullptr) { south = boundary_south[i]; }
+		center = u_ptr[i];
+		north  = u_ptr[n + i];
+		if (patches.isNeumann(patch, Side<2>::south) && boundary_south == nullptr) {
+			f_ptr[i] += (-h_y * south - center + north) / (h_y * h_y);
+		} else {
+			f_ptr[i] += (2 * south - 3 * center + north) / (h_y * h_y);
 		}
-		// middle
-		for (int i = 0; i < n; i++) {
-			for (int j = 1; j < n - 1; j++) {
-				south  = u_ptr[(j - 1) * n + i];
-				center = u_ptr[j * n + i];
-				north  = u_ptr[(j + 1) * n + i];
+	}
+	// middle
+	for (int i = 0; i < n; i++) {
+		for (int j = 1; j < n - 1; j++) {
+			south  = u_ptr[(j - 1) * n + i];
+			center = u_ptr[j * n + i];
+			north  = u_ptr[(j + 1) * n + i];
 
-				f_ptr[j * n + i] += (south - 2 * center + north) / (h_y * h_y);
-			}
+			f_ptr[j * n + i] += (south - 2 * center + north) / (h_y * h_y);
 		}
-		// north
-		for (int i = 0; i < n; i++) {
-			south  = u_ptr[(n - 2) * n + i];
-			center = u_ptr[(n - 1) * n + i];
-			north  = 0;
-			if (boundary_north != nullptr) { north = boundary_north[i]; }
-			if (d.isNeumann(Side<2>::north) && !d.hasNbr(Side<2>::north)) {
-				f_ptr[(n - 1) * n + i] += (south - center + h_y * north) / (h_y * h_y);
-			} else {
-				f_ptr[(n - 1) * n + i] += (south - 3 * center + 2 * north) / (h_y * h_y);
-			}
+	}
+	// north
+	for (int i = 0; i < n; i++) {
+		south  = u_ptr[(n - 2) * n + i];
+		center = u_ptr[(n - 1) * n + i];
+		north  = 0;
+		if (boundary_north != nullptr) { north = boundary_north[i]; }
+		if (patches.isNeumann(patch, Side<2>::north) && boundary_north == nullptr) {
+			f_ptr[(n - 1) * n + i] += (south - center + h_y * north) / (h_y * h_y);
+		} else {
+			f_ptr[(n - 1) * n + i] += (south - 3 * center + 2 * north) / (h_y * h_y);
 		}
-		VecRestoreArray(gamma, &gamma_view);
-		VecRestoreArray(u, &u_view);
-		VecRestoreArray(f, &f_view);
 	}
-};
+}
+template <int N>
+inline void FivePtPatchOperator::PaddedKernel<N>::run(const PatchTable<2> &patches, int patch,
+                                                      const PatchArray<2> &u, double *f_view)
+{
+	int           n       = Utils::patchSize<N>(patches.getN());
+	int           y_step  = n + 2;
+	double        ih_x2   = 1.0 / (patches.getSpacing(patch, 0) * patches.getSpacing(patch, 0));
+	double        ih_y2   = 1.0 / (patches.getSpacing(patch, 1) * patches.getSpacing(patch, 1));
+	double *      f_ptr   = f_view + n * n * patches.getLocalIndex(patch);
+	const double *u_first = u.getPatch(patch);
+	for (int yi = 0; yi < n; yi++) {
+		const double *row   = u_first + yi * y_step;
+		double *      f_row = f_ptr + yi * n;
+#pragma omp simd
+		for (int xi = 0; xi < n; xi++) {
+			double center = row[xi];
+			f_row[xi]     = (row[xi - 1] - 2 * center + row[xi + 1]) * ih_x2
+			            + (row[xi - y_step] - 2 * center + row[xi + y_step]) * ih_y2;
+		}
+	}
+}
 #endif
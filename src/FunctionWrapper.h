@@ -27,15 +27,11 @@
 template <size_t D> class FuncWrap
 {
 	public:
-	PW<Vec>              u;
-	PW<Vec>              f;
 	SchurHelper<D> *     sh = nullptr;
 	DomainCollection<D> *dc = nullptr;
 	FuncWrap()              = default;
 	FuncWrap(SchurHelper<D> *sh, DomainCollection<D> *dc)
 	{
-		f        = dc->getNewDomainVec();
-		u        = dc->getNewDomainVec();
 		this->sh = sh;
 		this->dc = dc;
 	}
@@ -43,7 +39,7 @@ template <size_t D> class FuncWrap
 	{
 		FuncWrap *w = nullptr;
 		MatShellGetContext(A, &w);
-		w->sh->solveWithInterface(w->f, w->u, x, y);
+		w->sh->applySchurMatrix(x, y);
 		return 0;
 	}
 	static PW_explicit<Mat> getMatrix(SchurHelper<D> *sh, DomainCollection<D> *dc)
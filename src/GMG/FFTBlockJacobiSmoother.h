@@ -37,16 +37,24 @@ template <size_t D> class FFTBlockJacobiSmoother : public Smoother
 	 * @brief point to the SchurHelper object.
 	 */
 	std::shared_ptr<SchurHelper<D>> sh;
+	/**
+	 * @brief the patch solver that is used for the smoothing
+	 */
+	std::shared_ptr<PatchSolver<D>> solver;
 
 	public:
 	/**
 	 * @brief Create new smoother with SchurHelper object
 	 *
 	 * @param sh pointer to the SchurHelper object
+	 * @param solver the patch solver to smooth with, the solver of sh is used if not set. The
+	 * domains of sh have to be added to it.
 	 */
-	FFTBlockJacobiSmoother(std::shared_ptr<SchurHelper<D>> sh)
+	FFTBlockJacobiSmoother(std::shared_ptr<SchurHelper<D>> sh,
+	                       std::shared_ptr<PatchSolver<D>> solver = nullptr)
 	{
-		this->sh = sh;
+		this->sh     = sh;
+		this->solver = solver == nullptr ? sh->getSolver() : solver;
 	}
 	/**
 	 * @brief Run an iteration of smoothing.
@@ -56,7 +64,7 @@ template <size_t D> class FFTBlockJacobiSmoother : public Smoother
 	 */
 	void smooth(PW<Vec> f, PW<Vec> u) const
 	{
-		sh->solveWithSolution(f, u);
+		sh->solveWithSolution(f, u, *solver);
 	}
 };
 } // namespace GMG
@@ -25,6 +25,7 @@
 #include "FFTBlockJacobiSmoother.h"
 #include "MatOp.h"
 #include "MatrixHelper.h"
+#include "PatchSolvers/FftwPatchSolver.h"
 #include "TriLinIntp.h"
 #include "VCycle.h"
 #include "WCycle.h"
@@ -87,10 +88,36 @@ Helper::Helper(int n, std::vector<std::shared_ptr<DomainCollection<3>>> dcs,
 	}
 
 	// generate smoothers
+	string smoother_precision;
+	try {
+		smoother_precision = config_j.at("smoother_precision");
+	} catch (nlohmann::detail::out_of_range oor) {
+		smoother_precision = "double";
+	}
+	shared_ptr<PatchSolver<3>> smoother_solver = sh->getSolver();
+	if (smoother_precision == "single") {
+#ifdef HAVE_FFTWF
+		// the smoothers get their own solver on the same helpers, so the operators stay in double
+		// precision
+		shared_ptr<FftwPatchSolver<3>> single_solver(new FftwPatchSolver<3>(*dcs[0]));
+		single_solver->setSinglePrecision(true);
+		for (int i = 0; i < num_levels; i++) {
+			for (SchurDomain<3> &sd : helpers[i]->getSchurDomains()) {
+				single_solver->addDomain(sd);
+			}
+		}
+		smoother_solver = single_solver;
+#else
+		int rank;
+		MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+		if (rank == 0) {
+			cerr << "GMG: single precision smoothers need fftw3f, using double" << endl;
+		}
+#endif
+	}
 	vector<shared_ptr<Smoother>> smoothers(num_levels);
-	smoothers[0].reset(new FFTBlockJacobiSmoother<3>(sh));
-	for (int i = 1; i < num_levels; i++) {
-		smoothers[i].reset(new FFTBlockJacobiSmoother<3>(helpers[i]));
+	for (int i = 0; i < num_levels; i++) {
+		smoothers[i].reset(new FFTBlockJacobiSmoother<3>(helpers[i], smoother_solver));
 	}
 
 	// generate inter-level comms, restrictors, interpolators
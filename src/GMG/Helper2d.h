@@ -19,8 +19,8 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  ***************************************************************************/
 
-#ifndef GMGHELPER_H
-#define GMGHELPER_H
+#ifndef GMGHELPER2D_H
+#define GMGHELPER2D_H
 #include "Cycle.h"
 #include "DomainCollection.h"
 #include "SchurHelper.h"
@@ -22,6 +22,7 @@
 #ifndef InterLevelComm_H
 #define InterLevelComm_H
 #include "DomainCollection.h"
+#include "SparseExchange.h"
 namespace GMG
 {
 /**
@@ -120,14 +121,18 @@ inline InterLevelComm<D>::InterLevelComm(std::shared_ptr<DomainCollection<D>> co
 		Domain<D> &d = *p.second;
 		parent_ids.insert(d.parent_id);
 	}
-	vector<int> coarse_parent_global_index_map_vec(parent_ids.begin(), parent_ids.end());
-	vector<int> coarse_parent_gid_map_vec = coarse_parent_global_index_map_vec;
-	// get global indexes for parent domains
-	PW<AO> ao;
-	AOCreateMapping(MPI_COMM_WORLD, coarse_dc->domain_gid_map_vec.size(),
-	                &coarse_dc->domain_gid_map_vec[0], &coarse_dc->domain_map_vec[0], &ao);
-	AOApplicationToPetsc(ao, coarse_parent_global_index_map_vec.size(),
-	                     &coarse_parent_global_index_map_vec[0]);
+	vector<int> coarse_parent_gid_map_vec(parent_ids.begin(), parent_ids.end());
+	// get global indexes for parent domains from the ranks that own them
+	map<int, int> owned_global_indexes;
+	for (size_t i = 0; i < coarse_dc->domain_gid_map_vec.size(); i++) {
+		owned_global_indexes[coarse_dc->domain_gid_map_vec[i]] = coarse_dc->domain_map_vec[i];
+	}
+	map<int, int> parent_global_indexes
+	= Utils::sparseLookup(owned_global_indexes, coarse_parent_gid_map_vec);
+	vector<int> coarse_parent_global_index_map_vec;
+	for (int gid : coarse_parent_gid_map_vec) {
+		coarse_parent_global_index_map_vec.push_back(parent_global_indexes.at(gid));
+	}
 
 	// set index info
 	map<int, int> gid_to_local;
@@ -0,0 +1,132 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef IDINDEX_H
+#define IDINDEX_H
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+/**
+ * @brief A map from ids to indexes that is used while indexing domains and interfaces.
+ *
+ * The keys and values are kept in flat arrays with open addressing and linear probing, so lookups
+ * do not chase pointers and inserting does not allocate, other than when the table grows. The
+ * interface follows the parts of std::map<int, int> that the indexing code uses. INT_MIN can not
+ * be used as a key.
+ */
+class IdIndex
+{
+	private:
+	enum : int { no_key = INT_MIN };
+	std::vector<int> keys;
+	std::vector<int> values;
+	size_t           num_keys = 0;
+	size_t           mask     = 0;
+
+	size_t slot(int key) const
+	{
+		// fibonacci hashing spreads out consecutive ids
+		uint64_t hash = (uint64_t)(uint32_t) key * 11400714819323198485ull;
+		size_t   i    = (hash >> 32) & mask;
+		while (keys[i] != no_key && keys[i] != key) {
+			i = (i + 1) & mask;
+		}
+		return i;
+	}
+	void rehash(size_t capacity)
+	{
+		std::vector<int> old_keys   = std::move(keys);
+		std::vector<int> old_values = std::move(values);
+		keys.assign(capacity, no_key);
+		values.assign(capacity, 0);
+		mask = capacity - 1;
+		for (size_t i = 0; i < old_keys.size(); i++) {
+			if (old_keys[i] != no_key) {
+				size_t j  = slot(old_keys[i]);
+				keys[j]   = old_keys[i];
+				values[j] = old_values[i];
+			}
+		}
+	}
+
+	public:
+	/**
+	 * @brief Create an empty IdIndex
+	 *
+	 * @param expected the number of keys to make room for
+	 */
+	explicit IdIndex(size_t expected = 0)
+	{
+		reserve(expected);
+	}
+	/**
+	 * @brief Make room for a number of keys, so that the table does not have to grow while they
+	 * are inserted
+	 */
+	void reserve(size_t expected)
+	{
+		// keep the load factor at or below one half
+		size_t capacity = 16;
+		while (capacity < 2 * expected) {
+			capacity *= 2;
+		}
+		if (capacity > keys.size()) { rehash(capacity); }
+	}
+	/**
+	 * @brief Get the value for a key, inserting it with a value of 0 if it is not there
+	 */
+	int &operator[](int key)
+	{
+		if (2 * (num_keys + 1) > keys.size()) { rehash(keys.empty() ? 16 : 2 * keys.size()); }
+		size_t i = slot(key);
+		if (keys[i] == no_key) {
+			keys[i]   = key;
+			values[i] = 0;
+			num_keys++;
+		}
+		return values[i];
+	}
+	/**
+	 * @brief Get the value for a key
+	 *
+	 * @throws std::out_of_range if the key is not there
+	 */
+	int at(int key) const
+	{
+		if (keys.empty()) { throw std::out_of_range("IdIndex::at"); }
+		size_t i = slot(key);
+		if (keys[i] == no_key) { throw std::out_of_range("IdIndex::at"); }
+		return values[i];
+	}
+	/**
+	 * @brief Get the number of times the key is in the index, which is 0 or 1
+	 */
+	size_t count(int key) const
+	{
+		return !keys.empty() && keys[slot(key)] != no_key;
+	}
+	size_t size() const
+	{
+		return num_keys;
+	}
+};
+#endif
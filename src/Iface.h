@@ -22,6 +22,7 @@
 #ifndef IFACE_H
 #define IFACE_H
 #include "BufferWriter.h"
+#include "IdIndex.h"
 #include "IfaceType.h"
 #include "Side.h"
 #include <bitset>
@@ -78,7 +79,7 @@ template <size_t D> struct IfaceSet : public Serializable {
 			ifaces.push_back(i);
 		}
 	}
-	void setLocalIndexes(const std::map<int, int> &rev_map)
+	void setLocalIndexes(const IdIndex &rev_map)
 	{
 		id_local = rev_map.at(id);
 		for (Iface<D> &iface : ifaces) {
@@ -87,7 +88,7 @@ template <size_t D> struct IfaceSet : public Serializable {
 			}
 		}
 	}
-	void setGlobalIndexes(const std::map<int, int> &rev_map)
+	void setGlobalIndexes(const IdIndex &rev_map)
 	{
 		id_global = rev_map.at(id_local);
 		for (Iface<D> &iface : ifaces) {
@@ -21,6 +21,7 @@
 
 #ifndef IFACETYPE_H
 #define IFACETYPE_H
+#include <tuple>
 /*
 enum class IfaceType {
 	normal,
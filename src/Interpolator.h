@@ -22,7 +22,7 @@
 #ifndef INTERPOLATOR_H
 #define INTERPOLATOR_H
 #include "Iface.h"
-#include "SchurDomain.h"
+#include "PatchTable.h"
 #include "Side.h"
 #include <petscvec.h>
 template <size_t D>
@@ -30,9 +30,84 @@ class Interpolator
 {
 	public:
 	virtual ~Interpolator() {}
-	virtual void interpolate(SchurDomain<D> &d, const Vec u, Vec interp) = 0;
-	virtual void interpolate(SchurDomain<D> &d, Side<D> s, int local_index, IfaceType itype,
-	                         const Vec u, Vec interp)
+	/**
+	 * @brief Interpolate every patch in a table to its interface values, the values are added to
+	 * interp
+	 *
+	 * The colors of the table are done one after the other, and the patches of each color are
+	 * split between the threads. The patches that are marked as zero in the table are skipped.
+	 *
+	 * @param patches the patches
+	 * @param u the solution vector
+	 * @param interp the local interface values
+	 */
+	void interpolate(const PatchTable<D> &patches, const Vec u, Vec interp)
+	{
+		const double *u_view;
+		double *      interp_view;
+		VecGetArrayRead(u, &u_view);
+		VecGetArray(interp, &interp_view);
+		for (int color = 0; color < patches.getNumColors(); color++) {
+			const std::vector<int> &color_patches = patches.getColorPatches(color);
+#pragma omp parallel for schedule(static)
+			for (int i = 0; i < (int) color_patches.size(); i++) {
+				int patch = color_patches[i];
+				if (patches.isZero(patch)) { continue; }
+				interpolatePatch(patches, patch, u_view, interp_view);
+			}
+		}
+		VecRestoreArrayRead(u, &u_view);
+		VecRestoreArray(interp, &interp_view);
+	}
+	/**
+	 * @brief Interpolate one patch to all of its interface values, the values are added to
+	 * interp_view
+	 *
+	 * The default calls interpolateIface for each entry of the patch, interpolators can override
+	 * this to go through the precomputed PatchTable::FacePlan of each entry instead.
+	 *
+	 * @param patches the patches
+	 * @param patch the index of the patch in the table
+	 * @param u_view the solution vector
+	 * @param interp_view the local interface values
+	 */
+	virtual void interpolatePatch(const PatchTable<D> &patches, int patch, const double *u_view,
+	                              double *interp_view)
+	{
+		for (int i = patches.interpBegin(patch); i < patches.interpEnd(patch); i++) {
+			interpolateIface(patches, patch, patches.getInterpSide(i),
+			                 patches.getInterpLocalIndex(i), patches.getInterpType(i), u_view,
+			                 interp_view);
+		}
+	}
+	/**
+	 * @brief Interpolate one patch to one interface value, the values are added to interp
+	 */
+	void interpolate(const PatchTable<D> &patches, int patch, Side<D> s, int local_index,
+	                 IfaceType itype, const Vec u, Vec interp)
+	{
+		const double *u_view;
+		double *      interp_view;
+		VecGetArrayRead(u, &u_view);
+		VecGetArray(interp, &interp_view);
+		interpolateIface(patches, patch, s, local_index, itype, u_view, interp_view);
+		VecRestoreArrayRead(u, &u_view);
+		VecRestoreArray(interp, &interp_view);
+	}
+	/**
+	 * @brief Interpolate one patch to one interface value, the values are added to interp_view
+	 *
+	 * @param patches the patches
+	 * @param patch the index of the patch in the table
+	 * @param s the side of the patch that the interface is on
+	 * @param local_index the local index of the interface value
+	 * @param itype the type of the interface value
+	 * @param u_view the solution vector
+	 * @param interp_view the local interface values
+	 */
+	virtual void interpolateIface(const PatchTable<D> &patches, int patch, Side<D> s,
+	                              int local_index, IfaceType itype, const double *u_view,
+	                              double *interp_view)
 	= 0;
 };
 #endif
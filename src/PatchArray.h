@@ -0,0 +1,202 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef PATCHARRAY_H
+#define PATCHARRAY_H
+#include "PatchTable.h"
+#include <array>
+#include <petscvec.h>
+#include <vector>
+/**
+ * @brief Copies of the patches of a domain vector, each padded with a layer of ghost cells
+ *
+ * Each patch is stored as an (n+2)^D block, with x the fastest axis. The ghost cells on each side
+ * are set by fill from the interface values, or from the boundary condition when there is no
+ * neighbor, so that a stencil can be applied to every cell of the patch without boundary cases.
+ * The ghost value on a side is sign * u + 2 * gamma, where u is the cell next to the side and
+ * sign is 1 for a Neumann boundary without a neighbor and -1 otherwise. The edge and corner ghost
+ * cells are zero.
+ */
+template <size_t D> class PatchArray
+{
+	private:
+	int                 n           = 0;
+	int                 num_patches = 0;
+	int                 padded_size = 0;
+	int                 first       = 0;
+	std::array<int, D>  strides;
+	std::vector<double> data;
+
+	/**
+	 * @brief Get the offset of a cell from the first cell of its patch
+	 *
+	 * @param coord the coordinates of the cell, -1 and n are ghost cells
+	 */
+	int offset(const std::array<int, D> &coord) const
+	{
+		int retval = 0;
+		for (size_t axis = 0; axis < D; axis++) {
+			retval += coord[axis] * strides[axis];
+		}
+		return retval;
+	}
+
+	public:
+	PatchArray() = default;
+	/**
+	 * @brief Create an array of zeros
+	 *
+	 * @param n the number of cells in each direction of a patch
+	 * @param num_patches the number of patches
+	 */
+	PatchArray(int n, int num_patches)
+	{
+		this->n           = n;
+		this->num_patches = num_patches;
+		padded_size       = 1;
+		for (size_t axis = 0; axis < D; axis++) {
+			strides[axis] = padded_size;
+			padded_size *= n + 2;
+		}
+		for (size_t axis = 0; axis < D; axis++) {
+			first += strides[axis];
+		}
+		data.assign(padded_size * num_patches, 0);
+	}
+	int getN() const
+	{
+		return n;
+	}
+	/**
+	 * @brief Get the number of patches
+	 */
+	int size() const
+	{
+		return num_patches;
+	}
+	/**
+	 * @brief Get the distance between neighboring cells along an axis
+	 */
+	int getStride(int axis) const
+	{
+		return strides[axis];
+	}
+	/**
+	 * @brief Get a pointer to the first non-ghost cell of a patch, the ghost cells are at
+	 * negative offsets from it
+	 *
+	 * @param patch the index of the patch in the PatchTable
+	 */
+	double *getPatch(int patch)
+	{
+		return &data[patch * padded_size + first];
+	}
+	const double *getPatch(int patch) const
+	{
+		return &data[patch * padded_size + first];
+	}
+	/**
+	 * @brief Copy one patch and set its ghost cells
+	 *
+	 * @param patches the patches
+	 * @param patch the index of the patch in the table
+	 * @param u_view the domain vector
+	 * @param gamma_view the local interface values
+	 */
+	void fillPatch(const PatchTable<D> &patches, int patch, const double *u_view,
+	               const double *gamma_view);
+	/**
+	 * @brief Copy every patch of a domain vector and set the ghost cells
+	 *
+	 * @param patches the patches, in the same order as the array
+	 * @param u the domain vector
+	 * @param gamma the local interface values
+	 */
+	void fill(const PatchTable<D> &patches, const Vec u, const Vec gamma)
+	{
+		const double *u_view, *gamma_view;
+		VecGetArrayRead(u, &u_view);
+		VecGetArrayRead(gamma, &gamma_view);
+#pragma omp parallel for schedule(static)
+		for (int patch = 0; patch < patches.size(); patch++) {
+			fillPatch(patches, patch, u_view, gamma_view);
+		}
+		VecRestoreArrayRead(u, &u_view);
+		VecRestoreArrayRead(gamma, &gamma_view);
+	}
+};
+template <size_t D>
+inline void PatchArray<D>::fillPatch(const PatchTable<D> &patches, int patch,
+                                     const double *u_view, const double *gamma_view)
+{
+	int face_size = 1;
+	for (size_t axis = 0; axis < D - 1; axis++) {
+		face_size *= n;
+	}
+	double *      dst = getPatch(patch);
+	const double *src = u_view + patches.getLocalIndex(patch) * face_size * n;
+
+	// copy the rows along x
+	for (int row = 0; row < face_size; row++) {
+		std::array<int, D> coord;
+		coord[0] = 0;
+		int rest = row;
+		for (size_t axis = 1; axis < D; axis++) {
+			coord[axis] = rest % n;
+			rest /= n;
+		}
+		double *      dst_row = dst + offset(coord);
+		const double *src_row = src + row * n;
+		for (int xi = 0; xi < n; xi++) {
+			dst_row[xi] = src_row[xi];
+		}
+	}
+
+	// set the ghost cells on each side
+	for (Side<D> s : Side<D>::getValues()) {
+		int           axis  = s.toInt() / 2;
+		double        sign  = -1;
+		const double *gamma = nullptr;
+		if (patches.hasNbr(patch, s)) {
+			gamma = gamma_view + face_size * patches.getIfaceLocalIndex(patch, s);
+		} else if (patches.isNeumann(patch, s)) {
+			sign = 1;
+		}
+		// the interface values are ordered like the patch, with the axis of the side left out, so
+		// the face is face_size / n rows of n values
+		std::array<int, D - 1> face_strides;
+		for (int a = 0, i = 0; a < (int) D; a++) {
+			if (a != axis) { face_strides[i++] = strides[a]; }
+		}
+		int     col_stride = face_strides[0];
+		int     row_stride = face_strides[D - 2];
+		int     step       = s.isLowerOnAxis() ? -strides[axis] : strides[axis];
+		double *face       = dst + (s.isLowerOnAxis() ? 0 : (n - 1) * strides[axis]);
+		for (int row = 0; row < face_size / n; row++) {
+			for (int col = 0; col < n; col++) {
+				double *cell = face + row * row_stride + col * col_stride;
+				cell[step]   = sign * cell[0];
+				if (gamma != nullptr) { cell[step] += 2 * gamma[row * n + col]; }
+			}
+		}
+	}
+}
+#endif
@@ -21,12 +21,97 @@
 
 #ifndef PATCHOPERATOR_H
 #define PATCHOPERATOR_H
-#include "SchurDomain.h"
+#include "PatchArray.h"
+#include "PatchTable.h"
 #include <petscvec.h>
 template <size_t D> class PatchOperator
 {
 	public:
 	virtual ~PatchOperator() {}
-	virtual void apply(SchurDomain<D> &d, const Vec u, const Vec gamma, Vec f) = 0;
+	/**
+	 * @brief Apply the operator to every patch in a table
+	 *
+	 * Each patch only writes to its own part of f, so the patches are split between the threads.
+	 *
+	 * @param patches the patches
+	 * @param u the solution vector
+	 * @param gamma the local interface values
+	 * @param f the resulting rhs vector
+	 */
+	void apply(const PatchTable<D> &patches, const Vec u, const Vec gamma, Vec f)
+	{
+		const double *u_view, *gamma_view;
+		double *      f_view;
+		VecGetArrayRead(u, &u_view);
+		VecGetArrayRead(gamma, &gamma_view);
+		VecGetArray(f, &f_view);
+#pragma omp parallel for schedule(static)
+		for (int patch = 0; patch < patches.size(); patch++) {
+			applyPatch(patches, patch, u_view, gamma_view, f_view);
+		}
+		VecRestoreArrayRead(u, &u_view);
+		VecRestoreArrayRead(gamma, &gamma_view);
+		VecRestoreArray(f, &f_view);
+	}
+	/**
+	 * @brief Apply the operator to every patch in a table, through a ghost-padded copy of u
+	 *
+	 * The patches are copied into the padded array with their ghost cells set from gamma, and
+	 * then applyPaddedPatch is called on each patch.
+	 *
+	 * @param patches the patches
+	 * @param padded the padded array to copy u into, with one patch for each patch in the table
+	 * @param u the solution vector
+	 * @param gamma the local interface values
+	 * @param f the resulting rhs vector
+	 */
+	void apply(const PatchTable<D> &patches, PatchArray<D> &padded, const Vec u, const Vec gamma,
+	           Vec f)
+	{
+		padded.fill(patches, u, gamma);
+		const double *u_view, *gamma_view;
+		double *      f_view;
+		VecGetArrayRead(u, &u_view);
+		VecGetArrayRead(gamma, &gamma_view);
+		VecGetArray(f, &f_view);
+#pragma omp parallel for schedule(static)
+		for (int patch = 0; patch < patches.size(); patch++) {
+			applyPaddedPatch(patches, patch, padded, u_view, gamma_view, f_view);
+		}
+		VecRestoreArrayRead(u, &u_view);
+		VecRestoreArrayRead(gamma, &gamma_view);
+		VecRestoreArray(f, &f_view);
+	}
+	/**
+	 * @brief Apply the operator to one patch
+	 *
+	 * @param patches the patches
+	 * @param patch the index of the patch in the table
+	 * @param u_view the solution vector
+	 * @param gamma_view the local interface values
+	 * @param f_view the resulting rhs vector
+	 */
+	virtual void applyPatch(const PatchTable<D> &patches, int patch, const double *u_view,
+	                        const double *gamma_view, double *f_view)
+	= 0;
+	/**
+	 * @brief Apply the operator to one patch of a ghost-padded array
+	 *
+	 * This calls applyPatch on the unpadded vectors, operators that have a stencil for the padded
+	 * layout override it.
+	 *
+	 * @param patches the patches
+	 * @param patch the index of the patch in the table
+	 * @param padded the padded solution, with the ghost cells filled
+	 * @param u_view the solution vector
+	 * @param gamma_view the local interface values
+	 * @param f_view the resulting rhs vector
+	 */
+	virtual void applyPaddedPatch(const PatchTable<D> &patches, int patch,
+	                              const PatchArray<D> &padded, const double *u_view,
+	                              const double *gamma_view, double *f_view)
+	{
+		applyPatch(patches, patch, u_view, gamma_view, f_view);
+	}
 };
 #endif
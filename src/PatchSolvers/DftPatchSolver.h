@@ -22,47 +22,41 @@
 #ifndef DFTPATCHSOLVER_H
 #define DFTPATCHSOLVER_H
 #include "DomainCollection.h"
+#include "PatchSolvers/DomainK.h"
 #include "PatchSolvers/PatchSolver.h"
+#include "PatchSolvers/SeparableEigenvalues.h"
 #include "Utils.h"
+#include <algorithm>
 #include <bitset>
 #include <fftw3.h>
 #include <map>
 #include <valarray>
-extern "C" void dgemv_(char &, int &, int &, double &, double *, int &, double *, int &, double &,
-                       double *, int &);
+#include <vector>
+extern "C" void dgemm_(char &, char &, int &, int &, int &, double &, double *, int &, double *,
+                       int &, double &, double *, int &);
 
 enum class DftType { DCT_II, DCT_III, DCT_IV, DST_II, DST_III, DST_IV };
-#ifndef DOMAINK
-#define DOMAINK
-template <size_t D> struct DomainK {
-	ulong  neumann = 0;
-	double h_x     = 0;
-
-	DomainK() {}
-	DomainK(const SchurDomain<D> &d)
-	{
-		this->neumann = d.neumann.to_ulong();
-		this->h_x     = d.domain.lengths[0];
-	}
-	friend bool operator<(const DomainK &l, const DomainK &r)
-	{
-		return std::tie(l.neumann, l.h_x) < std::tie(r.neumann, r.h_x);
-	}
-};
-#endif
 
 template <size_t D> class DftPatchSolver : public PatchSolver<D>
 {
 	private:
+	typedef typename PatchSolver<D>::DomainList DomainList;
+	/**
+	 * @brief Scratch space for a batch of patches, one is allocated for each thread.
+	 */
+	struct Scratch {
+		std::valarray<double> f_copy;
+		std::valarray<double> tmp;
+		std::valarray<double> work;
+	};
 	int                                                                         n;
-	bool                                                                        initialized = false;
+	int                                                                         max_batch = 32;
 	static bool                                                                 compareDomains();
 	double                                                                      lambda;
 	std::map<DomainK<D>, std::array<std::shared_ptr<std::valarray<double>>, D>> plan1;
 	std::map<DomainK<D>, std::array<std::shared_ptr<std::valarray<double>>, D>> plan2;
-	std::valarray<double>                                                       f_copy;
-	std::valarray<double>                                                       tmp;
-	std::map<DomainK<D>, std::valarray<double>>                                 eigen_vals;
+	std::vector<Scratch>                                                        scratch;
+	std::map<DomainK<D>, SeparableEigenvalues<D>>                               eigen_vals;
 	std::array<std::shared_ptr<std::valarray<double>>, 6>                       transforms
 	= {{nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}};
 
@@ -70,18 +64,27 @@ template <size_t D> class DftPatchSolver : public PatchSolver<D>
 
 	std::shared_ptr<std::valarray<double>> getTransformArray(DftType type);
 	void execute_plan(std::array<std::shared_ptr<std::valarray<double>>, D> plan, double *in,
-	                  double *out, const bool inverse);
+	                  double *out, double *work, int count);
+	void allocateScratch();
+	void solveBatch(SchurDomain<D> **batch_domains, int count, const double *f_view,
+	                double *u_view, const double *gamma_view);
 
 	public:
 	DftPatchSolver(DomainCollection<D> &dsc, double lambda = 0);
 	void solve(SchurDomain<D> &d, const Vec f, Vec u, const Vec gamma);
-	void domainSolve(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u, const Vec gamma)
+	void domainSolve(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u, const Vec gamma);
+	using PatchSolver<D>::domainSolveFused;
+	void domainSolveFused(DomainList &domains, const Vec f, Vec u, const Vec gamma,
+	                      const typename PatchSolver<D>::PatchCallback &solved);
+	void addDomain(SchurDomain<D> &d);
+	/**
+	 * @brief Set the maximum number of patches that are transformed together by one set of dgemm
+	 * calls.
+	 */
+	void setMaxBatch(int max_batch)
 	{
-		for (SchurDomain<D> &d : domains) {
-			solve(d, f, u, gamma);
-		}
+		this->max_batch = max_batch;
 	}
-	void addDomain(SchurDomain<D> &d);
 };
 
 template <size_t D> inline DftPatchSolver<D>::DftPatchSolver(DomainCollection<D> &dc, double lambda)
@@ -92,11 +95,7 @@ template <size_t D> inline DftPatchSolver<D>::DftPatchSolver(DomainCollection<D>
 template <size_t D> inline void DftPatchSolver<D>::addDomain(SchurDomain<D> &d)
 {
 	using namespace std;
-	if (!initialized) {
-		initialized = true;
-		f_copy.resize(pow(n, D));
-		tmp.resize(pow(n, D));
-	}
+	allocateScratch();
 
 	DftType transforms[D];
 	DftType transforms_inv[D];
@@ -122,96 +121,125 @@ template <size_t D> inline void DftPatchSolver<D>::addDomain(SchurDomain<D> &d)
 		plan2[d] = plan(transforms_inv);
 	}
 
-	if (!eigen_vals.count(d)) {
-		valarray<double> &denom = eigen_vals[d];
-		denom.resize(pow(n, D));
-
-		valarray<double> ones(pow(n, D - 1));
-		ones = 1;
-
-		for (size_t i = 0; i < D; i++) {
-			valarray<size_t> sizes(D - 1);
-			sizes = n;
-			valarray<size_t> strides(D - 1);
-			for (size_t d = 1; d < D; d++) {
-				strides[d - 1] = pow(n, (i + d) % D);
-			}
-			double h = d.domain.lengths[i] / n;
-
-			if (d.isNeumann(i * 2) && d.isNeumann(i * 2 + 1)) {
-				for (int xi = 0; xi < n; xi++) {
-					denom[gslice(xi * pow(n, i), sizes, strides)]
-					-= 4 / (h * h) * pow(sin(xi * M_PI / (2 * n)), 2) * ones;
-				}
-			} else if (d.isNeumann(i * 2) || d.isNeumann(i * 2 + 1)) {
-				for (int xi = 0; xi < n; xi++) {
-					denom[gslice(xi * pow(n, i), sizes, strides)]
-					-= 4 / (h * h) * pow(sin((xi + 0.5) * M_PI / (2 * n)), 2) * ones;
-				}
-			} else {
-				for (int xi = 0; xi < n; xi++) {
-					denom[gslice(xi * pow(n, i), sizes, strides)]
-					-= 4 / (h * h) * pow(sin((xi + 1) * M_PI / (2 * n)), 2) * ones;
-				}
-			}
-		}
-
-		denom += lambda;
+	if (!eigen_vals.count(d)) { eigen_vals[d] = SeparableEigenvalues<D>(d, n, lambda); }
+}
+template <size_t D> inline void DftPatchSolver<D>::allocateScratch()
+{
+	int batch_size = max_batch * std::pow(n, D);
+	if (!scratch.empty() && (int) scratch[0].f_copy.size() != batch_size) { scratch.clear(); }
+	while ((int) scratch.size() < Utils::getMaxThreads()) {
+		Scratch s;
+		s.f_copy.resize(batch_size);
+		s.tmp.resize(batch_size);
+		s.work.resize(batch_size);
+		scratch.push_back(s);
 	}
 }
 template <size_t D>
-inline void DftPatchSolver<D>::solve(SchurDomain<D> &d, const Vec f, Vec u, const Vec gamma)
+inline void DftPatchSolver<D>::domainSolve(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u,
+                                           const Vec gamma)
+{
+	DomainList list = PatchSolver<D>::getDomainList(domains);
+	domainSolveFused(list, f, u, gamma, nullptr);
+}
+template <size_t D>
+inline void
+DftPatchSolver<D>::domainSolveFused(DomainList &domains, const Vec f, Vec u, const Vec gamma,
+                                    const typename PatchSolver<D>::PatchCallback &solved)
 {
 	using namespace std;
-	using namespace Utils;
+	allocateScratch();
+
 	const double *f_view, *gamma_view;
+	double *      u_view;
 	VecGetArrayRead(f, &f_view);
 	VecGetArrayRead(gamma, &gamma_view);
+	VecGetArray(u, &u_view);
 
-	int start = d.local_index * pow(n, D);
-	for (int i = 0; i < (const int) pow(n, D); i++) {
-		f_copy[i] = f_view[start + i];
+	// the zero patches are left out of the batches
+	vector<SchurDomain<D> *> sorted
+	= PatchSolver<D>::getNonzeroPatches(domains, f_view, u_view, gamma_view);
+	// sort by local index so that patches that are next to each other in memory can be batched
+	sort(sorted.begin(), sorted.end(), [](const SchurDomain<D> *a, const SchurDomain<D> *b) {
+		return a->local_index < b->local_index;
+	});
+
+	// split into runs of contiguous patches with the same key
+	vector<pair<int, int>> batches;
+	size_t                 run_start = 0;
+	while (run_start < sorted.size()) {
+		DomainK<D> key(*sorted[run_start]);
+		size_t     run_end = run_start + 1;
+		while (run_end < sorted.size() && run_end - run_start < (size_t) max_batch
+		       && sorted[run_end]->local_index == sorted[run_end - 1]->local_index + 1
+		       && DomainK<D>(*sorted[run_end]) == key) {
+			run_end++;
+		}
+		batches.push_back(make_pair(run_start, run_end - run_start));
+		run_start = run_end;
 	}
 
-	for (Side<D> s : Side<D>::getValues()) {
-		if (d.hasNbr(s)) {
-			int          idx = pow(n, D - 1) * d.getIfaceLocalIndex(s);
-			Slice<D - 1> sl  = getSlice<D - 1>(&f_copy[0], n, s);
-			double       h2  = pow(d.domain.lengths[s.toInt() / 2] / n, 2);
-			int          strides[D - 1];
-			for (size_t i = 0; i < D - 1; i++) {
-				strides[i] = pow(n, i);
-			}
-			for (int i = 0; i < (const int) pow(n, D - 1); i++) {
-				std::array<int, D - 1> coord;
-				for (size_t x = 0; x < D - 1; x++) {
-					coord[x] = (i / strides[x]) % n;
-				}
-				sl(coord) -= 2.0 / h2 * gamma_view[idx + i];
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int) batches.size(); i++) {
+		solveBatch(&sorted[batches[i].first], batches[i].second, f_view, u_view, gamma_view);
+		if (solved) {
+			for (int j = batches[i].first; j < batches[i].first + batches[i].second; j++) {
+				solved(*sorted[j], u_view);
 			}
 		}
 	}
 
-	execute_plan(plan1[d], &f_copy[0], &tmp[0], false);
-
-	tmp /= eigen_vals[d];
-
-	if (d.neumann.all()) { tmp[0] = 0; }
+	VecRestoreArray(u, &u_view);
+	VecRestoreArrayRead(f, &f_view);
+	VecRestoreArrayRead(gamma, &gamma_view);
+}
+template <size_t D>
+inline void DftPatchSolver<D>::solve(SchurDomain<D> &d, const Vec f, Vec u, const Vec gamma)
+{
+	allocateScratch();
 
-	double *u_view;
+	const double *f_view, *gamma_view;
+	double *      u_view;
+	VecGetArrayRead(f, &f_view);
+	VecGetArrayRead(gamma, &gamma_view);
 	VecGetArray(u, &u_view);
-	double *u_local_view = u_view + start;
-	execute_plan(plan2[d], &tmp[0], u_local_view, true);
 
-	double scale = pow(2.0 / n, D);
-	for (int i = 0; i < (const int) pow(n, D); i++) {
-		u_local_view[i] *= scale;
-	}
+	SchurDomain<D> *ptr = &d;
+	solveBatch(&ptr, 1, f_view, u_view, gamma_view);
+
 	VecRestoreArray(u, &u_view);
 	VecRestoreArrayRead(f, &f_view);
 	VecRestoreArrayRead(gamma, &gamma_view);
 }
 template <size_t D>
+inline void DftPatchSolver<D>::solveBatch(SchurDomain<D> **batch_domains, int count,
+                                          const double *f_view, double *u_view,
+                                          const double *gamma_view)
+{
+	using namespace std;
+	Scratch &       s          = scratch[Utils::getThreadNum()];
+	SchurDomain<D> &d          = *batch_domains[0];
+	int             patch_size = pow(n, D);
+	int             start      = d.local_index * patch_size;
+
+	copy(f_view + start, f_view + start + count * patch_size, &s.f_copy[0]);
+	for (int i = 0; i < count; i++) {
+		addGammaCorrection<D>(*batch_domains[i], n, &s.f_copy[i * patch_size], gamma_view);
+	}
+
+	execute_plan(plan1.at(d), &s.f_copy[0], &s.tmp[0], &s.work[0], count);
+
+	const SeparableEigenvalues<D> &eigs  = eigen_vals.at(d);
+	double                         scale = pow(2.0 / n, D);
+	for (int i = 0; i < count; i++) {
+		double *patch = &s.tmp[i * patch_size];
+		eigs.divide(patch, scale);
+		if (d.neumann.all()) { patch[0] = 0; }
+	}
+
+	execute_plan(plan2.at(d), &s.tmp[0], u_view + start, &s.work[0], count);
+}
+template <size_t D>
 inline std::array<std::shared_ptr<std::valarray<double>>, D> DftPatchSolver<D>::plan(DftType *types)
 {
 	std::array<std::shared_ptr<std::valarray<double>>, D> retval;
@@ -292,45 +320,30 @@ inline std::shared_ptr<std::valarray<double>> DftPatchSolver<D>::getTransformArr
 template <size_t D>
 inline void
 DftPatchSolver<D>::execute_plan(std::array<std::shared_ptr<std::valarray<double>>, D> plan,
-                                double *in, double *out, const bool inverse)
+                                double *in, double *out, double *work, int count)
 {
-	double *prev_result = in;
-	int     strides[D];
-	for (size_t i = 0; i < D; i++) {
-		strides[i] = pow(n, i);
+	// Each pass transforms the axis that is contiguous in memory for all the patches in the batch
+	// with a single dgemm. The result is written transposed, so that the transformed axis becomes
+	// the slowest, and the next axis becomes contiguous. The last pass is done one patch at a time
+	// so that the result is written back in the original layout. The input is overwritten.
+	int     patch_size = pow(n, D);
+	int     face_size  = pow(n, D - 1);
+	int     rest       = face_size * count;
+	char    T          = 'T';
+	char    N          = 'N';
+	double  one        = 1;
+	double  zero       = 0;
+	double *src        = in;
+	double *dst        = work;
+	for (size_t dim = 0; dim < D - 1; dim++) {
+		dgemm_(T, N, rest, n, n, one, src, n, &(*plan[dim])[0], n, zero, dst, rest);
+		std::swap(src, dst);
 	}
-	for (size_t dim = 0; dim < D; dim++) {
-		int other_strides[D - 1];
-		for (size_t i = 0; i < dim; i++) {
-			other_strides[i] = strides[i];
-		}
-		int dft_stride = strides[dim];
-		for (size_t i = dim + 1; i < D; i++) {
-			other_strides[i - 1] = strides[i];
-		}
-
-		std::valarray<double> &matrix = *plan[dim];
-		double *               new_result;
-		if (dim != D-1) {
-			new_result = new double[(int)pow(n,D)];
-		} else {
-			new_result = out;
-		}
-
-		for (int i = 0; i < (const int) pow(n, D - 1); i++) {
-			std::array<int, D - 1> coord;
-			for (size_t x = 0; x < D - 1; x++) {
-				coord[x] = (i / strides[x]) % n;
-			}
-			int    idx = std::inner_product(other_strides, other_strides + D - 1, coord.begin(), 0);
-			char   T   = 'T';
-			double one = 1;
-			double zero = 0;
-			dgemv_(T, n, n, one, &matrix[0], n, &prev_result[idx], dft_stride, zero,
-			       &new_result[idx], dft_stride);
-		}
-		if (dim != 0) { delete[] prev_result; }
-		prev_result = new_result;
+	// src is now ordered with the last axis fastest, then the patch, then the other axes
+	int ld = n * count;
+	for (int p = 0; p < count; p++) {
+		dgemm_(T, N, face_size, n, n, one, src + p * n, ld, &(*plan[D - 1])[0], n, zero,
+		       out + p * patch_size, face_size);
 	}
 }
 #endif
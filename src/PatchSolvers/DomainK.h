@@ -0,0 +1,53 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef DOMAINK_H
+#define DOMAINK_H
+#include "SchurDomain.h"
+#include <tuple>
+/**
+ * @brief Key used by the patch solvers to share plans and eigenvalues between patches that have
+ * the same boundary conditions and spacing.
+ */
+template <size_t D> struct DomainK {
+	ulong  neumann = 0;
+	double h_x     = 0;
+
+	DomainK() {}
+	DomainK(const SchurDomain<D> &d)
+	{
+		this->neumann = d.neumann.to_ulong();
+		this->h_x     = d.domain.lengths[0];
+	}
+	friend bool operator<(const DomainK &l, const DomainK &r)
+	{
+		return std::tie(l.neumann, l.h_x) < std::tie(r.neumann, r.h_x);
+	}
+	friend bool operator==(const DomainK &l, const DomainK &r)
+	{
+		return std::tie(l.neumann, l.h_x) == std::tie(r.neumann, r.h_x);
+	}
+	friend bool operator!=(const DomainK &l, const DomainK &r)
+	{
+		return !(l == r);
+	}
+};
+#endif
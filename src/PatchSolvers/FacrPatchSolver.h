@@ -0,0 +1,332 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef FACRPATCHSOLVER_H
+#define FACRPATCHSOLVER_H
+#include "DomainCollection.h"
+#include "PatchSolvers/DomainK.h"
+#include "PatchSolvers/FftwWisdom.h"
+#include "PatchSolvers/PatchSolver.h"
+#include "PatchSolvers/SeparableEigenvalues.h"
+#include "Utils.h"
+#include <fftw3.h>
+#include <map>
+#include <memory>
+#include <valarray>
+#include <vector>
+
+/**
+ * @brief A patch solver that transforms along every axis except the last one, and then solves a
+ * tridiagonal system along the last axis for each mode (FACR).
+ *
+ * Only D-1 dimensional transforms are needed, so the speed of the solver depends much less on n
+ * having small prime factors than the FftwPatchSolver does. The tridiagonal systems are factored
+ * once for each DomainK. The last axis is the slowest varying axis of a patch, so each step of the
+ * tridiagonal solve is a loop over all of the lines at once, with unit stride.
+ */
+template <size_t D> class FacrPatchSolver : public PatchSolver<D>
+{
+	private:
+	typedef typename PatchSolver<D>::DomainList DomainList;
+	/**
+	 * @brief The factored tridiagonal systems along the last axis, one for each mode of the other
+	 * axes.
+	 */
+	struct Tridiagonal {
+		/**
+		 * @brief the off diagonal, which is the same for every system
+		 */
+		double off_diag = 0;
+		/**
+		 * @brief the inverses of the pivots from the forward elimination, with the mode varying
+		 * fastest
+		 */
+		std::valarray<double> inv_pivots;
+		/**
+		 * @brief true if the system for the zero mode is singular up to a constant
+		 */
+		bool zero_mode = false;
+	};
+	/**
+	 * @brief Scratch space for the patch solves, one is allocated for each thread.
+	 */
+	struct Scratch {
+		std::valarray<double> f_copy;
+		std::valarray<double> tmp;
+		std::valarray<double> sol;
+	};
+	int                               n;
+	unsigned                          flags = FFTW_MEASURE;
+	double                            lambda;
+	std::map<DomainK<D>, fftw_plan>   plan1;
+	std::map<DomainK<D>, fftw_plan>   plan2;
+	std::map<DomainK<D>, Tridiagonal> systems;
+	std::vector<Scratch>              scratch;
+
+	void getTransforms(SchurDomain<D> &d, fftw_r2r_kind *transforms,
+	                   fftw_r2r_kind *transforms_inv);
+	void allocateScratch();
+	void solveLines(const Tridiagonal &t, double *patch, double scale);
+	void solve(SchurDomain<D> &d, const double *f_view, double *u_view, const double *gamma_view);
+
+	public:
+	/**
+	 * @brief Create a new FacrPatchSolver
+	 *
+	 * @param dc the DomainCollection
+	 * @param lambda the lambda value of the Helmholtz equation
+	 * @param wisdom if set, its planning flags are used instead of FFTW_MEASURE. Call
+	 * FftwWisdom::load first, so that the plans in the file are reused.
+	 */
+	FacrPatchSolver(DomainCollection<D> &dc, double lambda = 0,
+	                std::shared_ptr<FftwWisdom> wisdom = nullptr);
+	~FacrPatchSolver();
+	void domainSolve(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u, const Vec gamma);
+	using PatchSolver<D>::domainSolveFused;
+	void domainSolveFused(DomainList &domains, const Vec f, Vec u, const Vec gamma,
+	                      const typename PatchSolver<D>::PatchCallback &solved);
+	void addDomain(SchurDomain<D> &d);
+};
+template <size_t D>
+FacrPatchSolver<D>::FacrPatchSolver(DomainCollection<D> &dc, double lambda,
+                                    std::shared_ptr<FftwWisdom> wisdom)
+{
+	n            = dc.getN();
+	this->lambda = lambda;
+	if (wisdom != nullptr) { flags = wisdom->getPlanningFlags(); }
+}
+template <size_t D> FacrPatchSolver<D>::~FacrPatchSolver()
+{
+	for (auto p : plan1) {
+		fftw_destroy_plan(p.second);
+	}
+	for (auto p : plan2) {
+		fftw_destroy_plan(p.second);
+	}
+}
+template <size_t D> void FacrPatchSolver<D>::addDomain(SchurDomain<D> &d)
+{
+	using namespace std;
+	allocateScratch();
+
+	int plane_size = pow(n, D - 1);
+	if (!plan1.count(d)) {
+		int           ns[D - 1];
+		fftw_r2r_kind transforms[D - 1];
+		fftw_r2r_kind transforms_inv[D - 1];
+		for (size_t i = 0; i < D - 1; i++) {
+			ns[i] = n;
+		}
+		getTransforms(d, transforms, transforms_inv);
+
+		// one D-1 dimensional transform for each cell along the last axis
+		Scratch &s = scratch[0];
+		plan1[d]   = fftw_plan_many_r2r(D - 1, ns, n, &s.f_copy[0], nullptr, 1, plane_size,
+		                                &s.tmp[0], nullptr, 1, plane_size, transforms,
+		                                flags | FFTW_DESTROY_INPUT);
+		plan2[d]   = fftw_plan_many_r2r(D - 1, ns, n, &s.tmp[0], nullptr, 1, plane_size,
+		                                &s.sol[0], nullptr, 1, plane_size, transforms_inv,
+		                                flags | FFTW_DESTROY_INPUT);
+	}
+
+	if (!systems.count(d)) {
+		// the eigenvalues of the transformed axes, lambda is already folded in
+		SeparableEigenvalues<D> eigs(d, n, lambda);
+
+		Tridiagonal &t     = systems[d];
+		double       h     = d.domain.lengths[D - 1] / n;
+		double       a     = 1.0 / (h * h);
+		bool         lower = d.isNeumann(2 * (D - 1));
+		bool         upper = d.isNeumann(2 * (D - 1) + 1);
+		t.off_diag         = a;
+		t.zero_mode        = d.neumann.all() && lambda == 0;
+		t.inv_pivots.resize(n * plane_size);
+		for (int p = 0; p < plane_size; p++) {
+			double mu  = 0;
+			int    rem = p;
+			for (size_t axis = 0; axis < D - 1; axis++) {
+				mu += eigs.axis[axis][rem % n];
+				rem /= n;
+			}
+			for (int i = 0; i < n; i++) {
+				// the ghost cell is the negative of the boundary cell for dirichlet, and equal to
+				// the boundary cell for neumann
+				double diag = -2 * a + mu;
+				if (i == 0) { diag += lower ? a : -a; }
+				if (i == n - 1) { diag += upper ? a : -a; }
+				double pivot = diag;
+				if (i > 0) { pivot -= a * a * t.inv_pivots[(i - 1) * plane_size + p]; }
+				if (t.zero_mode && p == 0 && i == n - 1) {
+					// the last pivot of the singular system is zero, the last cell of the line is
+					// set to zero and the mean is removed afterwards
+					t.inv_pivots[i * plane_size + p] = 0;
+				} else {
+					t.inv_pivots[i * plane_size + p] = 1.0 / pivot;
+				}
+			}
+		}
+	}
+}
+template <size_t D>
+void FacrPatchSolver<D>::getTransforms(SchurDomain<D> &d, fftw_r2r_kind *transforms,
+                                       fftw_r2r_kind *transforms_inv)
+{
+	// the last axis is not transformed, the kinds are reversed for fftw
+	for (size_t i = 0; i < D - 1; i++) {
+		if (d.isNeumann(2 * i) && d.isNeumann(2 * i + 1)) {
+			transforms[D - 2 - i]     = FFTW_REDFT10;
+			transforms_inv[D - 2 - i] = FFTW_REDFT01;
+		} else if (d.isNeumann(2 * i)) {
+			transforms[D - 2 - i]     = FFTW_REDFT11;
+			transforms_inv[D - 2 - i] = FFTW_REDFT11;
+		} else if (d.isNeumann(2 * i + 1)) {
+			transforms[D - 2 - i]     = FFTW_RODFT11;
+			transforms_inv[D - 2 - i] = FFTW_RODFT11;
+		} else {
+			transforms[D - 2 - i]     = FFTW_RODFT10;
+			transforms_inv[D - 2 - i] = FFTW_RODFT01;
+		}
+	}
+}
+template <size_t D> void FacrPatchSolver<D>::allocateScratch()
+{
+	// every thread gets its own copy of the scratch space, the plans are executed on them with
+	// fftw_execute_r2r, which is thread safe
+	int patch_size = std::pow(n, D);
+	while ((int) scratch.size() < Utils::getMaxThreads()) {
+		Scratch s;
+		s.f_copy.resize(patch_size);
+		s.tmp.resize(patch_size);
+		s.sol.resize(patch_size);
+		scratch.push_back(s);
+	}
+}
+template <size_t D>
+void FacrPatchSolver<D>::solveLines(const Tridiagonal &t, double *patch, double scale)
+{
+	int           plane_size = std::pow(n, D - 1);
+	double        a          = t.off_diag;
+	const double *inv        = &t.inv_pivots[0];
+
+	// the rhs of the singular system has to have a zero mean
+	if (t.zero_mode) {
+		double mean = 0;
+		for (int i = 0; i < n; i++) {
+			mean += patch[i * plane_size];
+		}
+		mean /= n;
+		for (int i = 0; i < n; i++) {
+			patch[i * plane_size] -= mean;
+		}
+	}
+
+	// forward elimination
+	for (int p = 0; p < plane_size; p++) {
+		patch[p] *= scale * inv[p];
+	}
+	for (int i = 1; i < n; i++) {
+		double *      row     = patch + i * plane_size;
+		const double *prev    = row - plane_size;
+		const double *row_inv = inv + i * plane_size;
+		for (int p = 0; p < plane_size; p++) {
+			row[p] = (row[p] * scale - a * prev[p]) * row_inv[p];
+		}
+	}
+
+	// back substitution
+	for (int i = n - 2; i >= 0; i--) {
+		double *      row     = patch + i * plane_size;
+		const double *next    = row + plane_size;
+		const double *row_inv = inv + i * plane_size;
+		for (int p = 0; p < plane_size; p++) {
+			row[p] -= a * row_inv[p] * next[p];
+		}
+	}
+
+	if (t.zero_mode) {
+		double mean = 0;
+		for (int i = 0; i < n; i++) {
+			mean += patch[i * plane_size];
+		}
+		mean /= n;
+		for (int i = 0; i < n; i++) {
+			patch[i * plane_size] -= mean;
+		}
+	}
+}
+template <size_t D>
+void FacrPatchSolver<D>::solve(SchurDomain<D> &d, const double *f_view, double *u_view,
+                               const double *gamma_view)
+{
+	using namespace std;
+	Scratch &s          = scratch[Utils::getThreadNum()];
+	int      patch_size = pow(n, D);
+	int      start      = d.local_index * patch_size;
+	for (int i = 0; i < patch_size; i++) {
+		s.f_copy[i] = f_view[start + i];
+	}
+
+	addGammaCorrection<D>(d, n, &s.f_copy[0], gamma_view);
+
+	fftw_execute_r2r(plan1.at(d), &s.f_copy[0], &s.tmp[0]);
+
+	solveLines(systems.at(d), &s.tmp[0], 1.0 / pow(2.0 * n, D - 1));
+
+	fftw_execute_r2r(plan2.at(d), &s.tmp[0], &s.sol[0]);
+
+	for (int i = 0; i < patch_size; i++) {
+		u_view[start + i] = s.sol[i];
+	}
+}
+template <size_t D>
+void FacrPatchSolver<D>::domainSolve(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u,
+                                     const Vec gamma)
+{
+	DomainList list = PatchSolver<D>::getDomainList(domains);
+	domainSolveFused(list, f, u, gamma, nullptr);
+}
+template <size_t D>
+void FacrPatchSolver<D>::domainSolveFused(DomainList &domains, const Vec f, Vec u,
+                                          const Vec gamma,
+                                          const typename PatchSolver<D>::PatchCallback &solved)
+{
+	allocateScratch();
+
+	const double *f_view, *gamma_view;
+	double *      u_view;
+	VecGetArrayRead(f, &f_view);
+	VecGetArrayRead(gamma, &gamma_view);
+	VecGetArray(u, &u_view);
+
+	std::vector<SchurDomain<D> *> nonzero
+	= PatchSolver<D>::getNonzeroPatches(domains, f_view, u_view, gamma_view);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int) nonzero.size(); i++) {
+		solve(*nonzero[i], f_view, u_view, gamma_view);
+		if (solved) { solved(*nonzero[i], u_view); }
+	}
+
+	VecRestoreArray(u, &u_view);
+	VecRestoreArrayRead(f, &f_view);
+	VecRestoreArrayRead(gamma, &gamma_view);
+}
+#endif
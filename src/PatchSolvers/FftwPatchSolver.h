@@ -22,61 +22,262 @@
 #ifndef FFTWPATCHSOLVER_H
 #define FFTWPATCHSOLVER_H
 #include "DomainCollection.h"
+#include "PatchSolvers/DomainK.h"
+#include "PatchSolvers/FftwWisdom.h"
 #include "PatchSolvers/PatchSolver.h"
+#include "PatchSolvers/SeparableEigenvalues.h"
 #include "Utils.h"
+#include <algorithm>
 #include <bitset>
 #include <fftw3.h>
 #include <map>
+#include <memory>
+#include <tuple>
 #include <valarray>
-#ifndef DOMAINK
-#define DOMAINK
-template <size_t D> struct DomainK {
-	ulong  neumann = 0;
-	double h_x     = 0;
-
-	DomainK() {}
-	DomainK(const SchurDomain<D> &d)
-	{
-		this->neumann = d.neumann.to_ulong();
-		this->h_x     = d.domain.lengths[0];
-	}
-	friend bool operator<(const DomainK &l, const DomainK &r)
-	{
-		return std::tie(l.neumann, l.h_x) < std::tie(r.neumann, r.h_x);
-	}
-};
-#endif
+#include <vector>
 
 template <size_t D> class FftwPatchSolver : public PatchSolver<D>
 {
 	private:
-	int                                         n;
-	bool                                        initialized = false;
-	static bool                                 compareDomains();
-	double                                      lambda;
-	std::map<DomainK<D>, fftw_plan>             plan1;
-	std::map<DomainK<D>, fftw_plan>             plan2;
-	std::valarray<double>                       f_copy;
-	std::valarray<double>                       tmp;
-	std::valarray<double>                       sol;
-	std::map<DomainK<D>, std::valarray<double>> denoms;
+	typedef typename PatchSolver<D>::DomainList DomainList;
+	/**
+	 * @brief A pair of plans that transform a batch of patches that are contiguous in memory, for
+	 * one or more right hand sides. The forward plan reads from f and writes to u, the backward
+	 * plan is in place on u.
+	 */
+	struct BatchPlan {
+		fftw_plan forward       = nullptr;
+		fftw_plan backward      = nullptr;
+		int       in_alignment  = 0;
+		int       out_alignment = 0;
+	};
+#ifdef HAVE_FFTWF
+	/**
+	 * @brief A pair of in-place single precision plans that transform a batch of patches in
+	 * scratch space.
+	 */
+	struct FloatBatchPlan {
+		fftwf_plan forward  = nullptr;
+		fftwf_plan backward = nullptr;
+	};
+#endif
+	/**
+	 * @brief Where the right hand sides are in the arrays passed to the batched solves. Column j
+	 * of f starts j * f_dist after the first, and likewise for u and gamma.
+	 */
+	struct RhsLayout {
+		int num        = 1;
+		int f_dist     = 0;
+		int u_dist     = 0;
+		int gamma_dist = 0;
+	};
+	/**
+	 * @brief The Neumann sides of a patch. The transforms only depend on the boundary conditions,
+	 * so plans are shared between patches with different spacings.
+	 */
+	typedef ulong PlanK;
+	/**
+	 * @brief The PlanK, the number of patches, the number of right hand sides, and the distances
+	 * between the right hand sides in f and u
+	 */
+	typedef std::tuple<PlanK, int, int, int, int> BatchKey;
+	/**
+	 * @brief The transform space correction for the interface values on one side of a patch
+	 */
+	struct FaceCorrection {
+		const double *coef;
+		const double *face;
+		int           axis;
+		int           stride;
+	};
+	/**
+	 * @brief The inverse transform along the axis of a side, evaluated at the cells next to the
+	 * side, which takes the solution in transform space to the face in transform space
+	 */
+	struct FaceTrace {
+		const double *kernel;
+		double *      face;
+		Side<D>       side;
+		int           axis;
+		int           stride;
+	};
+	/**
+	 * @brief A run of patches with the same DomainK that are next to each other in the domain
+	 * vector.
+	 */
+	struct Batch {
+		BatchPlan *                    plan;
+#ifdef HAVE_FFTWF
+		FloatBatchPlan *               float_plan;
+#endif
+		const SeparableEigenvalues<D> *eigs;
+		int                            start;
+		int                            count;
+	};
+	/**
+	 * @brief Scratch space for the per-patch path, one is allocated for each thread.
+	 */
+	struct Scratch {
+		std::valarray<double> f_copy;
+		std::valarray<double> tmp;
+		std::valarray<double> sol;
+		std::valarray<double> faces;
+		std::valarray<double> traces;
+	};
+	int                                                         n;
+	bool                                                        batched     = true;
+	bool                                                        specialized = true;
+	int                                                         max_batch   = 32;
+	unsigned                                                    flags       = FFTW_MEASURE;
+	double                                                      lambda;
+	std::map<PlanK, fftw_plan>                                  plan1;
+	std::map<PlanK, fftw_plan>                                  plan2;
+	std::map<BatchKey, BatchPlan>                               batch_plans;
+	std::map<std::pair<PlanK, int>, fftw_plan>                  face_plans;
+	std::map<std::pair<DomainK<D>, int>, std::valarray<double>> face_coefs;
+	std::map<std::pair<PlanK, int>, fftw_plan>                  face_inv_plans;
+	std::map<std::pair<PlanK, int>, std::valarray<double>>      trace_kernels;
+	std::vector<Scratch>                                        scratch;
+	std::map<DomainK<D>, SeparableEigenvalues<D>>               eigs;
+#ifdef HAVE_FFTWF
+	bool                                            single = false;
+	std::map<std::pair<PlanK, int>, FloatBatchPlan> float_plans;
+	std::vector<float *>                            float_scratch;
+	int                                             float_scratch_size = 0;
+
+	FloatBatchPlan &getFloatBatchPlan(SchurDomain<D> &d, int count);
+	void solveFloatBatch(Batch &batch, SchurDomain<D> **batch_domains, const double *f_view,
+	                     double *u_view, const double *gamma_view);
+#endif
+
+	static PlanK getPlanK(const SchurDomain<D> &d)
+	{
+		return d.neumann.to_ulong();
+	}
+	void       getTransforms(SchurDomain<D> &d, fftw_r2r_kind *transforms,
+	                         fftw_r2r_kind *transforms_inv);
+	BatchPlan &getBatchPlan(SchurDomain<D> &d, int count, const RhsLayout &rhs);
+	std::vector<Batch> getBatches(std::vector<SchurDomain<D> *> &sorted, const RhsLayout &rhs);
+	void       allocateScratch();
+	void       addFacePlans(SchurDomain<D> &d);
+	/**
+	 * @brief Subtract the interface values of a patch from its rhs, with the kernel compiled for
+	 * the patch size if there is one
+	 */
+	void addGammaCorrection(SchurDomain<D> &d, double *patch, const double *gamma_view)
+	{
+		Utils::getKernel<GammaCorrection<D>::template Kernel>(n, specialized)(d, n, patch,
+		                                                                       gamma_view);
+	}
+	int        getFaceCorrections(SchurDomain<D> &d, const double *gamma_view, double *faces,
+	                              FaceCorrection *corrections);
+	template <typename T>
+	void addFaceCorrections(int o, T *row, const FaceCorrection *corrections, int num_faces);
+	void solve(SchurDomain<D> &d, const double *f_view, double *u_view, const double *gamma_view);
+	void traceSolve(SchurDomain<D> &d, double *u_view, const double *gamma_view);
+	void solveBatch(Batch &batch, SchurDomain<D> **batch_domains, const double *f_view,
+	                double *u_view, const double *gamma_view, const RhsLayout &rhs);
 
 	public:
-	FftwPatchSolver(DomainCollection<D> &dsc, double lambda = 0);
+	/**
+	 * @brief Create a new FftwPatchSolver
+	 *
+	 * @param dsc the DomainCollection
+	 * @param lambda the lambda value of the Helmholtz equation
+	 * @param wisdom if set, its planning flags are used instead of FFTW_MEASURE. Call
+	 * FftwWisdom::load first, so that the plans in the file are reused.
+	 */
+	FftwPatchSolver(DomainCollection<D> &dsc, double lambda = 0,
+	                std::shared_ptr<FftwWisdom> wisdom = nullptr);
 	~FftwPatchSolver();
 	void solve(SchurDomain<D> &d, const Vec f, Vec u, const Vec gamma);
-	void domainSolve(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u, const Vec gamma)
+	void domainSolve(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u, const Vec gamma);
+	/**
+	 * @brief Solve the patches, and call a function on each patch right after it is solved
+	 *
+	 * When the patches are solved in batches, the function is called on the patches of a batch
+	 * once the whole batch is solved, so a smaller max_batch in setBatched keeps more of each
+	 * batch in cache.
+	 */
+	using PatchSolver<D>::domainSolveFused;
+	void domainSolveFused(DomainList &domains, const Vec f, Vec u, const Vec gamma,
+	                      const typename PatchSolver<D>::PatchCallback &solved);
+	/**
+	 * @brief Solve the patches for the right hand sides in the columns of f.
+	 *
+	 * Each batch of patches is transformed for all of the columns with a single plan, so the
+	 * plans and eigenvalues are loaded once for every right hand side. When batching is turned off
+	 * or single precision is set, this falls back to calling domainSolve on each column.
+	 */
+	void domainSolveMulti(std::deque<SchurDomain<D>> &domains, const Mat f, Mat u,
+	                      const Mat gamma);
+	/**
+	 * @brief Solve the patches with a zero right hand side, only setting the cells next to the
+	 * sides with neighbors
+	 *
+	 * The solution in transform space only comes from the interface values, so it is formed one
+	 * row at a time from the transformed faces. Instead of the inverse transform of the whole
+	 * patch, the inverse transform along the axis of each side is evaluated at the cells next to
+	 * it, and only the faces are transformed back. This trades the two transforms of the patch for
+	 * one multiply-add per side for each value in the patch, and u is only written next to the
+	 * sides.
+	 *
+	 * This is always done in double precision, setSinglePrecision only applies to domainSolve.
+	 * The trace solves apply the Schur complement of the outer iteration, which is kept in double.
+	 */
+	using PatchSolver<D>::domainTraceSolve;
+	void domainTraceSolve(DomainList &domains, Vec u, const Vec gamma);
+	void addDomain(SchurDomain<D> &d);
+	/**
+	 * @brief Set whether domainSolve pushes runs of patches with the same DomainK through a single
+	 * batched plan, instead of solving the patches one at a time.
+	 *
+	 * The batched plans read straight from f and write straight into u, and the interface values
+	 * are added in transform space. When the vectors do not have the alignment that the plans were
+	 * made with, or when batching is turned off, the patches are copied into scratch space.
+	 *
+	 * @param batched true to use batched plans (the default)
+	 * @param max_batch the maximum number of patches in a batch
+	 */
+	void setBatched(bool batched, int max_batch = 32)
 	{
-		for (SchurDomain<D> &d : domains) {
-			solve(d, f, u, gamma);
-		}
+		this->batched   = batched;
+		this->max_batch = max_batch;
 	}
-	void addDomain(SchurDomain<D> &d);
+	/**
+	 * @brief Set whether the kernels compiled for fixed patch sizes are used
+	 *
+	 * @param specialized true to use them for the sizes they exist for (the default), false to
+	 * always use the generic kernel
+	 */
+	void setSpecialized(bool specialized)
+	{
+		this->specialized = specialized;
+	}
+#ifdef HAVE_FFTWF
+	/**
+	 * @brief Set whether the patches are solved in single precision.
+	 *
+	 * The patches are converted to float, transformed with fftwf plans, and converted back, so
+	 * the vectors stay in double. This is meant for solvers that are only used as smoothers or
+	 * preconditioners, patches are always solved in batches when this is set. domainTraceSolve
+	 * is not affected, it stays in double precision.
+	 *
+	 * @param single true to solve in single precision
+	 */
+	void setSinglePrecision(bool single)
+	{
+		this->single = single;
+	}
+#endif
 };
-template <size_t D> FftwPatchSolver<D>::FftwPatchSolver(DomainCollection<D> &dc, double lambda)
+template <size_t D>
+FftwPatchSolver<D>::FftwPatchSolver(DomainCollection<D> &dc, double lambda,
+                                    std::shared_ptr<FftwWisdom> wisdom)
 {
 	n            = dc.getN();
 	this->lambda = lambda;
+	if (wisdom != nullptr) { flags = wisdom->getPlanningFlags(); }
 }
 template <size_t D> FftwPatchSolver<D>::~FftwPatchSolver()
 {
@@ -86,128 +287,676 @@ template <size_t D> FftwPatchSolver<D>::~FftwPatchSolver()
 	for (auto p : plan2) {
 		fftw_destroy_plan(p.second);
 	}
+	for (auto p : batch_plans) {
+		fftw_destroy_plan(p.second.forward);
+		fftw_destroy_plan(p.second.backward);
+	}
+	for (auto p : face_plans) {
+		fftw_destroy_plan(p.second);
+	}
+	for (auto p : face_inv_plans) {
+		fftw_destroy_plan(p.second);
+	}
+#ifdef HAVE_FFTWF
+	for (auto p : float_plans) {
+		fftwf_destroy_plan(p.second.forward);
+		fftwf_destroy_plan(p.second.backward);
+	}
+	for (float *buffer : float_scratch) {
+		fftwf_free(buffer);
+	}
+#endif
 }
 template <size_t D> void FftwPatchSolver<D>::addDomain(SchurDomain<D> &d)
 {
 	using namespace std;
-	if (!initialized) {
-		initialized = true;
-		f_copy.resize(pow(n, D));
-		tmp.resize(pow(n, D));
-		sol.resize(pow(n, D));
-	}
+	allocateScratch();
 
 	int           ns[D];
 	fftw_r2r_kind transforms[D];
 	fftw_r2r_kind transforms_inv[D];
-	if (!plan1.count(d)) {
+	if (!plan1.count(getPlanK(d))) {
 		for (size_t i = 0; i < D; i++) {
-			ns[D-1-i] = n;
-			// x direction
-			if (d.isNeumann(2 * i) && d.isNeumann(2 * i + 1)) {
-				transforms[D-1-i]     = FFTW_REDFT10;
-				transforms_inv[D-1-i] = FFTW_REDFT01;
-			} else if (d.isNeumann(2 * i)) {
-				transforms[D-1-i]     = FFTW_REDFT11;
-				transforms_inv[D-1-i] = FFTW_REDFT11;
-			} else if (d.isNeumann(2 * i + 1)) {
-				transforms[D-1-i]     = FFTW_RODFT11;
-				transforms_inv[D-1-i] = FFTW_RODFT11;
-			} else {
-				transforms[D-1-i]     = FFTW_RODFT10;
-				transforms_inv[D-1-i] = FFTW_RODFT01;
-			}
+			ns[i] = n;
 		}
+		getTransforms(d, transforms, transforms_inv);
 
-		plan1[d]
-		= fftw_plan_r2r(D, ns, &f_copy[0], &tmp[0], transforms, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-		plan2[d]
-		= fftw_plan_r2r(D, ns, &tmp[0], &sol[0], transforms_inv, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+		Scratch &s         = scratch[0];
+		plan1[getPlanK(d)] = fftw_plan_r2r(D, ns, &s.f_copy[0], &s.tmp[0], transforms,
+		                                   flags | FFTW_DESTROY_INPUT);
+		plan2[getPlanK(d)] = fftw_plan_r2r(D, ns, &s.tmp[0], &s.sol[0], transforms_inv,
+		                                   flags | FFTW_DESTROY_INPUT);
 	}
 
-	if (!denoms.count(d)) {
-		valarray<double> &denom = denoms[d];
-		denom.resize(pow(n, D));
+	if (!eigs.count(d)) { eigs[d] = SeparableEigenvalues<D>(d, n, lambda); }
 
-		valarray<double> ones(pow(n, D - 1));
-		ones = 1;
+	addFacePlans(d);
+}
+template <size_t D> void FftwPatchSolver<D>::addFacePlans(SchurDomain<D> &d)
+{
+	using namespace std;
+	fftw_r2r_kind transforms[D];
+	fftw_r2r_kind transforms_inv[D];
+	getTransforms(d, transforms, transforms_inv);
 
-		for (size_t i = 0; i < D; i++) {
-			valarray<size_t> sizes(D - 1);
-			sizes = n;
-			valarray<size_t> strides(D - 1);
-			for (size_t d = 1; d < D; d++) {
-				strides[d - 1] = pow(n, (i + d) % D);
+	for (Side<D> s : Side<D>::getValues()) {
+		if (!d.hasNbr(s)) { continue; }
+		int axis = s.toInt() / 2;
+
+		// the (D-1) dimensional transform of the interface values, the face is ordered with the
+		// lowest remaining axis fastest, so the kinds are reversed for fftw
+		pair<PlanK, int> plan_key(getPlanK(d), axis);
+		if (!face_plans.count(plan_key)) {
+			int           ns[D - 1];
+			fftw_r2r_kind face_transforms[D - 1];
+			fftw_r2r_kind face_transforms_inv[D - 1];
+			int           m = 0;
+			for (size_t i = 0; i < D; i++) {
+				if ((int) i == axis) { continue; }
+				ns[m]                          = n;
+				face_transforms[D - 2 - m]     = transforms[D - 1 - i];
+				face_transforms_inv[D - 2 - m] = transforms_inv[D - 1 - i];
+				m++;
 			}
-			double h = d.domain.lengths[i] / n;
+			valarray<double> in(pow(n, D - 1));
+			valarray<double> out(pow(n, D - 1));
+			face_plans[plan_key]
+			= fftw_plan_r2r(D - 1, ns, &in[0], &out[0], face_transforms,
+			                flags | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+			face_inv_plans[plan_key]
+			= fftw_plan_r2r(D - 1, ns, &in[0], &out[0], face_transforms_inv,
+			                flags | FFTW_UNALIGNED | FFTW_DESTROY_INPUT);
+		}
 
-			if (d.isNeumann(i * 2) && d.isNeumann(i * 2 + 1)) {
-				for (int xi = 0; xi < n; xi++) {
-					denom[gslice(xi * pow(n, i), sizes, strides)]
-					-= 4 / (h * h) * pow(sin(xi * M_PI / (2 * n)), 2) * ones;
-				}
-			} else if (d.isNeumann(i * 2) || d.isNeumann(i * 2 + 1)) {
-				for (int xi = 0; xi < n; xi++) {
-					denom[gslice(xi * pow(n, i), sizes, strides)]
-					-= 4 / (h * h) * pow(sin((xi + 0.5) * M_PI / (2 * n)), 2) * ones;
+		// the 1D transform along the axis of the side of a delta on the boundary cell, scaled by
+		// the interface value coefficient
+		pair<DomainK<D>, int> coef_key(d, s.toInt());
+		if (!face_coefs.count(coef_key)) {
+			valarray<double> &coef = face_coefs[coef_key];
+			coef.resize(n);
+			double        h2   = pow(d.domain.lengths[axis] / n, 2);
+			double        j    = s.isLowerOnAxis() ? 0.5 : n - 0.5;
+			fftw_r2r_kind kind = transforms[D - 1 - axis];
+			for (int k = 0; k < n; k++) {
+				double kernel = 0;
+				switch (kind) {
+					case FFTW_REDFT10:
+						kernel = cos(M_PI * j * k / n);
+						break;
+					case FFTW_RODFT10:
+						kernel = sin(M_PI * j * (k + 1) / n);
+						break;
+					case FFTW_REDFT11:
+						kernel = cos(M_PI * j * (k + 0.5) / n);
+						break;
+					default:
+						kernel = sin(M_PI * j * (k + 0.5) / n);
+						break;
 				}
-			} else {
-				for (int xi = 0; xi < n; xi++) {
-					denom[gslice(xi * pow(n, i), sizes, strides)]
-					-= 4 / (h * h) * pow(sin((xi + 1) * M_PI / (2 * n)), 2) * ones;
+				coef[k] = -2.0 / h2 * 2 * kernel;
+			}
+		}
+
+		// the inverse transform along the axis of the side, evaluated at the cell next to it
+		pair<PlanK, int> trace_key(getPlanK(d), s.toInt());
+		if (!trace_kernels.count(trace_key)) {
+			valarray<double> &kernel = trace_kernels[trace_key];
+			kernel.resize(n);
+			double        j    = s.isLowerOnAxis() ? 0.5 : n - 0.5;
+			fftw_r2r_kind kind = transforms_inv[D - 1 - axis];
+			for (int k = 0; k < n; k++) {
+				switch (kind) {
+					case FFTW_REDFT01:
+						kernel[k] = k == 0 ? 1 : 2 * cos(M_PI * k * j / n);
+						break;
+					case FFTW_RODFT01:
+						kernel[k] = k == n - 1 ? sin(M_PI * j) : 2 * sin(M_PI * (k + 1) * j / n);
+						break;
+					case FFTW_REDFT11:
+						kernel[k] = 2 * cos(M_PI * (k + 0.5) * j / n);
+						break;
+					default:
+						kernel[k] = 2 * sin(M_PI * (k + 0.5) * j / n);
+						break;
 				}
 			}
 		}
+	}
+}
+template <size_t D>
+void FftwPatchSolver<D>::getTransforms(SchurDomain<D> &d, fftw_r2r_kind *transforms,
+                                       fftw_r2r_kind *transforms_inv)
+{
+	for (size_t i = 0; i < D; i++) {
+		// x direction
+		if (d.isNeumann(2 * i) && d.isNeumann(2 * i + 1)) {
+			transforms[D - 1 - i]     = FFTW_REDFT10;
+			transforms_inv[D - 1 - i] = FFTW_REDFT01;
+		} else if (d.isNeumann(2 * i)) {
+			transforms[D - 1 - i]     = FFTW_REDFT11;
+			transforms_inv[D - 1 - i] = FFTW_REDFT11;
+		} else if (d.isNeumann(2 * i + 1)) {
+			transforms[D - 1 - i]     = FFTW_RODFT11;
+			transforms_inv[D - 1 - i] = FFTW_RODFT11;
+		} else {
+			transforms[D - 1 - i]     = FFTW_RODFT10;
+			transforms_inv[D - 1 - i] = FFTW_RODFT01;
+		}
+	}
+}
+template <size_t D>
+typename FftwPatchSolver<D>::BatchPlan &
+FftwPatchSolver<D>::getBatchPlan(SchurDomain<D> &d, int count, const RhsLayout &rhs)
+{
+	using namespace std;
+	BatchKey key(getPlanK(d), count, rhs.num, rhs.f_dist, rhs.u_dist);
+	auto     iter = batch_plans.find(key);
+	if (iter != batch_plans.end()) { return iter->second; }
+
+	fftw_r2r_kind transforms[D];
+	fftw_r2r_kind transforms_inv[D];
+	getTransforms(d, transforms, transforms_inv);
 
-		denom += lambda;
+	// the patches in the batch, and then the right hand sides, are the loops around the transform
+	int        patch_size   = pow(n, D);
+	int        num_loops    = rhs.num > 1 ? 2 : 1;
+	fftw_iodim in_loops[2]  = {{count, patch_size, patch_size}, {rhs.num, rhs.f_dist, rhs.u_dist}};
+	fftw_iodim out_loops[2] = {{count, patch_size, patch_size}, {rhs.num, rhs.u_dist, rhs.u_dist}};
+	fftw_iodim dims[D];
+	for (size_t i = 0; i < D; i++) {
+		dims[i].n  = n;
+		dims[i].is = pow(n, D - 1 - i);
+		dims[i].os = dims[i].is;
 	}
+
+	// plans are created on scratch buffers, and then executed on the domain vectors
+	valarray<double> in((rhs.num - 1) * rhs.f_dist + count * patch_size);
+	valarray<double> out((rhs.num - 1) * rhs.u_dist + count * patch_size);
+	BatchPlan &      bp = batch_plans[key];
+	bp.forward  = fftw_plan_guru_r2r(D, dims, num_loops, in_loops, &in[0], &out[0], transforms,
+	                                 flags | FFTW_PRESERVE_INPUT);
+	bp.backward = fftw_plan_guru_r2r(D, dims, num_loops, out_loops, &out[0], &out[0],
+	                                 transforms_inv, flags);
+	bp.in_alignment  = fftw_alignment_of(&in[0]);
+	bp.out_alignment = fftw_alignment_of(&out[0]);
+	return bp;
 }
+#ifdef HAVE_FFTWF
 template <size_t D>
-void FftwPatchSolver<D>::solve(SchurDomain<D> &d, const Vec f, Vec u, const Vec gamma)
+typename FftwPatchSolver<D>::FloatBatchPlan &
+FftwPatchSolver<D>::getFloatBatchPlan(SchurDomain<D> &d, int count)
 {
 	using namespace std;
-	using namespace Utils;
+	pair<PlanK, int> key(getPlanK(d), count);
+	auto             iter = float_plans.find(key);
+	if (iter != float_plans.end()) { return iter->second; }
+
+	int           ns[D];
+	fftw_r2r_kind transforms[D];
+	fftw_r2r_kind transforms_inv[D];
+	for (size_t i = 0; i < D; i++) {
+		ns[i] = n;
+	}
+	getTransforms(d, transforms, transforms_inv);
+
+	int             patch_size = pow(n, D);
+	float *         buffer     = (float *) fftwf_malloc(count * patch_size * sizeof(float));
+	FloatBatchPlan &fp         = float_plans[key];
+	fp.forward  = fftwf_plan_many_r2r(D, ns, count, buffer, nullptr, 1, patch_size, buffer,
+	                                  nullptr, 1, patch_size, transforms, flags);
+	fp.backward = fftwf_plan_many_r2r(D, ns, count, buffer, nullptr, 1, patch_size, buffer,
+	                                  nullptr, 1, patch_size, transforms_inv, flags);
+	fftwf_free(buffer);
+	return fp;
+}
+#endif
+template <size_t D> void FftwPatchSolver<D>::allocateScratch()
+{
+	// every thread gets its own copy of the scratch space, the plans are executed on them with
+	// fftw_execute_r2r, which is thread safe
+	int patch_size = std::pow(n, D);
+	while ((int) scratch.size() < Utils::getMaxThreads()) {
+		Scratch s;
+		s.f_copy.resize(patch_size);
+		s.tmp.resize(patch_size);
+		s.sol.resize(patch_size);
+		s.faces.resize(2 * D * std::pow(n, D - 1));
+		s.traces.resize(2 * D * std::pow(n, D - 1));
+		scratch.push_back(s);
+	}
+#ifdef HAVE_FFTWF
+	if (single) {
+		// fftwf_malloc gives every buffer the same alignment as the one the plans are made on
+		int float_size = max_batch * patch_size;
+		if (float_scratch_size != float_size) {
+			for (float *buffer : float_scratch) {
+				fftwf_free(buffer);
+			}
+			float_scratch.clear();
+			float_scratch_size = float_size;
+		}
+		while ((int) float_scratch.size() < Utils::getMaxThreads()) {
+			float_scratch.push_back((float *) fftwf_malloc(float_size * sizeof(float)));
+		}
+	}
+#endif
+}
+template <size_t D>
+int FftwPatchSolver<D>::getFaceCorrections(SchurDomain<D> &d, const double *gamma_view,
+                                           double *faces, FaceCorrection *corrections)
+{
+	using namespace std;
+	int face_size = pow(n, D - 1);
+	int num_faces = 0;
+	for (Side<D> s : Side<D>::getValues()) {
+		if (d.hasNbr(s)) {
+			int           axis  = s.toInt() / 2;
+			double *      face  = faces + num_faces * face_size;
+			const double *gamma = gamma_view + face_size * d.getIfaceLocalIndex(s);
+			fftw_execute_r2r(face_plans.at(make_pair(getPlanK(d), axis)),
+			                 const_cast<double *>(gamma), face);
+			FaceCorrection &c = corrections[num_faces];
+			c.coef            = &face_coefs.at(make_pair(DomainK<D>(d), s.toInt()))[0];
+			c.face            = face;
+			c.axis            = axis;
+			c.stride          = axis == 0 ? 0 : pow(n, axis - 1);
+			num_faces++;
+		}
+	}
+	return num_faces;
+}
+template <size_t D>
+template <typename T>
+void FftwPatchSolver<D>::addFaceCorrections(int o, T *row, const FaceCorrection *corrections,
+                                            int num_faces)
+{
+	for (int c = 0; c < num_faces; c++) {
+		const FaceCorrection &fc = corrections[c];
+		if (fc.axis == 0) {
+			double g = fc.face[o];
+			for (int x = 0; x < n; x++) {
+				row[x] += fc.coef[x] * g;
+			}
+		} else {
+			// drop the index along the axis of the side from the row index
+			int           k     = (o / fc.stride) % n;
+			int           other = o % fc.stride + (o / (fc.stride * n)) * fc.stride;
+			const double *g     = fc.face + n * other;
+			double        coef  = fc.coef[k];
+			for (int x = 0; x < n; x++) {
+				row[x] += coef * g[x];
+			}
+		}
+	}
+}
+template <size_t D>
+void FftwPatchSolver<D>::solve(SchurDomain<D> &d, const Vec f, Vec u, const Vec gamma)
+{
 	const double *f_view, *gamma_view;
+	double *      u_view;
 	VecGetArrayRead(f, &f_view);
 	VecGetArrayRead(gamma, &gamma_view);
+	VecGetArray(u, &u_view);
+
+	solve(d, f_view, u_view, gamma_view);
+
+	VecRestoreArray(u, &u_view);
+	VecRestoreArrayRead(f, &f_view);
+	VecRestoreArrayRead(gamma, &gamma_view);
+}
+template <size_t D>
+void FftwPatchSolver<D>::solve(SchurDomain<D> &d, const double *f_view, double *u_view,
+                               const double *gamma_view)
+{
+	using namespace std;
+	Scratch &s     = scratch[Utils::getThreadNum()];
+	int      start = d.local_index * pow(n, D);
+	for (int i = 0; i < pow(n, D); i++) {
+		s.f_copy[i] = f_view[start + i];
+	}
+
+	addGammaCorrection(d, &s.f_copy[0], gamma_view);
+
+	fftw_execute_r2r(plan1.at(getPlanK(d)), &s.f_copy[0], &s.tmp[0]);
+
+	eigs.at(d).divide(&s.tmp[0], 1.0 / pow(2.0 * n, D));
+
+	if (d.neumann.all()) { s.tmp[0] = 0; }
+
+	fftw_execute_r2r(plan2.at(getPlanK(d)), &s.tmp[0], &s.sol[0]);
 
-	int start = d.local_index * pow(n, D);
 	for (int i = 0; i < pow(n, D); i++) {
-		f_copy[i] = f_view[start + i];
+		u_view[start + i] = s.sol[i];
 	}
+}
+template <size_t D>
+void FftwPatchSolver<D>::domainTraceSolve(DomainList &domains, Vec u, const Vec gamma)
+{
+	allocateScratch();
 
-	for (Side<D> s : Side<D>::getValues()) {
-		if (d.hasNbr(s)) {
-			int          idx = pow(n, D - 1) * d.getIfaceLocalIndex(s);
-			Slice<D - 1> sl  = getSlice<D - 1>(&f_copy[0], n, s);
-			double       h2  = pow(d.domain.lengths[s.toInt() / 2] / n, 2);
-			for (int i = 0; i < (int) pow(n, D - 1); i++) {
-				std::array<int, D - 1> coord;
-				for (size_t x = 0; x < D - 1; x++) {
-					coord[x] = (i / (int) pow(n, x)) % n;
+	const double *gamma_view;
+	double *      u_view;
+	VecGetArrayRead(gamma, &gamma_view);
+	VecGetArray(u, &u_view);
+
+	std::vector<SchurDomain<D> *> nonzero
+	= PatchSolver<D>::getNonzeroPatches(domains, nullptr, u_view, gamma_view);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int) nonzero.size(); i++) {
+		traceSolve(*nonzero[i], u_view, gamma_view);
+	}
+
+	VecRestoreArray(u, &u_view);
+	VecRestoreArrayRead(gamma, &gamma_view);
+}
+template <size_t D>
+void FftwPatchSolver<D>::traceSolve(SchurDomain<D> &d, double *u_view, const double *gamma_view)
+{
+	using namespace std;
+	using namespace Utils;
+	Scratch &s         = scratch[Utils::getThreadNum()];
+	int      face_size = pow(n, D - 1);
+
+	// with a zero right hand side, the patch in transform space is only the interface values
+	FaceCorrection corrections[2 * D];
+	int            num_faces = getFaceCorrections(d, gamma_view, &s.faces[0], corrections);
+	eigs.at(d).divide(&s.tmp[0], 1.0 / pow(2.0 * n, D), [&](int o, double *row) {
+		for (int x = 0; x < n; x++) {
+			row[x] = 0;
+		}
+		addFaceCorrections(o, row, corrections, num_faces);
+	});
+	if (d.neumann.all()) { s.tmp[0] = 0; }
+
+	FaceTrace traces[2 * D];
+	int       num_traces = 0;
+	for (Side<D> side : Side<D>::getValues()) {
+		if (!d.hasNbr(side)) { continue; }
+		FaceTrace &t = traces[num_traces];
+		t.kernel     = &trace_kernels.at(make_pair(getPlanK(d), side.toInt()))[0];
+		t.face       = &s.traces[num_traces * face_size];
+		t.side       = side;
+		t.axis       = side.toInt() / 2;
+		t.stride     = t.axis == 0 ? 0 : pow(n, t.axis - 1);
+		for (int i = 0; i < face_size; i++) {
+			t.face[i] = 0;
+		}
+		num_traces++;
+	}
+
+	// sum each row into the faces, the faces are indexed the same way as in addFaceCorrections
+	for (int o = 0; o < face_size; o++) {
+		const double *row = &s.tmp[o * n];
+		for (int c = 0; c < num_traces; c++) {
+			FaceTrace &t = traces[c];
+			if (t.axis == 0) {
+				double sum = 0;
+				for (int x = 0; x < n; x++) {
+					sum += t.kernel[x] * row[x];
+				}
+				t.face[o] = sum;
+			} else {
+				int     k     = (o / t.stride) % n;
+				int     other = o % t.stride + (o / (t.stride * n)) * t.stride;
+				double *face  = t.face + n * other;
+				double  coef  = t.kernel[k];
+				for (int x = 0; x < n; x++) {
+					face[x] += coef * row[x];
 				}
-				sl(coord) -= 2.0 / h2 * gamma_view[idx + i];
 			}
 		}
 	}
 
-	fftw_execute(plan1[d]);
+	// transform the faces back into the cells next to the sides
+	double *patch = u_view + d.local_index * (int) pow(n, D);
+	for (int c = 0; c < num_traces; c++) {
+		FaceTrace &t = traces[c];
+		fftw_execute_r2r(face_inv_plans.at(make_pair(getPlanK(d), t.axis)), t.face, &s.sol[0]);
+		Utils::copyToFace<D>(patch, n, t.side, &s.sol[0]);
+	}
+}
+template <size_t D>
+void FftwPatchSolver<D>::domainSolve(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u,
+                                     const Vec gamma)
+{
+	DomainList list = PatchSolver<D>::getDomainList(domains);
+	domainSolveFused(list, f, u, gamma, nullptr);
+}
+template <size_t D>
+void FftwPatchSolver<D>::domainSolveFused(DomainList &domains, const Vec f, Vec u,
+                                          const Vec gamma,
+                                          const typename PatchSolver<D>::PatchCallback &solved)
+{
+	using namespace std;
+	allocateScratch();
 
-	tmp /= denoms[d];
+	const double *f_view, *gamma_view;
+	double *      u_view;
+	VecGetArrayRead(f, &f_view);
+	VecGetArrayRead(gamma, &gamma_view);
+	VecGetArray(u, &u_view);
 
-	if (d.neumann.all()) { tmp[0] = 0; }
+	// the zero patches are left out of the solves and the batches
+	vector<SchurDomain<D> *> sorted
+	= PatchSolver<D>::getNonzeroPatches(domains, f_view, u_view, gamma_view);
 
-	fftw_execute(plan2[d]);
+	bool use_batches = batched;
+#ifdef HAVE_FFTWF
+	use_batches = batched || single;
+#endif
+	if (!use_batches) {
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < (int) sorted.size(); i++) {
+			solve(*sorted[i], f_view, u_view, gamma_view);
+			if (solved) { solved(*sorted[i], u_view); }
+		}
 
-	sol /= pow(2.0 * n, D);
+		VecRestoreArray(u, &u_view);
+		VecRestoreArrayRead(f, &f_view);
+		VecRestoreArrayRead(gamma, &gamma_view);
+		return;
+	}
 
-	double *u_view;
-	VecGetArray(u, &u_view);
-	for (int i = 0; i < pow(n, D); i++) {
-		u_view[start + i] = sol[i];
+	RhsLayout     rhs;
+	vector<Batch> batches = getBatches(sorted, rhs);
+
+	// all plans have been created at this point, so the batches can be solved concurrently
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int) batches.size(); i++) {
+		Batch &batch = batches[i];
+#ifdef HAVE_FFTWF
+		if (single) {
+			solveFloatBatch(batch, &sorted[batch.start], f_view, u_view, gamma_view);
+		} else {
+			solveBatch(batch, &sorted[batch.start], f_view, u_view, gamma_view, rhs);
+		}
+#else
+		solveBatch(batch, &sorted[batch.start], f_view, u_view, gamma_view, rhs);
+#endif
+		if (solved) {
+			for (int j = batch.start; j < batch.start + batch.count; j++) {
+				solved(*sorted[j], u_view);
+			}
+		}
 	}
+
 	VecRestoreArray(u, &u_view);
 	VecRestoreArrayRead(f, &f_view);
 	VecRestoreArrayRead(gamma, &gamma_view);
 }
+template <size_t D>
+std::vector<typename FftwPatchSolver<D>::Batch>
+FftwPatchSolver<D>::getBatches(std::vector<SchurDomain<D> *> &sorted, const RhsLayout &rhs)
+{
+	using namespace std;
+	// sort by local index so that patches that are next to each other in memory can be batched
+	sort(sorted.begin(), sorted.end(), [](const SchurDomain<D> *a, const SchurDomain<D> *b) {
+		return a->local_index < b->local_index;
+	});
+
+	// split into runs of contiguous patches with the same key, each run is then split into
+	// power-of-two sized batches so that only a few plans are needed for each key
+	vector<Batch> batches;
+	size_t        run_start = 0;
+	while (run_start < sorted.size()) {
+		DomainK<D> key(*sorted[run_start]);
+		size_t     run_end = run_start + 1;
+		while (run_end < sorted.size() && run_end - run_start < (size_t) max_batch
+		       && sorted[run_end]->local_index == sorted[run_end - 1]->local_index + 1
+		       && DomainK<D>(*sorted[run_end]) == key) {
+			run_end++;
+		}
+		const SeparableEigenvalues<D> &key_eigs = eigs.at(key);
+		while (run_start < run_end) {
+			int count = 1;
+			while (count * 2 <= (int) (run_end - run_start)) {
+				count *= 2;
+			}
+			Batch batch;
+#ifdef HAVE_FFTWF
+			if (single) {
+				batch.float_plan = &getFloatBatchPlan(*sorted[run_start], count);
+			} else {
+				batch.plan = &getBatchPlan(*sorted[run_start], count, rhs);
+			}
+#else
+			batch.plan = &getBatchPlan(*sorted[run_start], count, rhs);
+#endif
+			batch.eigs  = &key_eigs;
+			batch.start = run_start;
+			batch.count = count;
+			batches.push_back(batch);
+			run_start += count;
+		}
+	}
+
+	return batches;
+}
+template <size_t D>
+void FftwPatchSolver<D>::domainSolveMulti(std::deque<SchurDomain<D>> &domains, const Mat f,
+                                          Mat u, const Mat gamma)
+{
+	using namespace std;
+#ifdef HAVE_FFTWF
+	if (!batched || single) {
+#else
+	if (!batched) {
+#endif
+		PatchSolver<D>::domainSolveMulti(domains, f, u, gamma);
+		return;
+	}
+	allocateScratch();
+
+	PetscInt  num_rhs, f_lda, u_lda, gamma_lda;
+	RhsLayout rhs;
+	MatGetSize(f, nullptr, &num_rhs);
+	MatDenseGetLDA(f, &f_lda);
+	MatDenseGetLDA(u, &u_lda);
+	MatDenseGetLDA(gamma, &gamma_lda);
+	rhs.num        = num_rhs;
+	rhs.f_dist     = f_lda;
+	rhs.u_dist     = u_lda;
+	rhs.gamma_dist = gamma_lda;
+
+	DomainList    sorted  = PatchSolver<D>::getDomainList(domains);
+	vector<Batch> batches = getBatches(sorted, rhs);
+
+	double *f_view, *u_view, *gamma_view;
+	MatDenseGetArray(f, &f_view);
+	MatDenseGetArray(u, &u_view);
+	MatDenseGetArray(gamma, &gamma_view);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int) batches.size(); i++) {
+		solveBatch(batches[i], &sorted[batches[i].start], f_view, u_view, gamma_view, rhs);
+	}
+
+	MatDenseRestoreArray(f, &f_view);
+	MatDenseRestoreArray(u, &u_view);
+	MatDenseRestoreArray(gamma, &gamma_view);
+}
+template <size_t D>
+void FftwPatchSolver<D>::solveBatch(Batch &batch, SchurDomain<D> **batch_domains,
+                                    const double *f_view, double *u_view,
+                                    const double *gamma_view, const RhsLayout &rhs)
+{
+	using namespace std;
+	int     patch_size = pow(n, D);
+	int     start      = batch_domains[0]->local_index * patch_size;
+	double *f_start    = const_cast<double *>(f_view + start);
+	double *u_start    = u_view + start;
+
+	// the plans can only be executed on arrays with the same alignment they were created with
+	if (fftw_alignment_of(f_start) != batch.plan->in_alignment
+	    || fftw_alignment_of(u_start) != batch.plan->out_alignment) {
+		for (int j = 0; j < rhs.num; j++) {
+			for (int i = 0; i < batch.count; i++) {
+				solve(*batch_domains[i], f_view + j * rhs.f_dist, u_view + j * rhs.u_dist,
+				      gamma_view + j * rhs.gamma_dist);
+			}
+		}
+		return;
+	}
+
+	fftw_execute_r2r(batch.plan->forward, f_start, u_start);
+
+	// add the interface values in transform space while dividing by the eigenvalues, every right
+	// hand side of a patch is done before moving on to the next patch
+	Scratch &      s     = scratch[Utils::getThreadNum()];
+	double         scale = 1.0 / pow(2.0 * n, D);
+	FaceCorrection corrections[2 * D];
+	for (int i = 0; i < batch.count; i++) {
+		for (int j = 0; j < rhs.num; j++) {
+			double *patch     = u_start + j * rhs.u_dist + i * patch_size;
+			int     num_faces = getFaceCorrections(
+			*batch_domains[i], gamma_view + j * rhs.gamma_dist, &s.faces[0], corrections);
+			batch.eigs->divide(patch, scale, [&](int o, double *row) {
+				addFaceCorrections(o, row, corrections, num_faces);
+			});
+			if (batch_domains[0]->neumann.all()) { patch[0] = 0; }
+		}
+	}
+
+	fftw_execute_r2r(batch.plan->backward, u_start, u_start);
+}
+#ifdef HAVE_FFTWF
+template <size_t D>
+void FftwPatchSolver<D>::solveFloatBatch(Batch &batch, SchurDomain<D> **batch_domains,
+                                         const double *f_view, double *u_view,
+                                         const double *gamma_view)
+{
+	using namespace std;
+	int    patch_size = pow(n, D);
+	int    start      = batch_domains[0]->local_index * patch_size;
+	int    size       = batch.count * patch_size;
+	float *buffer     = float_scratch[Utils::getThreadNum()];
+
+	for (int i = 0; i < size; i++) {
+		buffer[i] = f_view[start + i];
+	}
+
+	fftwf_execute_r2r(batch.float_plan->forward, buffer, buffer);
+
+	// the interface values are added in transform space, in double, while dividing
+	Scratch &      s     = scratch[Utils::getThreadNum()];
+	double         scale = 1.0 / pow(2.0 * n, D);
+	FaceCorrection corrections[2 * D];
+	for (int i = 0; i < batch.count; i++) {
+		float *patch     = buffer + i * patch_size;
+		int    num_faces
+		= getFaceCorrections(*batch_domains[i], gamma_view, &s.faces[0], corrections);
+		batch.eigs->divide(patch, scale, [&](int o, float *row) {
+			addFaceCorrections(o, row, corrections, num_faces);
+		});
+		if (batch_domains[0]->neumann.all()) { patch[0] = 0; }
+	}
+
+	fftwf_execute_r2r(batch.float_plan->backward, buffer, buffer);
+
+	for (int i = 0; i < size; i++) {
+		u_view[start + i] = buffer[i];
+	}
+}
+#endif
 #endif
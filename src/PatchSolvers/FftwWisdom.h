@@ -0,0 +1,148 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef FFTWWISDOM_H
+#define FFTWWISDOM_H
+#include <cstdlib>
+#include <cstring>
+#include <fftw3.h>
+#include <fstream>
+#include <mpi.h>
+#include <sstream>
+#include <string>
+#include <vector>
+/**
+ * @brief A wisdom file that is shared by the ranks of a communicator.
+ *
+ * With load(), the first rank reads the file and broadcasts it, so that the plans only have to be
+ * measured once, and not on every rank on every run. Plans that were created during the run are
+ * gathered back to the first rank and written out with save(). The file name is keyed by the
+ * patch size and dimension, the transform kinds of each plan are keyed in the wisdom itself.
+ *
+ * Creating the cache, and passing it to the patch solvers, does not communicate. Only load() and
+ * save() are collective, over the communicator that is passed to them.
+ */
+class FftwWisdom
+{
+	private:
+	std::string file_name;
+	unsigned    flags;
+	bool        loaded = false;
+
+	public:
+	/**
+	 * @brief Create a new wisdom cache
+	 *
+	 * @param prefix the prefix of the wisdom file, "_n<n>_<D>d.wisdom" is appended to it
+	 * @param n the number of cells in each direction of a patch
+	 * @param D the dimension of the patches
+	 * @param flags the planning flags to use, plans that are already in the file are reused
+	 * instead of being measured again
+	 */
+	FftwWisdom(std::string prefix, int n, int D, unsigned flags = FFTW_PATIENT)
+	{
+		std::stringstream ss;
+		ss << prefix << "_n" << n << "_" << D << "d.wisdom";
+		file_name   = ss.str();
+		this->flags = flags;
+	}
+	/**
+	 * @brief Read the wisdom file on the first rank of comm and import it on all of its ranks.
+	 * This is collective over comm, and only does work the first time it is called.
+	 *
+	 * @param comm the ranks that share the wisdom
+	 */
+	void load(MPI_Comm comm)
+	{
+		if (loaded) { return; }
+		loaded = true;
+
+		int rank;
+		MPI_Comm_rank(comm, &rank);
+
+		std::string wisdom;
+		if (rank == 0) {
+			std::ifstream     file(file_name);
+			std::stringstream ss;
+			if (file) { ss << file.rdbuf(); }
+			wisdom = ss.str();
+		}
+		int size = wisdom.size();
+		MPI_Bcast(&size, 1, MPI_INT, 0, comm);
+		if (size == 0) { return; }
+		wisdom.resize(size);
+		MPI_Bcast(&wisdom[0], size, MPI_CHAR, 0, comm);
+		fftw_import_wisdom_from_string(wisdom.c_str());
+	}
+	/**
+	 * @brief Merge the wisdom of every rank of comm on its first rank, and write it to the wisdom
+	 * file. This is collective over comm.
+	 *
+	 * @param comm the ranks that share the wisdom
+	 */
+	void save(MPI_Comm comm)
+	{
+		int rank, num_procs;
+		MPI_Comm_rank(comm, &rank);
+		MPI_Comm_size(comm, &num_procs);
+
+		char *wisdom = fftw_export_wisdom_to_string();
+		int   size   = wisdom == nullptr ? 0 : std::strlen(wisdom) + 1;
+
+		std::vector<int> sizes(num_procs);
+		MPI_Gather(&size, 1, MPI_INT, &sizes[0], 1, MPI_INT, 0, comm);
+		std::vector<int> displs(num_procs);
+		int              total = 0;
+		for (int i = 0; i < num_procs; i++) {
+			displs[i] = total;
+			total += sizes[i];
+		}
+		std::vector<char> all(total + 1);
+		MPI_Gatherv(wisdom, size, MPI_CHAR, &all[0], &sizes[0], &displs[0], MPI_CHAR, 0, comm);
+		std::free(wisdom);
+
+		if (rank == 0) {
+			for (int i = 1; i < num_procs; i++) {
+				if (sizes[i] > 0) { fftw_import_wisdom_from_string(&all[displs[i]]); }
+			}
+			fftw_export_wisdom_to_filename(file_name.c_str());
+		}
+	}
+	/**
+	 * @brief Whether load() has been called
+	 */
+	bool isLoaded() const
+	{
+		return loaded;
+	}
+	/**
+	 * @brief Get the planning flags that should be used for new plans
+	 */
+	unsigned getPlanningFlags() const
+	{
+		return flags;
+	}
+	std::string getFileName() const
+	{
+		return file_name;
+	}
+};
+#endif
@@ -20,32 +20,72 @@
  ***************************************************************************/
 
 #include "FishpackPatchSolver.h"
-#include <valarray>
 #include <iostream>
+#include <valarray>
+#include <vector>
 extern "C" {
 void hstcrt_(double *a, double *b, int *m, int *mbdcnd, const double *bda, const double *bdb,
              double *c, double *d, int *n, int *nbdcnd, const double *bdc, const double *bdd,
              double *elmbda, double *f, int *idimf, double *pertrb, int *ierror, double *w);
 }
 using namespace std;
-void FishpackPatchSolver::solve(Domain &d, const Vec f, Vec u, const Vec gamma)
+void FishpackPatchSolver::domainSolve(std::deque<SchurDomain<2>> &domains, const Vec f, Vec u,
+                                      const Vec gamma)
+{
+	DomainList list = getDomainList(domains);
+	domainSolveFused(list, f, u, gamma, nullptr);
+}
+void FishpackPatchSolver::domainSolveFused(DomainList &domains, const Vec f, Vec u,
+                                           const Vec gamma, const PatchCallback &solved)
+{
+	const double *f_view, *gamma_view;
+	double *      u_view;
+	VecGetArrayRead(f, &f_view);
+	VecGetArrayRead(gamma, &gamma_view);
+	VecGetArray(u, &u_view);
+
+	DomainList nonzero = getNonzeroPatches(domains, f_view, u_view, gamma_view);
+
+	// the fishpack work array is allocated for each solve, so patches can be solved concurrently
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int) nonzero.size(); i++) {
+		solve(*nonzero[i], f_view, u_view, gamma_view);
+		if (solved) { solved(*nonzero[i], u_view); }
+	}
+
+	VecRestoreArray(u, &u_view);
+	VecRestoreArrayRead(f, &f_view);
+	VecRestoreArrayRead(gamma, &gamma_view);
+}
+void FishpackPatchSolver::solve(SchurDomain<2> &d, const Vec f, Vec u, const Vec gamma)
 {
-	double  h_x = d.x_length / d.n;
-	double  h_y = d.y_length / d.n;
-	double *gamma_view, *f_view, *u_view;
-	VecGetArray(gamma, &gamma_view);
-	VecGetArray(f, &f_view);
+	const double *f_view, *gamma_view;
+	double *      u_view;
+	VecGetArrayRead(f, &f_view);
+	VecGetArrayRead(gamma, &gamma_view);
 	VecGetArray(u, &u_view);
+
+	solve(d, f_view, u_view, gamma_view);
+
+	VecRestoreArray(u, &u_view);
+	VecRestoreArrayRead(f, &f_view);
+	VecRestoreArrayRead(gamma, &gamma_view);
+}
+void FishpackPatchSolver::solve(SchurDomain<2> &d, const double *f_view, double *u_view,
+                                const double *gamma_view)
+{
+	double           h_x = d.domain.lengths[0] / d.n;
+	double           h_y = d.domain.lengths[1] / d.n;
 	valarray<double> zeros(d.n);
-	double           a      = d.x_start;
-	double           b      = d.x_start + d.x_length;
+	double           a      = d.domain.starts[0];
+	double           b      = d.domain.starts[0] + d.domain.lengths[0];
 	int              m      = d.n;
 	int              mbcdnd = -1;
-	if (d.isNeumann(Side::east) && d.isNeumann(Side::west)) {
+	if (d.isNeumann(Side<2>::east) && d.isNeumann(Side<2>::west)) {
 		mbcdnd = 3;
-	} else if (d.isNeumann(Side::west)) {
+	} else if (d.isNeumann(Side<2>::west)) {
 		mbcdnd = 4;
-	} else if (d.isNeumann(Side::east)) {
+	} else if (d.isNeumann(Side<2>::east)) {
 		mbcdnd = 2;
 	} else {
 		mbcdnd = 1;
@@ -53,15 +93,15 @@ void FishpackPatchSolver::solve(Domain &d, const Vec f, Vec u, const Vec gamma)
 	const double *bda = &zeros[0];
 	const double *bdb = &zeros[0];
 
-	double c      = d.y_start;
-	double d2     = d.y_start + d.y_length;
+	double c      = d.domain.starts[1];
+	double d2     = d.domain.starts[1] + d.domain.lengths[1];
 	int    n      = d.n;
 	int    nbcdnd = -1;
-	if (d.isNeumann(Side::south) && d.isNeumann(Side::north)) {
+	if (d.isNeumann(Side<2>::south) && d.isNeumann(Side<2>::north)) {
 		nbcdnd = 3;
-	} else if (d.isNeumann(Side::south)) {
+	} else if (d.isNeumann(Side<2>::south)) {
 		nbcdnd = 4;
-	} else if (d.isNeumann(Side::north)) {
+	} else if (d.isNeumann(Side<2>::north)) {
 		nbcdnd = 2;
 	} else {
 		nbcdnd = 1;
@@ -69,7 +109,7 @@ void FishpackPatchSolver::solve(Domain &d, const Vec f, Vec u, const Vec gamma)
 	const double *bdc = &zeros[0];
 	const double *bdd = &zeros[0];
 
-	int     start  = d.id_local * d.n * d.n;
+	int     start  = d.local_index * d.n * d.n;
 	double  elmbda = lambda;
 	double *f_ptr  = &u_view[start];
 	for (int i = 0; i < m * n; i++) {
@@ -81,26 +121,26 @@ void FishpackPatchSolver::solve(Domain &d, const Vec f, Vec u, const Vec gamma)
 		}
 	}
 	int idimf = n;
-	if (d.hasNbr(Side::north)) {
-		int idx = n * d.index(Side::north);
+	if (d.hasNbr(Side<2>::north)) {
+		int idx = n * d.getIfaceLocalIndex(Side<2>::north);
 		for (int i = 0; i < n; i++) {
 			f_ptr[n * (n - 1) + i] -= 2 / (h_y * h_y) * gamma_view[idx + i];
 		}
 	}
-	if (d.hasNbr(Side::east)) {
-		int idx = n * d.index(Side::east);
+	if (d.hasNbr(Side<2>::east)) {
+		int idx = n * d.getIfaceLocalIndex(Side<2>::east);
 		for (int i = 0; i < n; i++) {
 			f_ptr[i * n + (n - 1)] -= 2 / (h_x * h_x) * gamma_view[idx + i];
 		}
 	}
-	if (d.hasNbr(Side::south)) {
-		int idx = n * d.index(Side::south);
+	if (d.hasNbr(Side<2>::south)) {
+		int idx = n * d.getIfaceLocalIndex(Side<2>::south);
 		for (int i = 0; i < n; i++) {
 			f_ptr[i] -= 2 / (h_y * h_y) * gamma_view[idx + i];
 		}
 	}
-	if (d.hasNbr(Side::west)) {
-		int idx = n * d.index(Side::west);
+	if (d.hasNbr(Side<2>::west)) {
+		int idx = n * d.getIfaceLocalIndex(Side<2>::west);
 		for (int i = 0; i < n; i++) {
 			f_ptr[n * i] -= 2 / (h_x * h_x) * gamma_view[idx + i];
 		}
@@ -114,7 +154,4 @@ void FishpackPatchSolver::solve(Domain &d, const Vec f, Vec u, const Vec gamma)
 	if (ierror != 0) {
 		cerr << "Fishpack IERROR: " << ierror << endl;
 	}
-	VecRestoreArray(gamma, &gamma_view);
-	VecRestoreArray(f, &f_view);
-	VecRestoreArray(u, &u_view);
 }
@@ -25,17 +25,16 @@
 class FishpackPatchSolver : public PatchSolver<2>
 {
 	double lambda = 0;
+	void   solve(SchurDomain<2> &d, const double *f_view, double *u_view, const double *gamma_view);
 
 	public:
 	FishpackPatchSolver(double lambda = 0) { this->lambda = lambda; }
 	~FishpackPatchSolver() {}
 	void addDomain(SchurDomain<2> &d) {}
-	void domainSolve(std::deque<SchurDomain<2>> &domains, const Vec f, Vec u, const Vec gamma)
-	{
-		for (SchurDomain<2> &d : domains) {
-			solve(d, f, u, gamma);
-		}
-	}
+	void domainSolve(std::deque<SchurDomain<2>> &domains, const Vec f, Vec u, const Vec gamma);
+	using PatchSolver<2>::domainSolveFused;
+	void domainSolveFused(DomainList &domains, const Vec f, Vec u, const Vec gamma,
+	                      const PatchCallback &solved);
 	void solve(SchurDomain<2> &d, const Vec f, Vec u, const Vec gamma);
 };
 #endif
@@ -21,15 +21,266 @@
 
 #ifndef PATCHSOLVER_H
 #define PATCHSOLVER_H
+#include "PW.h"
 #include "SchurDomain.h"
+#include "Utils.h"
+#include <cmath>
+#include <functional>
+#include <petscmat.h>
 #include <petscvec.h>
+#include <vector>
+/**
+ * @brief Subtract the interface values of a patch from its rhs, the interface values on each side
+ * are scaled by -2/h^2 and added to the cells next to the side
+ *
+ * @tparam N the patch size if it is known at compile time, otherwise 0
+ * @param d the patch
+ * @param n the number of cells in each direction
+ * @param patch the rhs of the patch
+ * @param gamma_view the local interface values
+ */
+template <size_t D, int N = 0>
+inline void addGammaCorrection(SchurDomain<D> &d, int n, double *patch, const double *gamma_view)
+{
+	n             = Utils::patchSize<N>(n);
+	int face_size = 1;
+	for (size_t i = 0; i < D - 1; i++) {
+		face_size *= n;
+	}
+	for (Side<D> s : Side<D>::getValues()) {
+		if (d.hasNbr(s)) {
+			const double *gamma = gamma_view + face_size * d.getIfaceLocalIndex(s);
+			double        h     = d.domain.lengths[s.toInt() / 2] / n;
+			Utils::addToFace<D, N>(patch, n, s, -2.0 / (h * h), gamma);
+		}
+	}
+}
+/**
+ * @brief addGammaCorrection as a kernel for Utils::getKernel
+ */
+template <size_t D> struct GammaCorrection {
+	template <int N> struct Kernel {
+		typedef void (*Function)(SchurDomain<D> &, int, double *, const double *);
+		static void run(SchurDomain<D> &d, int n, double *patch, const double *gamma_view)
+		{
+			addGammaCorrection<D, N>(d, n, patch, gamma_view);
+		}
+	};
+};
 template <size_t D>
 class PatchSolver
 {
 	public:
+	/**
+	 * @brief Pointers to the domains that are solved together, such as a subset of the domains of
+	 * a SchurHelper
+	 */
+	typedef std::vector<SchurDomain<D> *> DomainList;
+	/**
+	 * @brief Get pointers to all of the domains, in the same order
+	 */
+	static DomainList getDomainList(std::deque<SchurDomain<D>> &domains)
+	{
+		DomainList list;
+		list.reserve(domains.size());
+		for (SchurDomain<D> &d : domains) {
+			list.push_back(&d);
+		}
+		return list;
+	}
+
+	private:
+	/**
+	 * @brief The zero rhs that the default domainTraceSolve solves with, kept between calls so
+	 * that it is only allocated once
+	 */
+	PW<Vec> zero_f;
+
+	protected:
+	/**
+	 * @brief Find the patches that have a zero solution, because the rhs and the interface values
+	 * that they are solved with are all zero
+	 *
+	 * The zero_patch flag of each domain is set, and u is zeroed on the zero patches.
+	 *
+	 * @param domains the domains
+	 * @param f_view the rhs vector, nullptr for a zero rhs
+	 * @param u_view the solution vector
+	 * @param gamma_view the interface values
+	 * @return the patches that have to be solved, in the same order as domains
+	 */
+	static DomainList getNonzeroPatches(const DomainList &domains, const double *f_view,
+	                                    double *u_view, const double *gamma_view)
+	{
+		DomainList nonzero;
+		nonzero.reserve(domains.size());
+		for (SchurDomain<D> *ptr : domains) {
+			SchurDomain<D> &d          = *ptr;
+			int             patch_size = std::pow(d.n, D);
+			int             face_size  = std::pow(d.n, D - 1);
+			bool            zero       = true;
+			if (f_view != nullptr) {
+				const double *f = f_view + d.local_index * patch_size;
+				for (int i = 0; i < patch_size && zero; i++) {
+					zero = f[i] == 0;
+				}
+			}
+			for (Side<D> s : Side<D>::getValues()) {
+				if (!zero || !d.hasNbr(s)) { continue; }
+				const double *gamma = gamma_view + d.getIfaceLocalIndex(s) * face_size;
+				for (int i = 0; i < face_size && zero; i++) {
+					zero = gamma[i] == 0;
+				}
+			}
+			d.domain.zero_patch = zero;
+			if (zero) {
+				double *u = u_view + d.local_index * patch_size;
+				for (int i = 0; i < patch_size; i++) {
+					u[i] = 0;
+				}
+			} else {
+				nonzero.push_back(&d);
+			}
+		}
+		return nonzero;
+	}
+
+	public:
+	/**
+	 * @brief Called with a domain and the array of u after the domain has been solved
+	 */
+	typedef std::function<void(SchurDomain<D> &, const double *)> PatchCallback;
 	virtual ~PatchSolver() {}
 	virtual void addDomain(SchurDomain<D> &d) = 0;
 	virtual void domainSolve(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u, const Vec gamma)
 	= 0;
+	/**
+	 * @brief Solve the patches, and call a function on each patch right after it is solved
+	 *
+	 * This lets the caller use a patch, for example to interpolate it to its interfaces, while
+	 * the patch is still in cache. The function can be called from several threads at once, and
+	 * the patches are not passed to it in any particular order. Patches that the solver marked as
+	 * zero patches are zero in u, and are not passed to the function. This calls the DomainList
+	 * version on all of the domains.
+	 *
+	 * @param domains the domains on this processor
+	 * @param f the rhs vector
+	 * @param u the solution vector
+	 * @param gamma the interface values
+	 * @param solved the function to call on each solved patch, if it is set
+	 */
+	virtual void domainSolveFused(std::deque<SchurDomain<D>> &domains, const Vec f, Vec u,
+	                              const Vec gamma, const PatchCallback &solved)
+	{
+		DomainList list = getDomainList(domains);
+		domainSolveFused(list, f, u, gamma, solved);
+	}
+	/**
+	 * @brief domainSolveFused on a list of domains
+	 *
+	 * The in-tree solvers override this, and their domainSolve calls it. For a solver that only
+	 * implements domainSolve, copies of the domains are solved with domainSolve, their zero_patch
+	 * flags are copied back, and then the function is called on every nonzero patch.
+	 */
+	virtual void domainSolveFused(DomainList &domains, const Vec f, Vec u, const Vec gamma,
+	                              const PatchCallback &solved)
+	{
+		std::deque<SchurDomain<D>> copies;
+		for (SchurDomain<D> *d : domains) {
+			copies.push_back(*d);
+		}
+		domainSolve(copies, f, u, gamma);
+		for (size_t i = 0; i < domains.size(); i++) {
+			domains[i]->domain.zero_patch = copies[i].domain.zero_patch;
+		}
+		if (!solved) { return; }
+		const double *u_view;
+		VecGetArrayRead(u, &u_view);
+		for (SchurDomain<D> *d : domains) {
+			if (!d->domain.zero_patch) { solved(*d, u_view); }
+		}
+		VecRestoreArrayRead(u, &u_view);
+	}
+	/**
+	 * @brief Solve the patches for several right hand sides at once
+	 *
+	 * The right hand sides are the columns of dense matrices. Each column of f and u has the
+	 * layout of a domain vector, and each column of gamma has the layout of the local interface
+	 * vector that is passed to domainSolve. This calls domainSolve once for each column, solvers
+	 * that can apply a patch's plans to all of the columns in one pass override it.
+	 *
+	 * @param domains the domains on this processor
+	 * @param f the right hand sides, one per column
+	 * @param u the solutions, one per column
+	 * @param gamma the interface values, one per column
+	 */
+	virtual void domainSolveMulti(std::deque<SchurDomain<D>> &domains, const Mat f, Mat u,
+	                              const Mat gamma)
+	{
+		PetscInt num_rhs, domain_size, gamma_size, f_lda, u_lda, gamma_lda;
+		MatGetSize(f, nullptr, &num_rhs);
+		MatGetLocalSize(f, &domain_size, nullptr);
+		MatGetLocalSize(gamma, &gamma_size, nullptr);
+		MatDenseGetLDA(f, &f_lda);
+		MatDenseGetLDA(u, &u_lda);
+		MatDenseGetLDA(gamma, &gamma_lda);
+
+		// the columns are wrapped in vectors without copying
+		PW<Vec> f_col, u_col, gamma_col;
+		VecCreateSeqWithArray(PETSC_COMM_SELF, 1, domain_size, nullptr, &f_col);
+		VecCreateSeqWithArray(PETSC_COMM_SELF, 1, domain_size, nullptr, &u_col);
+		VecCreateSeqWithArray(PETSC_COMM_SELF, 1, gamma_size, nullptr, &gamma_col);
+
+		double *f_view, *u_view, *gamma_view;
+		MatDenseGetArray(f, &f_view);
+		MatDenseGetArray(u, &u_view);
+		MatDenseGetArray(gamma, &gamma_view);
+		for (int j = 0; j < num_rhs; j++) {
+			VecPlaceArray(f_col, f_view + j * f_lda);
+			VecPlaceArray(u_col, u_view + j * u_lda);
+			VecPlaceArray(gamma_col, gamma_view + j * gamma_lda);
+			domainSolve(domains, f_col, u_col, gamma_col);
+			VecResetArray(f_col);
+			VecResetArray(u_col);
+			VecResetArray(gamma_col);
+		}
+		MatDenseRestoreArray(f, &f_view);
+		MatDenseRestoreArray(u, &u_view);
+		MatDenseRestoreArray(gamma, &gamma_view);
+	}
+	/**
+	 * @brief Solve the patches with a zero right hand side, where only the cells next to the
+	 * sides of each patch need to be set in u
+	 *
+	 * Those cells are all that the interpolators read, so this is enough to apply the Schur
+	 * complement matrix. This calls the DomainList version on all of the domains.
+	 *
+	 * @param domains the domains on this processor
+	 * @param u the solution, only the cells next to the sides with neighbors have to be set
+	 * @param gamma the interface values
+	 */
+	virtual void domainTraceSolve(std::deque<SchurDomain<D>> &domains, Vec u, const Vec gamma)
+	{
+		DomainList list = getDomainList(domains);
+		domainTraceSolve(list, u, gamma);
+	}
+	/**
+	 * @brief domainTraceSolve on a list of domains
+	 *
+	 * This does a full solve with domainSolveFused and a zero right hand side, solvers that can
+	 * get the values next to the sides without solving the whole patch override it.
+	 */
+	virtual void domainTraceSolve(DomainList &domains, Vec u, const Vec gamma)
+	{
+		PetscInt u_size = 0, f_size = -1;
+		VecGetLocalSize(u, &u_size);
+		if ((Vec) zero_f != nullptr) { VecGetLocalSize(zero_f, &f_size); }
+		if (f_size != u_size) {
+			zero_f = PW<Vec>();
+			VecDuplicate(u, &zero_f);
+			VecSet(zero_f, 0);
+		}
+		domainSolveFused(domains, zero_f, u, gamma, nullptr);
+	}
 };
 #endif
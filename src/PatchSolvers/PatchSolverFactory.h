@@ -0,0 +1,271 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef PATCHSOLVERFACTORY_H
+#define PATCHSOLVERFACTORY_H
+#include "DomainCollection.h"
+#include "PatchSolvers/DftPatchSolver.h"
+#include "PatchSolvers/FacrPatchSolver.h"
+#include "PatchSolvers/FftwPatchSolver.h"
+#include "PatchSolvers/FftwWisdom.h"
+#include "IdIndex.h"
+#include "PatchSolvers/PatchSolver.h"
+#include "SchurDomain.h"
+#include "Timer.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mpi.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+/**
+ * @brief Creates the fastest patch solver for a DomainCollection.
+ *
+ * Each available solver is timed on the patches of the DomainCollection, and the fastest one is
+ * used. The decision can be cached in a file, keyed by n, D, and the host name of rank 0, so that
+ * the solvers only have to be timed once on each machine.
+ */
+template <size_t D> class PatchSolverFactory
+{
+	private:
+	std::string                 cache_file;
+	Tools::Timer *              timer = nullptr;
+	std::shared_ptr<FftwWisdom> wisdom;
+	int                         reps = 3;
+	std::string                 choice;
+
+	std::string getKey(int n);
+	bool        readCache(const std::string &key);
+	void        writeCache(const std::string &key);
+	double      time(std::shared_ptr<PatchSolver<D>> solver, DomainCollection<D> &dc,
+	                 std::deque<SchurDomain<D>> &domains);
+
+	public:
+	/**
+	 * @brief Create a new PatchSolverFactory
+	 *
+	 * @param cache_file the file to cache decisions in, no cache is used if empty
+	 * @param timer if set, the timing is recorded in it, and the choice is added as a note
+	 */
+	PatchSolverFactory(std::string cache_file = "", Tools::Timer *timer = nullptr)
+	{
+		this->cache_file = cache_file;
+		this->timer      = timer;
+	}
+	/**
+	 * @brief Set the wisdom that is passed to the FftwPatchSolver
+	 */
+	void setWisdom(std::shared_ptr<FftwWisdom> wisdom)
+	{
+		this->wisdom = wisdom;
+	}
+	/**
+	 * @brief Set the number of timed solves for each solver
+	 */
+	void setReps(int reps)
+	{
+		this->reps = reps;
+	}
+	/**
+	 * @brief Get the names of the solvers that are timed
+	 */
+	static std::vector<std::string> getSolverNames()
+	{
+		return {"fftw", "dft", "facr"};
+	}
+	/**
+	 * @brief Create a solver by name
+	 *
+	 * @param name the name of the solver, one of getSolverNames()
+	 * @param dc the DomainCollection
+	 * @param lambda the lambda value of the Helmholtz equation
+	 * @param wisdom the wisdom for the FftwPatchSolver and FacrPatchSolver
+	 */
+	static std::shared_ptr<PatchSolver<D>>
+	makeSolver(const std::string &name, DomainCollection<D> &dc, double lambda = 0,
+	           std::shared_ptr<FftwWisdom> wisdom = nullptr)
+	{
+		std::shared_ptr<PatchSolver<D>> solver;
+		if (name == "dft") {
+			solver.reset(new DftPatchSolver<D>(dc, lambda));
+		} else if (name == "facr") {
+			solver.reset(new FacrPatchSolver<D>(dc, lambda, wisdom));
+		} else {
+			solver.reset(new FftwPatchSolver<D>(dc, lambda, wisdom));
+		}
+		return solver;
+	}
+	/**
+	 * @brief Get the fastest solver for a DomainCollection. This is collective.
+	 *
+	 * @param dc the DomainCollection
+	 * @param lambda the lambda value of the Helmholtz equation
+	 */
+	std::shared_ptr<PatchSolver<D>> getSolver(DomainCollection<D> &dc, double lambda = 0);
+	/**
+	 * @brief Get the name of the solver that was picked by the last call to getSolver
+	 */
+	std::string getChoice() const
+	{
+		return choice;
+	}
+};
+template <size_t D> inline std::string PatchSolverFactory<D>::getKey(int n)
+{
+	// the decision has to be the same on every rank, so rank 0's host name is used
+	char host[256] = "";
+	gethostname(host, sizeof(host) - 1);
+	int size = std::string(host).size();
+	MPI_Bcast(&size, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(host, size, MPI_CHAR, 0, MPI_COMM_WORLD);
+	host[size] = '\0';
+
+	std::stringstream ss;
+	ss << host << " " << n << " " << D;
+	return ss.str();
+}
+template <size_t D> inline bool PatchSolverFactory<D>::readCache(const std::string &key)
+{
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	// each line of the cache is "<host> <n> <D> <solver>"
+	std::string cached;
+	if (rank == 0) {
+		std::ifstream file(cache_file);
+		std::string   line;
+		while (std::getline(file, line)) {
+			size_t pos = line.rfind(' ');
+			if (pos != std::string::npos && line.substr(0, pos) == key) {
+				cached = line.substr(pos + 1);
+			}
+		}
+	}
+	int size = cached.size();
+	MPI_Bcast(&size, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if (size == 0) { return false; }
+	cached.resize(size);
+	MPI_Bcast(&cached[0], size, MPI_CHAR, 0, MPI_COMM_WORLD);
+	choice = cached;
+	return true;
+}
+template <size_t D> inline void PatchSolverFactory<D>::writeCache(const std::string &key)
+{
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	if (rank == 0) {
+		std::ofstream file(cache_file, std::ios::app);
+		file << key << " " << choice << std::endl;
+	}
+}
+template <size_t D>
+inline double PatchSolverFactory<D>::time(std::shared_ptr<PatchSolver<D>> solver,
+                                          DomainCollection<D> &            dc,
+                                          std::deque<SchurDomain<D>> &     domains)
+{
+	for (SchurDomain<D> &sd : domains) {
+		solver->addDomain(sd);
+	}
+	// every interface has a local index, so a local vector is enough for gamma
+	int     num_ifaces = 0;
+	PW<Vec> f          = dc.getNewDomainVec();
+	PW<Vec> u          = dc.getNewDomainVec();
+	PW<Vec> gamma;
+	{
+		IdIndex rev_map(domains.size() * Side<D>::num_sides);
+		for (SchurDomain<D> &sd : domains) {
+			for (int id : sd.getIds()) {
+				if (rev_map.count(id) == 0) { rev_map[id] = num_ifaces++; }
+			}
+		}
+		for (SchurDomain<D> &sd : domains) {
+			sd.setLocalIndexes(rev_map);
+		}
+	}
+	int face_size = (int) std::pow(dc.getN(), D - 1);
+	VecCreateSeq(PETSC_COMM_SELF, num_ifaces * face_size, &gamma);
+	VecSet(f, 1.0);
+	VecSet(gamma, 1.0);
+
+	// warm up
+	solver->domainSolve(domains, f, u, gamma);
+	double start = MPI_Wtime();
+	for (int i = 0; i < reps; i++) {
+		solver->domainSolve(domains, f, u, gamma);
+	}
+	double local_time = (MPI_Wtime() - start) / reps;
+
+	// the slowest rank decides
+	double time;
+	MPI_Allreduce(&local_time, &time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	return time;
+}
+template <size_t D>
+inline std::shared_ptr<PatchSolver<D>> PatchSolverFactory<D>::getSolver(DomainCollection<D> &dc,
+                                                                         double lambda)
+{
+	std::string key = getKey(dc.getN());
+	if (cache_file != "" && readCache(key)) {
+		std::vector<std::string> names = getSolverNames();
+		if (std::find(names.begin(), names.end(), choice) != names.end()) {
+			if (timer != nullptr) { timer->addNote("Patch Solver", choice + " (cached)"); }
+			return makeSolver(choice, dc, lambda, wisdom);
+		}
+		int rank;
+		MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+		if (rank == 0) {
+			std::cerr << "PatchSolverFactory: unknown solver \"" << choice << "\" in "
+			          << cache_file << ", autotuning again" << std::endl;
+		}
+	}
+
+	if (timer != nullptr) { timer->start("Patch Solver Autotune"); }
+	// the patch solves are timed on their own, so no interfaces are enumerated or exchanged
+	std::deque<SchurDomain<D>> domains;
+	for (auto &p : dc.domains) {
+		domains.push_back(*p.second);
+	}
+	std::shared_ptr<PatchSolver<D>> best;
+	double                          best_time = 0;
+	for (const std::string &name : getSolverNames()) {
+		std::shared_ptr<PatchSolver<D>> solver = makeSolver(name, dc, lambda, wisdom);
+		double                          t      = time(solver, dc, domains);
+		if (best == nullptr || t < best_time) {
+			best      = solver;
+			best_time = t;
+			choice    = name;
+		}
+	}
+	if (timer != nullptr) {
+		timer->stop("Patch Solver Autotune");
+		timer->addNote("Patch Solver", choice + " (autotuned)");
+	}
+
+	if (cache_file != "") { writeCache(key); }
+	// the timed solver already has its plans for these patches
+	return best;
+}
+#endif
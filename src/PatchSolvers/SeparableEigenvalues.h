@@ -0,0 +1,103 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef SEPARABLEEIGENVALUES_H
+#define SEPARABLEEIGENVALUES_H
+#include "SchurDomain.h"
+#include <array>
+#include <cmath>
+#include <valarray>
+/**
+ * @brief The eigenvalues of the patch operator, stored as one vector for each axis.
+ *
+ * The eigenvalue of mode (x_0, ..., x_{D-1}) is lambda + axis[0][x_0] + ... + axis[D-1][x_{D-1}],
+ * so only D*n values are kept instead of n^D, and the denominator is formed while dividing.
+ */
+template <size_t D> struct SeparableEigenvalues {
+	/**
+	 * @brief The eigenvalues for each axis, lambda is folded into axis[0]
+	 */
+	std::array<std::valarray<double>, D> axis;
+
+	SeparableEigenvalues() = default;
+	/**
+	 * @brief Calculate the eigenvalues for a domain
+	 *
+	 * @param d the domain
+	 * @param n the number of cells in each direction
+	 * @param lambda the lambda value of the Helmholtz equation
+	 */
+	SeparableEigenvalues(SchurDomain<D> &d, int n, double lambda)
+	{
+		for (size_t i = 0; i < D; i++) {
+			axis[i].resize(n);
+			double h     = d.domain.lengths[i] / n;
+			double shift = 1;
+			if (d.isNeumann(i * 2) && d.isNeumann(i * 2 + 1)) {
+				shift = 0;
+			} else if (d.isNeumann(i * 2) || d.isNeumann(i * 2 + 1)) {
+				shift = 0.5;
+			}
+			for (int xi = 0; xi < n; xi++) {
+				axis[i][xi] = -4 / (h * h) * std::pow(std::sin((xi + shift) * M_PI / (2 * n)), 2);
+			}
+		}
+		axis[0] += lambda;
+	}
+	/**
+	 * @brief Divide a patch in transform space by the eigenvalues, and multiply by scale
+	 *
+	 * @param patch the patch, with x varying fastest, in single or double precision
+	 * @param scale the normalization of the transforms
+	 * @param row_op called as row_op(o, row) on each x row of the patch before it is divided,
+	 * where o is the index of the row
+	 */
+	template <typename T, typename RowOp> void divide(T *patch, double scale, RowOp row_op) const
+	{
+		int           n     = axis[0].size();
+		int           outer = std::pow(n, D - 1);
+		const double *eig_x = &axis[0][0];
+		for (int o = 0; o < outer; o++) {
+			double partial = 0;
+			int    rem     = o;
+			for (size_t a = 1; a < D; a++) {
+				partial += axis[a][rem % n];
+				rem /= n;
+			}
+			T *row = patch + o * n;
+			row_op(o, row);
+			for (int x = 0; x < n; x++) {
+				row[x] = row[x] * scale / (partial + eig_x[x]);
+			}
+		}
+	}
+	/**
+	 * @brief Divide a patch in transform space by the eigenvalues, and multiply by scale
+	 *
+	 * @param patch the patch, with x varying fastest, in single or double precision
+	 * @param scale the normalization of the transforms
+	 */
+	template <typename T> void divide(T *patch, double scale) const
+	{
+		divide(patch, scale, [](int, T *) {});
+	}
+};
+#endif
@@ -0,0 +1,275 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef PATCHTABLE_H
+#define PATCHTABLE_H
+#include "IdIndex.h"
+#include "IfaceType.h"
+#include "SchurDomain.h"
+#include "Side.h"
+#include <bitset>
+#include <deque>
+#include <vector>
+/**
+ * @brief The patch information that the apply and interpolate loops use, in flat arrays
+ *
+ * The SchurDomain objects, with their Domain copies and IfaceInfo pointers, are only needed while
+ * setting up. Patch i of the table is the i-th domain that was added to it.
+ *
+ * The patches are greedily colored as they are added, so that the patches of one color can add
+ * to the interface values without any two of them writing to the same value.
+ */
+template <size_t D> class PatchTable
+{
+	public:
+	/**
+	 * @brief Where the patch and the interface values of one interp entry are, so that an
+	 * interpolator can read the side with a Utils::FaceView
+	 */
+	struct FacePlan {
+		/**
+		 * @brief The index in u of the first cell of the patch
+		 */
+		int patch_start;
+		/**
+		 * @brief The index in interp of the first interface value
+		 */
+		int interp_start;
+		/**
+		 * @brief The side of the patch that is read
+		 */
+		Side<D> side;
+	};
+
+	private:
+	int                                          n = 0;
+	std::vector<int>                             local_indexes;
+	std::vector<double>                          spacings;
+	std::vector<std::bitset<Side<D>::num_sides>> neumanns;
+	/**
+	 * @brief The local index of the interface on each side of each patch, -1 if there is no
+	 * neighbor on that side
+	 */
+	std::vector<int> iface_local_indexes;
+	/**
+	 * @brief The interface values that each patch is interpolated to. The entries for patch i
+	 * are interp_offsets[i] to interp_offsets[i+1].
+	 */
+	std::vector<int>       interp_offsets = {0};
+	std::vector<Side<D>>   interp_sides;
+	std::vector<int>       interp_local_indexes;
+	std::vector<IfaceType> interp_types;
+	std::vector<FacePlan>  interp_plans;
+	/**
+	 * @brief The patch of each local index
+	 */
+	IdIndex patch_indexes;
+	/**
+	 * @brief Whether each patch is known to be zero in u
+	 */
+	std::vector<bool> zero_patches;
+	/**
+	 * @brief The patches of each color, patches with the same color are not interpolated to any
+	 * of the same interface values
+	 */
+	std::vector<std::vector<int>> color_patches;
+	/**
+	 * @brief The colors of the patches that are interpolated to each local interface value
+	 */
+	std::vector<std::vector<int>> iface_colors;
+
+	/**
+	 * @brief Give the last patch the lowest color that none of the patches it shares an interface
+	 * value with has
+	 */
+	void colorLastPatch()
+	{
+		int               patch = local_indexes.size() - 1;
+		std::vector<bool> used(color_patches.size() + 1, false);
+		for (int i = interpBegin(patch); i < interpEnd(patch); i++) {
+			int local_index = interp_local_indexes[i];
+			if (local_index >= (int) iface_colors.size()) { iface_colors.resize(local_index + 1); }
+			for (int color : iface_colors[local_index]) {
+				used[color] = true;
+			}
+		}
+		int color = 0;
+		while (used[color]) {
+			color++;
+		}
+		if (color == (int) color_patches.size()) { color_patches.emplace_back(); }
+		color_patches[color].push_back(patch);
+		for (int i = interpBegin(patch); i < interpEnd(patch); i++) {
+			std::vector<int> &colors = iface_colors[interp_local_indexes[i]];
+			if (colors.empty() || colors.back() != color) { colors.push_back(color); }
+		}
+	}
+
+	public:
+	PatchTable() = default;
+	/**
+	 * @brief Create a table for a set of domains
+	 */
+	explicit PatchTable(std::deque<SchurDomain<D>> &domains)
+	{
+		for (SchurDomain<D> &sd : domains) {
+			addDomain(sd);
+		}
+	}
+	/**
+	 * @brief Add a domain to the end of the table
+	 */
+	void addDomain(SchurDomain<D> &sd)
+	{
+		n                             = sd.n;
+		patch_indexes[sd.local_index] = local_indexes.size();
+		local_indexes.push_back(sd.local_index);
+		zero_patches.push_back(false);
+		for (size_t axis = 0; axis < D; axis++) {
+			spacings.push_back(sd.domain.lengths[axis] / sd.n);
+		}
+		neumanns.push_back(sd.neumann);
+		for (Side<D> s : Side<D>::getValues()) {
+			if (sd.hasNbr(s)) {
+				iface_local_indexes.push_back(sd.getIfaceLocalIndex(s));
+				std::deque<int>       idx;
+				std::deque<IfaceType> types;
+				sd.getIfaceInfoPtr(s)->getIdxAndTypes(idx, types);
+				for (size_t i = 0; i < idx.size(); i++) {
+					interp_sides.push_back(s);
+					interp_local_indexes.push_back(idx[i]);
+					interp_types.push_back(types[i]);
+					interp_plans.push_back(getFacePlan(local_indexes.size() - 1, s, idx[i]));
+				}
+			} else {
+				iface_local_indexes.push_back(-1);
+			}
+		}
+		interp_offsets.push_back(interp_sides.size());
+		colorLastPatch();
+	}
+	int size() const
+	{
+		return local_indexes.size();
+	}
+	int getN() const
+	{
+		return n;
+	}
+	int getLocalIndex(int patch) const
+	{
+		return local_indexes[patch];
+	}
+	/**
+	 * @brief Get the patch that has a given local index
+	 */
+	int getPatch(int local_index) const
+	{
+		return patch_indexes.at(local_index);
+	}
+	double getSpacing(int patch, int axis) const
+	{
+		return spacings[patch * D + axis];
+	}
+	const std::bitset<Side<D>::num_sides> &getNeumann(int patch) const
+	{
+		return neumanns[patch];
+	}
+	bool isNeumann(int patch, Side<D> s) const
+	{
+		return neumanns[patch][s.toInt()];
+	}
+	bool hasNbr(int patch, Side<D> s) const
+	{
+		return iface_local_indexes[patch * Side<D>::num_sides + s.toInt()] != -1;
+	}
+	int getIfaceLocalIndex(int patch, Side<D> s) const
+	{
+		return iface_local_indexes[patch * Side<D>::num_sides + s.toInt()];
+	}
+	int interpBegin(int patch) const
+	{
+		return interp_offsets[patch];
+	}
+	int interpEnd(int patch) const
+	{
+		return interp_offsets[patch + 1];
+	}
+	Side<D> getInterpSide(int entry) const
+	{
+		return interp_sides[entry];
+	}
+	int getInterpLocalIndex(int entry) const
+	{
+		return interp_local_indexes[entry];
+	}
+	IfaceType getInterpType(int entry) const
+	{
+		return interp_types[entry];
+	}
+	const FacePlan &getInterpPlan(int entry) const
+	{
+		return interp_plans[entry];
+	}
+	/**
+	 * @brief Get the plan for reading one side of a patch into one interface
+	 *
+	 * @param patch the index of the patch in the table
+	 * @param s the side of the patch
+	 * @param local_index the local index of the interface
+	 */
+	FacePlan getFacePlan(int patch, Side<D> s, int local_index) const
+	{
+		int face_size = 1;
+		for (size_t axis = 0; axis < D - 1; axis++) {
+			face_size *= n;
+		}
+		FacePlan plan;
+		plan.patch_start  = local_indexes[patch] * face_size * n;
+		plan.interp_start = local_index * face_size;
+		plan.side         = s;
+		return plan;
+	}
+	/**
+	 * @brief Set whether a patch is known to be zero in u, the interpolate loop skips the patches
+	 * that are
+	 */
+	void setZero(int patch, bool zero)
+	{
+		zero_patches[patch] = zero;
+	}
+	bool isZero(int patch) const
+	{
+		return zero_patches[patch];
+	}
+	int getNumColors() const
+	{
+		return color_patches.size();
+	}
+	/**
+	 * @brief Get the patches of a color, which can be interpolated concurrently
+	 */
+	const std::vector<int> &getColorPatches(int color) const
+	{
+		return color_patches[color];
+	}
+};
+#endif
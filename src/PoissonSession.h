@@ -0,0 +1,459 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef POISSONSESSION_H
+#define POISSONSESSION_H
+#include "BalancedLevelsGenerator.h"
+#include "DomainCollection.h"
+#include "FunctionWrapper.h"
+#include "GMG/Helper.h"
+#include "GMG/Helper2d.h"
+#include "OctTree.h"
+#include "PW.h"
+#include "PatchSolvers/PatchSolverFactory.h"
+#include "SchurHelper.h"
+#include "SchurMatrixHelper.h"
+#include "SchurMatrixHelper2d.h"
+#include "Timer.h"
+#include <deque>
+#include <memory>
+#include <petscksp.h>
+#include <string>
+#include <vector>
+/**
+ * @brief The Schur matrix and GMG classes for each dimension
+ */
+template <size_t D> struct PoissonSessionTypes;
+template <> struct PoissonSessionTypes<2> {
+	typedef SchurMatrixHelper2d MatrixHelper;
+	typedef GMG::Helper2d       GmgHelper;
+};
+template <> struct PoissonSessionTypes<3> {
+	typedef SchurMatrixHelper MatrixHelper;
+	typedef GMG::Helper       GmgHelper;
+};
+/**
+ * @brief Solves the Schur complement system for many right hand sides on a fixed mesh
+ *
+ * The levels, partitioning, domain collections, patch solver plans, SchurHelper, Schur matrix,
+ * and preconditioner are set up once by setup, and then each call to solve only forms the rhs of
+ * the Schur complement system, runs the Krylov solver, and does the final patch solves. The
+ * interface values of the last solve are used as the initial guess of the next one.
+ *
+ * The settings have to be set before setup is called.
+ */
+template <size_t D> class PoissonSession
+{
+	private:
+	Tools::Timer *                    timer = nullptr;
+	std::shared_ptr<PatchOperator<D>> op;
+	std::shared_ptr<Interpolator<D>>  interp;
+
+	std::string                 solver_name = "fftw";
+	std::string                 autotune_cache;
+	std::shared_ptr<FftwWisdom> wisdom;
+	std::string                 gmg_config;
+	bool                        matrix_free = false;
+	bool                        neumann     = false;
+	bool                        reuse_guess = true;
+	double                      tol         = 1e-12;
+	int                         max_its     = 5000;
+
+	std::vector<std::shared_ptr<DomainCollection<D>>>           dcs;
+	std::shared_ptr<PatchSolver<D>>                             solver;
+	std::shared_ptr<SchurHelper<D>>                             sch;
+	std::shared_ptr<typename PoissonSessionTypes<D>::GmgHelper> gmg;
+
+	PW<Mat> A;
+	PW<KSP> ksp;
+	PW<Vec> gamma;
+	PW<Vec> zero_gamma;
+	PW<Vec> b;
+	PW<Vec> diff;
+	int     iterations = 0;
+
+	/**
+	 * @brief The recycled space. The columns of recycle_c are orthonormal, and
+	 * recycle_c[i] = A * recycle_u[i].
+	 */
+	int                 recycle_size = 0;
+	std::deque<PW<Vec>> recycle_u;
+	std::deque<PW<Vec>> recycle_c;
+	/**
+	 * @brief A with the recycled space projected out of its range, which the Krylov solver
+	 * iterates on when recycling
+	 */
+	PW<Mat> projected;
+	PW<Vec> r;
+	PW<Vec> x;
+	PW<Vec> ax;
+
+	static int projectedMultiply(Mat P, Vec x, Vec y)
+	{
+		PoissonSession *session = nullptr;
+		MatShellGetContext(P, &session);
+		MatMult(session->A, x, y);
+		session->project(y);
+		return 0;
+	}
+	static void         addCombination(Vec y, double scale, const std::vector<double> &alpha,
+	                                   const std::deque<PW<Vec>> &vs);
+	std::vector<double> project(Vec y);
+	void                addRecycled(Vec d, Vec ad);
+	void                solveRecycled();
+
+	void start(const std::string &name)
+	{
+		if (timer != nullptr) { timer->start(name); }
+	}
+	void stop(const std::string &name)
+	{
+		if (timer != nullptr) { timer->stop(name); }
+	}
+
+	public:
+	/**
+	 * @brief Create a new PoissonSession
+	 *
+	 * @param op the patch operator
+	 * @param interp the interface interpolator
+	 * @param timer if set, setup is timed under "Session Setup" and each solve under
+	 * "Session Solve"
+	 */
+	PoissonSession(std::shared_ptr<PatchOperator<D>> op, std::shared_ptr<Interpolator<D>> interp,
+	               Tools::Timer *timer = nullptr)
+	{
+		this->op     = op;
+		this->interp = interp;
+		this->timer  = timer;
+	}
+	/*
+	 * The projected operator is a shell matrix whose context is this session, so a copy or a move
+	 * would leave it pointing at the wrong object.
+	 */
+	PoissonSession(const PoissonSession &) = delete;
+	PoissonSession(PoissonSession &&)      = delete;
+	PoissonSession &operator=(const PoissonSession &) = delete;
+	PoissonSession &operator=(PoissonSession &&) = delete;
+	/**
+	 * @brief Set the patch solver, one of PatchSolverFactory::getSolverNames(), or "autotune" to
+	 * time them and use the fastest (the default is fftw)
+	 *
+	 * @param name the name of the solver
+	 * @param autotune_cache the file that the autotuned choice is cached in, if any
+	 */
+	void setPatchSolver(const std::string &name, const std::string &autotune_cache = "")
+	{
+		solver_name          = name;
+		this->autotune_cache = autotune_cache;
+	}
+	/**
+	 * @brief Set the wisdom that is passed to the fftw based patch solvers, it should already be
+	 * loaded with FftwWisdom::load
+	 */
+	void setWisdom(std::shared_ptr<FftwWisdom> wisdom)
+	{
+		this->wisdom = wisdom;
+	}
+	/**
+	 * @brief Use the GMG preconditioner with a config file, no preconditioner is set up if this
+	 * is not called
+	 */
+	void setGmgConfig(const std::string &config_file)
+	{
+		gmg_config = config_file;
+	}
+	/**
+	 * @brief Set whether the Schur complement matrix is applied with patch solves instead of
+	 * being formed (the default is to form it)
+	 */
+	void setMatrixFree(bool matrix_free)
+	{
+		this->matrix_free = matrix_free;
+	}
+	/**
+	 * @brief Use neumann boundary conditions, the right hand sides then have to integrate to zero
+	 */
+	void setNeumann(bool neumann)
+	{
+		this->neumann = neumann;
+	}
+	/**
+	 * @brief Set the tolerance and the maximum number of iterations of the Krylov solver, these can
+	 * also be set with the petsc options when the Krylov space is not recycled
+	 */
+	void setTolerance(double tol, int max_its = 5000)
+	{
+		this->tol     = tol;
+		this->max_its = max_its;
+	}
+	/**
+	 * @brief Set whether the interface values of the last solve are the initial guess of the next
+	 * one (the default is true)
+	 */
+	void setReuseGuess(bool reuse_guess)
+	{
+		this->reuse_guess = reuse_guess;
+	}
+	/**
+	 * @brief Recycle a Krylov subspace between solves (the default is 0, no recycling)
+	 *
+	 * The corrections of the last k solves are kept, along with their images under the Schur
+	 * complement matrix. Each solve starts from the best guess in that space, and the Krylov
+	 * solver iterates on the matrix with that space projected out, as in the outer step of
+	 * GCRO-DR. This costs two extra matrix applies for each solve, and pays off when the right
+	 * hand sides change slowly from solve to solve.
+	 *
+	 * @param k the number of corrections to keep
+	 */
+	void setRecycle(int k)
+	{
+		recycle_size = k;
+	}
+	/**
+	 * @brief Set up everything that does not depend on the right hand side. This is collective.
+	 *
+	 * @param t the mesh
+	 * @param n the number of cells in each direction, in each domain
+	 */
+	void setup(Tree<D> &t, int n);
+	/**
+	 * @brief Solve for a right hand side. This is collective.
+	 *
+	 * @param f the rhs vector, with the layout of getDomainCollection().getNewDomainVec()
+	 * @param u the vector to put the solution in
+	 */
+	void solve(const Vec f, Vec u);
+	/**
+	 * @brief Get the number of Krylov iterations of the last solve
+	 */
+	int getIterations() const
+	{
+		return iterations;
+	}
+	/**
+	 * @brief Get the interface values of the last solve
+	 */
+	Vec getGamma() const
+	{
+		return gamma;
+	}
+	DomainCollection<D> &getDomainCollection()
+	{
+		return *dcs[0];
+	}
+	std::shared_ptr<SchurHelper<D>> getSchurHelper()
+	{
+		return sch;
+	}
+};
+template <size_t D> inline void PoissonSession<D>::setup(Tree<D> &t, int n)
+{
+	using namespace std;
+	start("Session Setup");
+
+	start("Session Domain Setup");
+	BalancedLevelsGenerator<D> blg(t, n);
+	int                        num_procs;
+	MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+	if (num_procs > 1) { blg.zoltanBalance(); }
+	// the coarser levels are only needed by GMG
+	dcs.resize(gmg_config.empty() ? 1 : t.num_levels);
+	for (int i = 0; i < (int) dcs.size(); i++) {
+		dcs[i].reset(new DomainCollection<D>(blg.levels[t.num_levels - 1 - i], n));
+	}
+	if (neumann) { dcs[0]->setNeumann(); }
+	stop("Session Domain Setup");
+
+	start("Session Patch Solver Setup");
+	if (solver_name == "autotune") {
+		PatchSolverFactory<D> factory(autotune_cache, timer);
+		factory.setWisdom(wisdom);
+		solver = factory.getSolver(*dcs[0]);
+	} else {
+		solver = PatchSolverFactory<D>::makeSolver(solver_name, *dcs[0], 0, wisdom);
+	}
+	sch.reset(new SchurHelper<D>(*dcs[0], solver, op, interp));
+	gamma      = sch->getNewSchurVec();
+	zero_gamma = sch->getNewSchurVec();
+	b          = sch->getNewSchurVec();
+	diff       = sch->getNewSchurVec();
+	VecSet(gamma, 0);
+	VecSet(zero_gamma, 0);
+	stop("Session Patch Solver Setup");
+
+	// with a single domain there are no interfaces, and the patch solve is the solution
+	if (dcs[0]->num_global_domains == 1) {
+		stop("Session Setup");
+		return;
+	}
+
+	start("Session Matrix Setup");
+	if (matrix_free) {
+		A = FuncWrap<D>::getMatrix(sch.get(), dcs[0].get());
+	} else {
+		typename PoissonSessionTypes<D>::MatrixHelper mh(sch);
+		A = mh.formCRSMatrix();
+	}
+	stop("Session Matrix Setup");
+
+	start("Session Preconditioner Setup");
+	KSPCreate(MPI_COMM_WORLD, &ksp);
+	if (recycle_size > 0) {
+		// the preconditioner is still built from A
+		PetscInt m, M;
+		MatGetLocalSize(A, &m, nullptr);
+		MatGetSize(A, &M, nullptr);
+		MatCreateShell(MPI_COMM_WORLD, m, m, M, M, this, &projected);
+		MatShellSetOperation(projected, MATOP_MULT, (void (*)(void)) projectedMultiply);
+		VecDuplicate(gamma, &r);
+		VecDuplicate(gamma, &x);
+		VecDuplicate(gamma, &ax);
+		KSPSetOperators(ksp, projected, A);
+		KSPSetInitialGuessNonzero(ksp, PETSC_FALSE);
+	} else {
+		KSPSetOperators(ksp, A, A);
+		KSPSetInitialGuessNonzero(ksp, reuse_guess ? PETSC_TRUE : PETSC_FALSE);
+	}
+	KSPSetTolerances(ksp, tol, PETSC_DEFAULT, PETSC_DEFAULT, max_its);
+	KSPSetFromOptions(ksp);
+	PC pc;
+	KSPGetPC(ksp, &pc);
+	if (!gmg_config.empty()) {
+		gmg.reset(new typename PoissonSessionTypes<D>::GmgHelper(n, dcs, sch, gmg_config));
+		gmg->getPrec(pc);
+	}
+	KSPSetUp(ksp);
+	stop("Session Preconditioner Setup");
+
+	stop("Session Setup");
+}
+template <size_t D> inline void PoissonSession<D>::solve(const Vec f, Vec u)
+{
+	start("Session Solve");
+	if ((KSP) ksp == nullptr) {
+		sch->solveWithInterface(f, u, gamma, diff);
+		stop("Session Solve");
+		return;
+	}
+
+	// the rhs of the Schur complement system is the negated interface values of the solve with
+	// zero interface values
+	sch->solveWithInterface(f, u, zero_gamma, b);
+	VecScale(b, -1.0);
+
+	if (recycle_size > 0) {
+		solveRecycled();
+	} else {
+		KSPSolve(ksp, b, gamma);
+		KSPGetIterationNumber(ksp, &iterations);
+	}
+
+	sch->solveWithInterface(f, u, gamma, diff);
+	stop("Session Solve");
+}
+/**
+ * @brief Add scale * (alpha[0] * vs[0] + alpha[1] * vs[1] + ...) to y
+ */
+template <size_t D>
+inline void PoissonSession<D>::addCombination(Vec y, double scale,
+                                              const std::vector<double> &alpha,
+                                              const std::deque<PW<Vec>> &vs)
+{
+	if (vs.empty()) { return; }
+	std::vector<Vec>    vecs(vs.begin(), vs.end());
+	std::vector<double> coefs(alpha.size());
+	for (size_t i = 0; i < alpha.size(); i++) {
+		coefs[i] = scale * alpha[i];
+	}
+	VecMAXPY(y, vecs.size(), coefs.data(), vecs.data());
+}
+/**
+ * @brief Remove the part of y that is in the span of the recycled space
+ *
+ * @return the coefficients of the part that was removed
+ */
+template <size_t D> inline std::vector<double> PoissonSession<D>::project(Vec y)
+{
+	std::vector<double> alpha(recycle_c.size());
+	if (recycle_c.empty()) { return alpha; }
+	std::vector<Vec> cs(recycle_c.begin(), recycle_c.end());
+	VecMDot(y, cs.size(), cs.data(), alpha.data());
+	addCombination(y, -1.0, alpha, recycle_c);
+	return alpha;
+}
+/**
+ * @brief Add a correction and its image under A to the recycled space, dropping the oldest pair
+ * when the space is full. The vectors are modified.
+ */
+template <size_t D> inline void PoissonSession<D>::addRecycled(Vec d, Vec ad)
+{
+	// ad is already orthogonal to the space, this is a second pass for rounding errors
+	addCombination(d, -1.0, project(ad), recycle_u);
+	double norm;
+	VecNorm(ad, NORM_2, &norm);
+	if (norm == 0) { return; }
+
+	PW<Vec> u, c;
+	VecDuplicate(d, &u);
+	VecDuplicate(ad, &c);
+	VecCopy(d, u);
+	VecCopy(ad, c);
+	VecScale(u, 1.0 / norm);
+	VecScale(c, 1.0 / norm);
+	recycle_u.push_back(u);
+	recycle_c.push_back(c);
+	if ((int) recycle_u.size() > recycle_size) {
+		recycle_u.pop_front();
+		recycle_c.pop_front();
+	}
+}
+template <size_t D> inline void PoissonSession<D>::solveRecycled()
+{
+	// start from the last solution, and add the part of the residual that is in the span of the
+	// recycled space
+	if (reuse_guess) {
+		MatMult(A, gamma, r);
+		VecAYPX(r, -1.0, b);
+	} else {
+		VecSet(gamma, 0);
+		VecCopy(b, r);
+	}
+	addCombination(gamma, 1.0, project(r), recycle_u);
+
+	// the Krylov solver only has to reduce what is left of the residual
+	double b_norm, r_norm;
+	VecNorm(b, NORM_2, &b_norm);
+	VecNorm(r, NORM_2, &r_norm);
+	iterations = 0;
+	if (r_norm <= tol * b_norm) { return; }
+	KSPSetTolerances(ksp, tol * b_norm / r_norm, PETSC_DEFAULT, PETSC_DEFAULT, max_its);
+	KSPSolve(ksp, r, x);
+	KSPGetIterationNumber(ksp, &iterations);
+
+	// x solves the projected system, so the correction is x minus its component that the
+	// recycled space already accounts for
+	MatMult(A, x, ax);
+	addCombination(x, -1.0, project(ax), recycle_u);
+	VecAXPY(gamma, 1.0, x);
+	addRecycled(x, ax);
+}
+#endif
@@ -37,8 +37,8 @@ template <size_t D> class IfaceInfo
 	                            std::deque<bool> &own, Side<D> s)
 	= 0;
 	virtual void getIdxAndTypes(std::deque<int> &idx, std::deque<IfaceType> &types) = 0;
-	virtual void setLocalIndexes(const std::map<int, int> &rev_map)                 = 0;
-	virtual void setGlobalIndexes(const std::map<int, int> &rev_map)                = 0;
+	virtual void setLocalIndexes(const IdIndex &rev_map)                            = 0;
+	virtual void setGlobalIndexes(const IdIndex &rev_map)                           = 0;
 };
 template <size_t D> class NormalIfaceInfo : public IfaceInfo<D>
 {
@@ -79,11 +79,11 @@ template <size_t D> class NormalIfaceInfo : public IfaceInfo<D>
 		idx.push_back(this->local_index);
 		types.push_back(IfaceType::normal);
 	}
-	void setLocalIndexes(const std::map<int, int> &rev_map)
+	void setLocalIndexes(const IdIndex &rev_map)
 	{
 		this->local_index = rev_map.at(this->id);
 	}
-	void setGlobalIndexes(const std::map<int, int> &rev_map)
+	void setGlobalIndexes(const IdIndex &rev_map)
 	{
 		this->global_index = rev_map.at(this->local_index);
 	}
@@ -135,12 +135,12 @@ template <size_t D> class CoarseIfaceInfo : public IfaceInfo<D>
 		ids.push_back(this->id);
 		ids.push_back(coarse_id);
 	}
-	void setLocalIndexes(const std::map<int, int> &rev_map)
+	void setLocalIndexes(const IdIndex &rev_map)
 	{
 		this->local_index  = rev_map.at(this->id);
 		coarse_local_index = rev_map.at(coarse_id);
 	}
-	void setGlobalIndexes(const std::map<int, int> &rev_map)
+	void setGlobalIndexes(const IdIndex &rev_map)
 	{
 		this->global_index  = rev_map.at(this->local_index);
 		coarse_global_index = rev_map.at(coarse_local_index);
@@ -196,14 +196,14 @@ template <size_t D> class FineIfaceInfo : public IfaceInfo<D>
 			ids.push_back(fine_ids[i]);
 		}
 	}
-	void setLocalIndexes(const std::map<int, int> &rev_map)
+	void setLocalIndexes(const IdIndex &rev_map)
 	{
 		this->local_index = rev_map.at(this->id);
 		for (size_t i = 0; i < fine_ids.size(); i++) {
 			fine_local_indexes[i] = rev_map.at(fine_ids[i]);
 		}
 	}
-	void setGlobalIndexes(const std::map<int, int> &rev_map)
+	void setGlobalIndexes(const IdIndex &rev_map)
 	{
 		this->global_index = rev_map.at(this->local_index);
 		for (size_t i = 0; i < fine_local_indexes.size(); i++) {
@@ -306,13 +306,13 @@ template <size_t D> struct SchurDomain {
 		}
 		return retval;
 	}
-	void setLocalIndexes(const std::map<int, int> &rev_map)
+	void setLocalIndexes(const IdIndex &rev_map)
 	{
 		for (Side<D> s : Side<D>::getValues()) {
 			if (hasNbr(s)) { getIfaceInfoPtr(s)->setLocalIndexes(rev_map); }
 		}
 	}
-	void setGlobalIndexes(const std::map<int, int> &rev_map)
+	void setGlobalIndexes(const IdIndex &rev_map)
 	{
 		for (Side<D> s : Side<D>::getValues()) {
 			if (hasNbr(s)) { getIfaceInfoPtr(s)->setGlobalIndexes(rev_map); }
@@ -22,11 +22,15 @@
 #ifndef SCHURHELPER_H
 #define SCHURHELPER_H
 #include "DomainCollection.h"
+#include "IdIndex.h"
 #include "Iface.h"
 #include "Interpolator.h"
+#include "PatchArray.h"
 #include "PatchOperator.h"
 #include "PatchSolvers/PatchSolver.h"
+#include "PatchTable.h"
 #include "SchurDomain.h"
+#include "SparseExchange.h"
 #include <deque>
 #include <memory>
 #include <petscmat.h>
@@ -51,6 +55,62 @@ template <size_t D> class SchurHelper
 	PW<Vec>        local_interp;
 	PW<VecScatter> scatter;
 
+	/**
+	 * @brief The interface values that are owned by other ranks, and the scatter that only moves
+	 * those. The rest are copied between the local and the distributed vectors directly, so that
+	 * only the ghosts are in flight while the interior domains are solved.
+	 */
+	PW<Vec>          ghost_gamma;
+	PW<Vec>          ghost_interp;
+	PW<VecScatter>   ghost_scatter;
+	std::vector<int> owned_blocks;
+	std::vector<int> owned_dist_blocks;
+	std::vector<int> ghost_blocks;
+	std::vector<int> ghost_dist_blocks;
+
+	/**
+	 * @brief The indexes in domains of the domains that only touch interface values owned by this
+	 * rank, and of those that touch ghosts, along with their patch tables
+	 */
+	std::vector<int> interior_domains;
+	std::vector<int> boundary_domains;
+	PatchTable<D>    interior_patches;
+	PatchTable<D>    boundary_patches;
+
+	/**
+	 * @brief The local interface values and interpolated values for each right hand side, and
+	 * vectors that are used to view one column of a dense matrix at a time
+	 */
+	PW<Mat> local_gammas;
+	PW<Mat> local_interps;
+	PW<Vec> gamma_col;
+	PW<Vec> interp_col;
+	PW<Vec> local_gamma_col;
+	PW<Vec> local_interp_col;
+	PW<Vec> u_col;
+	int     num_rhs = 0;
+
+	/**
+	 * @brief The domain vector that applySchurMatrix solves into, only the cells next to the sides
+	 * are set
+	 */
+	PW<Vec> trace_u;
+
+	/**
+	 * @brief Whether each patch is interpolated right after it is solved
+	 */
+	bool fused = true;
+
+	/**
+	 * @brief Whether the operator is applied through the ghost-padded copy of u
+	 */
+	bool padded = false;
+
+	/**
+	 * @brief The ghost-padded copy of u, only allocated when padded is set
+	 */
+	PatchArray<D> padded_u;
+
 	/**
 	 * @brief Interpolates to interface values
 	 */
@@ -69,6 +129,11 @@ template <size_t D> class SchurHelper
 	std::deque<SchurDomain<D>> domains;
 	std::map<int, IfaceSet<D>> ifaces;
 
+	/**
+	 * @brief The domains in flat arrays, which the apply and interpolate loops iterate over
+	 */
+	PatchTable<D> patches;
+
 	std::vector<int> iface_dist_map_vec;
 	std::vector<int> iface_map_vec;
 	std::vector<int> iface_off_proc_map_vec;
@@ -78,6 +143,18 @@ template <size_t D> class SchurHelper
 
 	int num_global_ifaces = 0;
 
+	void solveAndInterpolateColumns(const Mat f, Mat u, const Mat gamma, Mat interp);
+	void solveAndInterpolate(const Vec f, Vec u, const Vec gamma, Vec interp);
+	void solveAndInterpolateFused(const Vec f, Vec u, const Vec gamma, Vec interp);
+	typename PatchSolver<D>::DomainList getDomains(const std::vector<int> &indexes);
+	void solveDomains(const std::vector<int> &indexes, PatchTable<D> &table, const Vec f, Vec u);
+	void solveDomainsFused(const std::vector<int> &indexes, PatchTable<D> &table, const Vec f,
+	                       Vec u);
+	void applyOp(const Vec u, Vec f);
+	void splitDomains();
+	void copyBlocks(const Vec src, const std::vector<int> &src_blocks, Vec dst,
+	                const std::vector<int> &dst_blocks, InsertMode mode);
+
 	public:
 	SchurHelper() = default;
 	/**
@@ -100,8 +177,36 @@ template <size_t D> class SchurHelper
 	 */
 	void solveWithInterface(const Vec f, Vec u, const Vec gamma, Vec diff);
 	void solveAndInterpolateWithInterface(const Vec f, Vec u, const Vec gamma, Vec interp);
+	/**
+	 * @brief Apply the Schur complement matrix, this is solveWithInterface with a zero rhs
+	 *
+	 * The patch solver only has to set the cells that are interpolated to the interfaces, see
+	 * PatchSolver::domainTraceSolve.
+	 *
+	 * @param gamma the interface values to use
+	 * @param diff the resulting difference
+	 */
+	void applySchurMatrix(const Vec gamma, Vec diff);
 	void solveWithSolution(const Vec f, Vec u);
+	/**
+	 * @brief solveWithSolution with a different patch solver, such as a single precision solver
+	 * for a smoother. The domains from getSchurDomains have to be added to the solver.
+	 */
+	void solveWithSolution(const Vec f, Vec u, PatchSolver<D> &patch_solver);
 	void interpolateToInterface(const Vec f, Vec u, Vec gamma);
+	/**
+	 * @brief Solve with a given set of interface values, for several right hand sides at once
+	 *
+	 * Each column is a separate right hand side. The patch solver is given all of the columns in
+	 * a single call, so that it can apply each patch's plans to every column in one pass.
+	 *
+	 * @param f the rhs vectors, with the layout from DomainCollection::getNewDomainMat
+	 * @param u the vectors to put the solutions in
+	 * @param gamma the interface values to use, with the layout from getNewSchurMat
+	 * @param diff the resulting differences
+	 */
+	void solveWithInterface(const Mat f, Mat u, const Mat gamma, Mat diff);
+	void solveAndInterpolateWithInterface(const Mat f, Mat u, const Mat gamma, Mat interp);
 
 	/**
 	 * @brief Apply patch operator with a given set of interface values
@@ -112,6 +217,35 @@ template <size_t D> class SchurHelper
 	 */
 	void applyWithInterface(const Vec u, const Vec gamma, Vec f);
 	void apply(const Vec u, Vec f);
+	/**
+	 * @brief Set whether the solves interpolate each patch right after it is solved, see
+	 * PatchSolver::domainSolveFused, instead of interpolating all of the patches after they are
+	 * all solved
+	 *
+	 * The patches are solved one color of the patch table at a time, so that the threads can
+	 * interpolate them without locking. The boundary patches are always fused. The interior
+	 * patches are only fused when there are no ghost values, otherwise they are interpolated
+	 * while the ghost values are sent back. apps/bench/fused_bench compares the two.
+	 *
+	 * @param fused true to interpolate each patch after it is solved (the default)
+	 */
+	void setFused(bool fused)
+	{
+		this->fused = fused;
+	}
+	/**
+	 * @brief Set whether the operator is applied by copying u into a ghost-padded PatchArray, and
+	 * then applying the stencil without any boundary cases
+	 *
+	 * @param padded true to use the padded copy, false to read u directly (the default)
+	 */
+	void setPadded(bool padded)
+	{
+		this->padded = padded;
+		if (padded && padded_u.size() != patches.size()) {
+			padded_u = PatchArray<D>(n, patches.size());
+		}
+	}
 
 	PW_explicit<Vec> getNewSchurVec()
 	{
@@ -120,6 +254,18 @@ template <size_t D> class SchurHelper
 		             &u);
 		return u;
 	}
+	/**
+	 * @brief Get a new dense matrix where each column has the layout of a schur vector
+	 *
+	 * @param num_rhs the number of columns
+	 */
+	PW_explicit<Mat> getNewSchurMat(int num_rhs)
+	{
+		PW<Mat> u;
+		MatCreateDense(MPI_COMM_WORLD, iface_map_vec.size() * std::pow(n, D - 1), PETSC_DECIDE,
+		               PETSC_DETERMINE, num_rhs, nullptr, &u);
+		return u;
+	}
 	PW_explicit<Vec> getNewSchurDistVec()
 	{
 		PW<Vec> u;
@@ -148,6 +294,14 @@ template <size_t D> class SchurHelper
 	{
 		return solver;
 	}
+	std::deque<SchurDomain<D>> &getSchurDomains()
+	{
+		return domains;
+	}
+	const PatchTable<D> &getPatchTable() const
+	{
+		return patches;
+	}
 	const std::map<int, IfaceSet<D>> getIfaces() const
 	{
 		return ifaces;
@@ -172,61 +326,30 @@ inline SchurHelper<D>::SchurHelper(DomainCollection<D> dc, std::shared_ptr<Patch
 		solver->addDomain(sd);
 	}
 	{
-        using namespace std;
-	    // send info
-	    deque<char *>       buffers;
-	    deque<char *>       recv_buffers;
-	    vector<MPI_Request> requests;
-	    vector<MPI_Request> send_requests;
-	    for (auto &p : off_proc_ifaces) {
-	        int       dest   = p.second.first;
-	        IfaceSet<D> &iface  = p.second.second;
-	        int       size   = iface.serialize(nullptr);
-	        char *    buffer = new char[size];
-	        buffers.push_back(buffer);
-	        iface.serialize(buffer);
-	        MPI_Request request;
-	        MPI_Isend(buffer, size, MPI_CHAR, dest, 0, MPI_COMM_WORLD, &request);
-	        send_requests.push_back(request);
-	    }
-	    MPI_Barrier(MPI_COMM_WORLD);
-	    int        is_message;
-	    MPI_Status status;
-	    MPI_Iprobe(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &is_message, &status);
-	    // recv info
-	    while (is_message) {
-	        int size;
-	        MPI_Get_count(&status, MPI_CHAR, &size);
-	        char *buffer = new char[size];
-	        recv_buffers.push_back(buffer);
-
-	        MPI_Request request;
-	        MPI_Irecv(buffer, size, MPI_CHAR, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD,
-	                  &request);
-	        MPI_Iprobe(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &is_message, &status);
-	        requests.push_back(request);
-	    }
-	    // wait for all
-	    MPI_Barrier(MPI_COMM_WORLD);
-	    MPI_Startall(send_requests.size(), &send_requests[0]);
-	    MPI_Startall(requests.size(), &requests[0]);
-	    MPI_Waitall(requests.size(), &requests[0], MPI_STATUSES_IGNORE);
-	    MPI_Barrier(MPI_COMM_WORLD);
-	    // delete send buffers
-	    for (char *buffer : buffers) {
-	        delete[] buffer;
-	    }
-	    // process received objects
-	    for (char *buffer : recv_buffers) {
-	        IfaceSet<D> ifs;
-	        ifs.deserialize(buffer);
-	        ifaces[ifs.id].insert(ifs);
-	        delete[] buffer;
-	    }
-	    MPI_Barrier(MPI_COMM_WORLD);
+		using namespace std;
+		// pack the interfaces for each rank into one buffer
+		map<int, vector<char>> sends;
+		for (auto &p : off_proc_ifaces) {
+			vector<char> &buffer = sends[p.second.first];
+			IfaceSet<D> & iface  = p.second.second;
+			int           pos    = buffer.size();
+			buffer.resize(pos + iface.serialize(nullptr));
+			iface.serialize(&buffer[pos]);
+		}
+		// process received objects
+		for (auto &p : Utils::sparseExchange(sends)) {
+			vector<char> &buffer = p.second;
+			size_t        pos    = 0;
+			while (pos < buffer.size()) {
+				IfaceSet<D> ifs;
+				pos += ifs.deserialize(&buffer[pos]);
+				ifaces[ifs.id].insert(ifs);
+			}
+		}
 	}
 	indexDomainIfacesLocal();
 	indexIfacesLocal();
+	patches = PatchTable<D>(domains);
 	this->solver       = solver;
 	this->op           = op;
 	this->interpolator = interpolator;
@@ -238,57 +361,305 @@ inline SchurHelper<D>::SchurHelper(DomainCollection<D> dc, std::shared_ptr<Patch
 	              &iface_dist_map_vec[0], PETSC_COPY_VALUES, &dist_is);
 	VecScatterCreate(gamma, dist_is, local_gamma, nullptr, &scatter);
 
+	// the column vectors have no storage of their own, the arrays are placed when they are used
+	int local_size  = iface_map_vec.size() * std::pow(n, D - 1);
+	int dist_size   = iface_dist_map_vec.size() * std::pow(n, D - 1);
+	int domain_size = domains.size() * std::pow(n, D);
+	VecCreateMPIWithArray(MPI_COMM_WORLD, 1, local_size, PETSC_DETERMINE, nullptr, &gamma_col);
+	VecCreateMPIWithArray(MPI_COMM_WORLD, 1, local_size, PETSC_DETERMINE, nullptr, &interp_col);
+	VecCreateSeqWithArray(PETSC_COMM_SELF, 1, dist_size, nullptr, &local_gamma_col);
+	VecCreateSeqWithArray(PETSC_COMM_SELF, 1, dist_size, nullptr, &local_interp_col);
+	VecCreateSeqWithArray(PETSC_COMM_SELF, 1, domain_size, nullptr, &u_col);
+
+	splitDomains();
+
 	int num_ifaces = ifaces.size();
 	MPI_Allreduce(&num_ifaces, &num_global_ifaces, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
 }
-template <size_t D>
-inline void SchurHelper<D>::solveWithInterface(const Vec f, Vec u, const Vec gamma, Vec diff)
+template <size_t D> inline void SchurHelper<D>::splitDomains()
 {
-	// initilize our local variables
-	VecScatterBegin(scatter, gamma, local_gamma, INSERT_VALUES, SCATTER_FORWARD);
-	VecScatterEnd(scatter, gamma, local_gamma, INSERT_VALUES, SCATTER_FORWARD);
+	using namespace std;
+	int      block_size = pow(n, D - 1);
+	PetscInt start;
+	VecGetOwnershipRange(gamma, &start, nullptr);
+	start /= block_size;
+	int end = start + iface_map_vec.size();
 
-	VecScale(local_interp, 0);
-	// solve over domains on this proc
-	solver->domainSolve(domains, f, u, local_gamma);
-	for (SchurDomain<D> &sd : domains) {
-		interpolator->interpolate(sd, u, local_interp);
+	// the global indices are contiguous on each rank, so anything outside of this rank's range
+	// is a ghost
+	vector<bool> owned(iface_dist_map_vec.size());
+	vector<int>  ghost_global;
+	for (size_t i = 0; i < iface_dist_map_vec.size(); i++) {
+		int global = iface_dist_map_vec[i];
+		owned[i]   = global >= start && global < end;
+		if (owned[i]) {
+			owned_blocks.push_back(global - start);
+			owned_dist_blocks.push_back(i);
+		} else {
+			ghost_blocks.push_back(ghost_global.size());
+			ghost_dist_blocks.push_back(i);
+			ghost_global.push_back(global);
+		}
 	}
+	VecCreateSeq(PETSC_COMM_SELF, ghost_global.size() * block_size, &ghost_gamma);
+	VecCreateSeq(PETSC_COMM_SELF, ghost_global.size() * block_size, &ghost_interp);
+	PW<IS> ghost_is;
+	ISCreateBlock(MPI_COMM_SELF, block_size, ghost_global.size(), ghost_global.data(),
+	              PETSC_COPY_VALUES, &ghost_is);
+	VecScatterCreate(gamma, ghost_is, ghost_gamma, nullptr, &ghost_scatter);
 
-	// export diff vector
-	VecScale(diff, 0);
-	VecScatterBegin(scatter, local_interp, diff, ADD_VALUES, SCATTER_REVERSE);
-	VecScatterEnd(scatter, local_interp, diff, ADD_VALUES, SCATTER_REVERSE);
+	// a domain is interior if every interface value it is solved with and interpolated to is
+	// owned by this rank
+	for (int patch = 0; patch < patches.size(); patch++) {
+		bool interior = true;
+		for (int i = patches.interpBegin(patch); i < patches.interpEnd(patch); i++) {
+			interior = interior && owned[patches.getInterpLocalIndex(i)];
+		}
+		SchurDomain<D> &sd = domains[patch];
+		if (interior) {
+			interior_domains.push_back(patch);
+			interior_patches.addDomain(sd);
+		} else {
+			boundary_domains.push_back(patch);
+			boundary_patches.addDomain(sd);
+		}
+	}
+}
+template <size_t D>
+inline void SchurHelper<D>::copyBlocks(const Vec src, const std::vector<int> &src_blocks, Vec dst,
+                                       const std::vector<int> &dst_blocks, InsertMode mode)
+{
+	int           block_size = std::pow(n, D - 1);
+	const double *src_view;
+	double *      dst_view;
+	VecGetArrayRead(src, &src_view);
+	VecGetArray(dst, &dst_view);
+	for (size_t b = 0; b < src_blocks.size(); b++) {
+		const double *src_block = src_view + src_blocks[b] * block_size;
+		double *      dst_block = dst_view + dst_blocks[b] * block_size;
+		if (mode == ADD_VALUES) {
+			for (int i = 0; i < block_size; i++) {
+				dst_block[i] += src_block[i];
+			}
+		} else {
+			for (int i = 0; i < block_size; i++) {
+				dst_block[i] = src_block[i];
+			}
+		}
+	}
+	VecRestoreArray(dst, &dst_view);
+	VecRestoreArrayRead(src, &src_view);
+}
+template <size_t D>
+inline void SchurHelper<D>::solveWithInterface(const Vec f, Vec u, const Vec gamma, Vec diff)
+{
+	solveAndInterpolate(f, u, gamma, diff);
 	VecAXPBY(diff, 1.0, -1.0, gamma);
 }
 template <size_t D>
 inline void SchurHelper<D>::solveAndInterpolateWithInterface(const Vec f, Vec u, const Vec gamma,
                                                              Vec interp)
 {
-	// initilize our local variables
-	VecScatterBegin(scatter, gamma, local_gamma, INSERT_VALUES, SCATTER_FORWARD);
-	VecScatterEnd(scatter, gamma, local_gamma, INSERT_VALUES, SCATTER_FORWARD);
+	solveAndInterpolate(f, u, gamma, interp);
+}
+template <size_t D> inline void SchurHelper<D>::applySchurMatrix(const Vec gamma, Vec diff)
+{
+	if ((Vec) trace_u == nullptr) {
+		VecCreateMPI(MPI_COMM_WORLD, domains.size() * std::pow(n, D), PETSC_DETERMINE, &trace_u);
+	}
+	solveAndInterpolate(nullptr, trace_u, gamma, diff);
+	VecAXPBY(diff, 1.0, -1.0, gamma);
+}
+template <size_t D>
+inline typename PatchSolver<D>::DomainList
+SchurHelper<D>::getDomains(const std::vector<int> &indexes)
+{
+	typename PatchSolver<D>::DomainList ds;
+	ds.reserve(indexes.size());
+	for (int i : indexes) {
+		ds.push_back(&domains[i]);
+	}
+	return ds;
+}
+template <size_t D>
+inline void SchurHelper<D>::solveDomains(const std::vector<int> &indexes, PatchTable<D> &table,
+                                         const Vec f, Vec u)
+{
+	typename PatchSolver<D>::DomainList ds = getDomains(indexes);
+	// a null f is a zero rhs, where only the cells next to the sides are needed
+	if (f == nullptr) {
+		solver->domainTraceSolve(ds, u, local_gamma);
+	} else {
+		solver->domainSolveFused(ds, f, u, local_gamma, nullptr);
+	}
+	// the solver marks the patches with a zero rhs and zero interface values, which are zero in
+	// u and do not have to be interpolated
+	for (size_t i = 0; i < ds.size(); i++) {
+		table.setZero(i, ds[i]->domain.zero_patch);
+	}
+}
+template <size_t D>
+inline void SchurHelper<D>::solveAndInterpolate(const Vec f, Vec u, const Vec gamma, Vec interp)
+{
+	if (fused && f != nullptr) {
+		solveAndInterpolateFused(f, u, gamma, interp);
+		return;
+	}
+	// the interior domains are solved while the ghost values are sent
+	copyBlocks(gamma, owned_blocks, local_gamma, owned_dist_blocks, INSERT_VALUES);
+	VecScatterBegin(ghost_scatter, gamma, ghost_gamma, INSERT_VALUES, SCATTER_FORWARD);
+	solveDomains(interior_domains, interior_patches, f, u);
+	VecScatterEnd(ghost_scatter, gamma, ghost_gamma, INSERT_VALUES, SCATTER_FORWARD);
+	copyBlocks(ghost_gamma, ghost_blocks, local_gamma, ghost_dist_blocks, INSERT_VALUES);
+	solveDomains(boundary_domains, boundary_patches, f, u);
 
+	// the boundary domains are interpolated first, so that the interior domains can be
+	// interpolated while the ghost values are sent back
 	VecScale(local_interp, 0);
-	// solve over domains on this proc
-	solver->domainSolve(domains, f, u, local_gamma);
-	for (SchurDomain<D> &sd : domains) {
-		interpolator->interpolate(sd, u, local_interp);
+	interpolator->interpolate(boundary_patches, u, local_interp);
+	copyBlocks(local_interp, ghost_dist_blocks, ghost_interp, ghost_blocks, INSERT_VALUES);
+	VecScale(interp, 0);
+	VecScatterBegin(ghost_scatter, ghost_interp, interp, ADD_VALUES, SCATTER_REVERSE);
+	interpolator->interpolate(interior_patches, u, local_interp);
+	VecScatterEnd(ghost_scatter, ghost_interp, interp, ADD_VALUES, SCATTER_REVERSE);
+	copyBlocks(local_interp, owned_dist_blocks, interp, owned_blocks, ADD_VALUES);
+}
+template <size_t D>
+inline void SchurHelper<D>::solveDomainsFused(const std::vector<int> &indexes,
+                                              PatchTable<D> &table, const Vec f, Vec u)
+{
+	// the patches of one color do not share any interface values, so each patch can be
+	// interpolated by the thread that solved it while it is still in cache
+	double *interp_view;
+	VecGetArray(local_interp, &interp_view);
+	auto interpolate = [&](SchurDomain<D> &d, const double *u_view) {
+		interpolator->interpolatePatch(table, table.getPatch(d.local_index), u_view, interp_view);
+	};
+	for (int color = 0; color < table.getNumColors(); color++) {
+		const std::vector<int> &            color_patches = table.getColorPatches(color);
+		typename PatchSolver<D>::DomainList ds;
+		ds.reserve(color_patches.size());
+		for (int patch : color_patches) {
+			ds.push_back(&domains[indexes[patch]]);
+		}
+		solver->domainSolveFused(ds, f, u, local_gamma, interpolate);
+		for (int patch : color_patches) {
+			table.setZero(patch, domains[indexes[patch]].domain.zero_patch);
+		}
+	}
+	VecRestoreArray(local_interp, &interp_view);
+}
+template <size_t D>
+inline void SchurHelper<D>::solveAndInterpolateFused(const Vec f, Vec u, const Vec gamma,
+                                                     Vec interp)
+{
+	VecScale(local_interp, 0);
+	bool has_ghosts = !ghost_blocks.empty();
+
+	// the interior domains are solved while the ghost values are sent
+	copyBlocks(gamma, owned_blocks, local_gamma, owned_dist_blocks, INSERT_VALUES);
+	VecScatterBegin(ghost_scatter, gamma, ghost_gamma, INSERT_VALUES, SCATTER_FORWARD);
+	if (has_ghosts) {
+		solveDomains(interior_domains, interior_patches, f, u);
+	} else {
+		solveDomainsFused(interior_domains, interior_patches, f, u);
 	}
+	VecScatterEnd(ghost_scatter, gamma, ghost_gamma, INSERT_VALUES, SCATTER_FORWARD);
+	copyBlocks(ghost_gamma, ghost_blocks, local_gamma, ghost_dist_blocks, INSERT_VALUES);
 
-	// export diff vector
+	// the boundary domains are interpolated as they are solved, so that the interior domains can
+	// be interpolated while the ghost values are sent back
+	solveDomainsFused(boundary_domains, boundary_patches, f, u);
+	copyBlocks(local_interp, ghost_dist_blocks, ghost_interp, ghost_blocks, INSERT_VALUES);
 	VecScale(interp, 0);
-	VecScatterBegin(scatter, local_interp, interp, ADD_VALUES, SCATTER_REVERSE);
-	VecScatterEnd(scatter, local_interp, interp, ADD_VALUES, SCATTER_REVERSE);
+	VecScatterBegin(ghost_scatter, ghost_interp, interp, ADD_VALUES, SCATTER_REVERSE);
+	if (has_ghosts) { interpolator->interpolate(interior_patches, u, local_interp); }
+	VecScatterEnd(ghost_scatter, ghost_interp, interp, ADD_VALUES, SCATTER_REVERSE);
+	copyBlocks(local_interp, owned_dist_blocks, interp, owned_blocks, ADD_VALUES);
+}
+template <size_t D>
+inline void SchurHelper<D>::solveWithInterface(const Mat f, Mat u, const Mat gamma, Mat diff)
+{
+	solveAndInterpolateColumns(f, u, gamma, diff);
+	MatAYPX(diff, -1.0, gamma, SAME_NONZERO_PATTERN);
+}
+template <size_t D>
+inline void SchurHelper<D>::solveAndInterpolateWithInterface(const Mat f, Mat u, const Mat gamma,
+                                                             Mat interp)
+{
+	solveAndInterpolateColumns(f, u, gamma, interp);
+}
+template <size_t D>
+inline void SchurHelper<D>::solveAndInterpolateColumns(const Mat f, Mat u, const Mat gamma,
+                                                       Mat interp)
+{
+	PetscInt cols;
+	MatGetSize(f, nullptr, &cols);
+	int dist_size = iface_dist_map_vec.size() * std::pow(n, D - 1);
+	if (cols != num_rhs) {
+		num_rhs       = cols;
+		local_gammas  = PW<Mat>();
+		local_interps = PW<Mat>();
+		MatCreateSeqDense(PETSC_COMM_SELF, dist_size, num_rhs, nullptr, &local_gammas);
+		MatCreateSeqDense(PETSC_COMM_SELF, dist_size, num_rhs, nullptr, &local_interps);
+	}
+	PetscInt gamma_lda, interp_lda, u_lda;
+	MatDenseGetLDA(gamma, &gamma_lda);
+	MatDenseGetLDA(interp, &interp_lda);
+	MatDenseGetLDA(u, &u_lda);
+
+	// initilize our local variables
+	double *gamma_view, *local_gammas_view;
+	MatDenseGetArray(gamma, &gamma_view);
+	MatDenseGetArray(local_gammas, &local_gammas_view);
+	for (int j = 0; j < num_rhs; j++) {
+		VecPlaceArray(gamma_col, gamma_view + j * gamma_lda);
+		VecPlaceArray(local_gamma_col, local_gammas_view + j * dist_size);
+		VecScatterBegin(scatter, gamma_col, local_gamma_col, INSERT_VALUES, SCATTER_FORWARD);
+		VecScatterEnd(scatter, gamma_col, local_gamma_col, INSERT_VALUES, SCATTER_FORWARD);
+		VecResetArray(gamma_col);
+		VecResetArray(local_gamma_col);
+	}
+	MatDenseRestoreArray(gamma, &gamma_view);
+	MatDenseRestoreArray(local_gammas, &local_gammas_view);
+
+	// solve over domains on this proc
+	solver->domainSolveMulti(domains, f, u, local_gammas);
+
+	MatZeroEntries(local_interps);
+	double *u_view, *local_interps_view, *interp_view;
+	MatDenseGetArray(u, &u_view);
+	MatDenseGetArray(local_interps, &local_interps_view);
+	MatDenseGetArray(interp, &interp_view);
+	for (int j = 0; j < num_rhs; j++) {
+		VecPlaceArray(u_col, u_view + j * u_lda);
+		VecPlaceArray(local_interp_col, local_interps_view + j * dist_size);
+		VecPlaceArray(interp_col, interp_view + j * interp_lda);
+		interpolator->interpolate(patches, u_col, local_interp_col);
+
+		// export interp vector
+		VecScale(interp_col, 0);
+		VecScatterBegin(scatter, local_interp_col, interp_col, ADD_VALUES, SCATTER_REVERSE);
+		VecScatterEnd(scatter, local_interp_col, interp_col, ADD_VALUES, SCATTER_REVERSE);
+		VecResetArray(u_col);
+		VecResetArray(local_interp_col);
+		VecResetArray(interp_col);
+	}
+	MatDenseRestoreArray(u, &u_view);
+	MatDenseRestoreArray(local_interps, &local_interps_view);
+	MatDenseRestoreArray(interp, &interp_view);
 }
 template <size_t D> inline void SchurHelper<D>::solveWithSolution(const Vec f, Vec u)
+{
+	solveWithSolution(f, u, *solver);
+}
+template <size_t D>
+inline void SchurHelper<D>::solveWithSolution(const Vec f, Vec u, PatchSolver<D> &patch_solver)
 {
 	// initilize our local variables
 	VecScale(local_gamma, 0);
 	VecScale(local_interp, 0);
-	for (SchurDomain<D> &sd : domains) {
-		interpolator->interpolate(sd, u, local_interp);
-	}
+	interpolator->interpolate(patches, u, local_interp);
 	VecScale(gamma, 0);
 	VecScatterBegin(scatter, local_interp, gamma, ADD_VALUES, SCATTER_REVERSE);
 	VecScatterEnd(scatter, local_interp, gamma, ADD_VALUES, SCATTER_REVERSE);
@@ -296,16 +667,14 @@ template <size_t D> inline void SchurHelper<D>::solveWithSolution(const Vec f, V
 	VecScatterEnd(scatter, gamma, local_gamma, INSERT_VALUES, SCATTER_FORWARD);
 
 	// solve over domains on this proc
-	solver->domainSolve(domains, f, u, local_gamma);
+	patch_solver.domainSolve(domains, f, u, local_gamma);
 }
 template <size_t D>
 inline void SchurHelper<D>::interpolateToInterface(const Vec f, Vec u, Vec gamma)
 {
 	// initilize our local variables
 	VecScale(local_interp, 0);
-	for (SchurDomain<D> &sd : domains) {
-		interpolator->interpolate(sd, u, local_interp);
-	}
+	interpolator->interpolate(patches, u, local_interp);
 	VecScale(gamma, 0);
 	VecScatterBegin(scatter, local_interp, gamma, ADD_VALUES, SCATTER_REVERSE);
 	VecScatterEnd(scatter, local_interp, gamma, ADD_VALUES, SCATTER_REVERSE);
@@ -315,31 +684,33 @@ inline void SchurHelper<D>::applyWithInterface(const Vec u, const Vec gamma, Vec
 {
 	VecScatterBegin(scatter, gamma, local_gamma, INSERT_VALUES, SCATTER_FORWARD);
 	VecScatterEnd(scatter, gamma, local_gamma, INSERT_VALUES, SCATTER_FORWARD);
-	for (SchurDomain<D> &sd : domains) {
-		op->apply(sd, u, local_gamma, f);
-	}
+	applyOp(u, f);
 }
 template <size_t D> inline void SchurHelper<D>::apply(const Vec u, Vec f)
 {
 	VecScale(local_interp, 0);
-	for (SchurDomain<D> &sd : domains) {
-		interpolator->interpolate(sd, u, local_interp);
-	}
+	interpolator->interpolate(patches, u, local_interp);
 	VecScale(gamma, 0);
 	VecScatterBegin(scatter, local_interp, gamma, ADD_VALUES, SCATTER_REVERSE);
 	VecScatterEnd(scatter, local_interp, gamma, ADD_VALUES, SCATTER_REVERSE);
 	VecScatterBegin(scatter, gamma, local_gamma, INSERT_VALUES, SCATTER_FORWARD);
 	VecScatterEnd(scatter, gamma, local_gamma, INSERT_VALUES, SCATTER_FORWARD);
 
-	for (SchurDomain<D> &sd : domains) {
-		op->apply(sd, u, local_gamma, f);
+	applyOp(u, f);
+}
+template <size_t D> inline void SchurHelper<D>::applyOp(const Vec u, Vec f)
+{
+	if (padded) {
+		op->apply(patches, padded_u, u, local_gamma, f);
+	} else {
+		op->apply(patches, u, local_gamma, f);
 	}
 }
 template <size_t D> inline void SchurHelper<D>::indexDomainIfacesLocal()
 {
 	using namespace std;
-	vector<int>   map_vec;
-	map<int, int> rev_map;
+	vector<int> map_vec;
+	IdIndex     rev_map(domains.size() * Side<D>::num_sides);
 	if (!domains.empty()) {
 		int curr_i = 0;
 		for (SchurDomain<D> &sd : domains) {
@@ -360,37 +731,31 @@ template <size_t D> inline void SchurHelper<D>::indexDomainIfacesLocal()
 template <size_t D> inline void SchurHelper<D>::indexIfacesLocal()
 {
 	using namespace std;
-	int           curr_i = 0;
-	vector<int>   map_vec;
-	vector<int>   off_proc_map_vec;
-	vector<int>   off_proc_map_vec_send;
-	map<int, int> rev_map;
-	if (!ifaces.empty()) {
-		set<int> todo;
-		for (auto &p : ifaces) {
-			todo.insert(p.first);
-		}
-		set<int> enqueued;
-		while (!todo.empty()) {
-			deque<int> queue;
-			queue.push_back(*todo.begin());
-			enqueued.insert(*todo.begin());
-			while (!queue.empty()) {
-				int i = queue.front();
-				todo.erase(i);
-				queue.pop_front();
-				map_vec.push_back(i);
-				IfaceSet<D> &ifs = ifaces.at(i);
-				rev_map[i]       = curr_i;
-				curr_i++;
-				for (int nbr : ifs.getNbrs()) {
-					if (!enqueued.count(nbr)) {
-						enqueued.insert(nbr);
-						if (ifaces.count(nbr)) {
-							queue.push_back(nbr);
-						} else {
-							off_proc_map_vec.push_back(nbr);
-						}
+	int         curr_i = 0;
+	vector<int> map_vec;
+	vector<int> off_proc_map_vec;
+	IdIndex     rev_map(ifaces.size());
+	// breadth first from the lowest id that has not been reached yet
+	IdIndex    enqueued(ifaces.size());
+	deque<int> queue;
+	for (auto &p : ifaces) {
+		if (enqueued.count(p.first)) { continue; }
+		queue.push_back(p.first);
+		enqueued[p.first] = 1;
+		while (!queue.empty()) {
+			int i = queue.front();
+			queue.pop_front();
+			map_vec.push_back(i);
+			IfaceSet<D> &ifs = ifaces.at(i);
+			rev_map[i]       = curr_i;
+			curr_i++;
+			for (int nbr : ifs.getNbrs()) {
+				if (!enqueued.count(nbr)) {
+					enqueued[nbr] = 1;
+					if (ifaces.count(nbr)) {
+						queue.push_back(nbr);
+					} else {
+						off_proc_map_vec.push_back(nbr);
 					}
 				}
 			}
@@ -434,7 +799,7 @@ template <size_t D> inline void SchurHelper<D>::indexIfacesGlobal()
 
 		// get new global indices
 		AOApplicationToPetsc(ao, inds.size(), &inds[0]);
-		map<int, int> rev_map;
+		IdIndex rev_map(inds.size());
 		for (size_t i = 0; i < inds.size(); i++) {
 			rev_map[i] = inds[i];
 		}
@@ -457,7 +822,7 @@ template <size_t D> inline void SchurHelper<D>::indexIfacesGlobal()
 
 		// get new global indices
 		AOApplicationToPetsc(ao, inds.size(), &inds[0]);
-		map<int, int> rev_map;
+		IdIndex rev_map(inds.size());
 		for (size_t i = 0; i < inds.size(); i++) {
 			rev_map[i] = inds[i];
 		}
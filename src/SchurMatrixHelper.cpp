@@ -259,6 +259,7 @@ void SchurMatrixHelper::assembleMatrix(inserter insertBlock)
 		solver->addDomain(sd);
 		std::deque<SchurDomain<3>> single_domain;
 		single_domain.push_back(sd);
+		PatchTable<3> single_patch(single_domain);
 
 		map<BlockKey, shared_ptr<valarray<double>>> coeffs;
 		// allocate blocks of coefficients
@@ -280,7 +281,7 @@ void SchurMatrixHelper::assembleMatrix(inserter insertBlock)
 				Side<3>   s    = bk.s;
 				IfaceType type = bk.type;
 				VecScale(interp, 0);
-				interpolator->interpolate(sd, s, 0, type, u, interp);
+				interpolator->interpolate(single_patch, 0, s, 0, type, u, interp);
 				valarray<double> &block = *p.second;
 				for (int i = 0; i < n * n; i++) {
 					block[i * n * n + j] = -interp_view[i];
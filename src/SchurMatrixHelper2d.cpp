@@ -138,6 +138,7 @@ void SchurMatrixHelper2d::assembleMatrix(inserter insertBlock)
 		solver->addDomain(sd);
 		std::deque<SchurDomain<2>> single_domain;
 		single_domain.push_back(sd);
+		PatchTable<2> single_patch(single_domain);
 
 		map<BlockKey, shared_ptr<valarray<double>>> coeffs;
 		// allocate blocks of coefficients
@@ -158,7 +159,7 @@ void SchurMatrixHelper2d::assembleMatrix(inserter insertBlock)
 				Side<2>   s    = p.first.s;
 				IfaceType type = p.first.type;
 				VecScale(interp, 0);
-				interpolator->interpolate(sd, s, 0, type, u, interp);
+				interpolator->interpolate(single_patch, 0, s, 0, type, u, interp);
 				valarray<double> &block = *p.second;
 				for (int i = 0; i < n; i++) {
 					block[i * n + j] = -interp_view[i];
@@ -23,180 +23,226 @@
 #define SEVENPTPATCHOPERATOR_H
 #include "PatchOperator.h"
 #include "Utils.h"
+#include <vector>
+/**
+ * @brief Seven point stencil operator.
+ *
+ * The stencil is applied in a single sweep over the patch. Boundary conditions are resolved once
+ * per patch into ghost values of the form sign * center + 2 * gamma, so that every cell uses the
+ * same three second differences and the interior of each row vectorizes. With a PatchArray the
+ * ghost values are already in place, and every row is a single loop. The kernels are compiled for
+ * the common patch sizes, see Utils::getKernel.
+ */
 class SevenPtPatchOperator : public PatchOperator<3>
 {
+	private:
+	/**
+	 * @brief Get the ghost value coefficient of the adjacent cell for a side of a patch.
+	 *
+	 * @return 1 for a Neumann boundary without neighbor, -1 otherwise
+	 */
+	static double ghostSign(const PatchTable<3> &patches, int patch, Side<3> s)
+	{
+		return (patches.isNeumann(patch, s) && !patches.hasNbr(patch, s)) ? 1.0 : -1.0;
+	}
+	/**
+	 * @brief Get the interface values for a side of a patch.
+	 *
+	 * @return the values, or nullptr if there is no neighbor on that side
+	 */
+	static const double *getBoundary(const PatchTable<3> &patches, int patch, Side<3> s,
+	                                 const double *gamma_view)
+	{
+		if (!patches.hasNbr(patch, s)) { return nullptr; }
+		int n = patches.getN();
+		return &gamma_view[n * n * patches.getIfaceLocalIndex(patch, s)];
+	}
+	/**
+	 * @brief Fill a row of ghost values.
+	 *
+	 * @param n the length of the row
+	 * @param sign the coefficient of the adjacent cell
+	 * @param u_row the adjacent row of cells
+	 * @param boundary the interface values for the row, or nullptr for zero
+	 * @param ghost the ghost values to fill
+	 */
+	static void fillGhostRow(int n, double sign, const double *u_row, const double *boundary,
+	                         double *ghost)
+	{
+		if (boundary != nullptr) {
+#pragma omp simd
+			for (int xi = 0; xi < n; xi++) {
+				ghost[xi] = sign * u_row[xi] + 2 * boundary[xi];
+			}
+		} else {
+#pragma omp simd
+			for (int xi = 0; xi < n; xi++) {
+				ghost[xi] = sign * u_row[xi];
+			}
+		}
+	}
+
+	/**
+	 * @brief The stencil applied to one patch, compiled for patches of size N
+	 */
+	template <int N> struct ApplyKernel {
+		typedef void (*Function)(const PatchTable<3> &, int, const double *, const double *,
+		                         double *);
+		static void run(const PatchTable<3> &patches, int patch, const double *u_view,
+		                const double *gamma_view, double *f_view);
+	};
+	/**
+	 * @brief The stencil applied to one patch of a ghost-padded array, compiled for patches of
+	 * size N
+	 */
+	template <int N> struct PaddedKernel {
+		typedef void (*Function)(const PatchTable<3> &, int, const PatchArray<3> &, double *);
+		static void run(const PatchTable<3> &patches, int patch, const PatchArray<3> &u,
+		                double *f_view);
+	};
+	bool specialized = true;
+
 	public:
-	void apply(SchurDomain<3> &d, const Vec u, const Vec gamma, Vec f)
+	/**
+	 * @brief Set whether the kernels compiled for fixed patch sizes are used
+	 *
+	 * @param specialized true to use them for the sizes they exist for (the default), false to
+	 * always use the generic kernel
+	 */
+	void setSpecialized(bool specialized)
+	{
+		this->specialized = specialized;
+	}
+	void applyPatch(const PatchTable<3> &patches, int patch, const double *u_view,
+	                const double *gamma_view, double *f_view)
+	{
+		Utils::getKernel<ApplyKernel>(patches.getN(), specialized)(patches, patch, u_view,
+		                                                           gamma_view, f_view);
+	}
+	void applyPaddedPatch(const PatchTable<3> &patches, int patch, const PatchArray<3> &padded,
+	                      const double *u_view, const double *gamma_view, double *f_view)
 	{
-		using namespace Utils;
-		int           n     = d.n;
-		double        h_x   = d.domain.lengths[0] / n;
-		double        h_y   = d.domain.lengths[1] / n;
-		int           start = n * n * n * d.local_index;
-		const double *u_view;
-		double *      f_view, *gamma_view;
-		VecGetArrayRead(u, &u_view);
-		VecGetArray(f, &f_view);
-		double *      f_ptr = f_view + start;
-		const double *u_ptr = u_view + start;
-		VecGetArray(gamma, &gamma_view);
+		Utils::getKernel<PaddedKernel>(patches.getN(), specialized)(patches, patch, padded,
+		                                                            f_view);
+	}
+};
+template <int N>
+inline void SevenPtPatchOperator::ApplyKernel<N>::run(const PatchTable<3> &patches, int patch,
+                                                      const double *u_view,
+                                                      const double *gamma_view, double *f_view)
+{
+	using namespace Utils;
+	int           n     = patchSize<N>(patches.getN());
+	double        h_x   = patches.getSpacing(patch, 0);
+	double        h_y   = patches.getSpacing(patch, 1);
+	double        h_z   = patches.getSpacing(patch, 2);
+	int           start = n * n * n * patches.getLocalIndex(patch);
+	double *      f_ptr = f_view + start;
+	const double *u_ptr = u_view + start;
 
-		const double *boundary_west = nullptr;
-		if (d.hasNbr(Side<3>::west)) {
-			boundary_west = &gamma_view[n * n * d.getIfaceLocalIndex(Side<3>::west)];
-		}
-		const double *boundary_east = nullptr;
-		if (d.hasNbr(Side<3>::east)) {
-			boundary_east = &gamma_view[n * n * d.getIfaceLocalIndex(Side<3>::east)];
-		}
-		const double *boundary_south = nullptr;
-		if (d.hasNbr(Side<3>::south)) {
-			boundary_south = &gamma_view[n * n * d.getIfaceLocalIndex(Side<3>::south)];
-		}
-		const double *boundary_north = nullptr;
-		if (d.hasNbr(Side<3>::north)) {
-			boundary_north = &gamma_view[n * n * d.getIfaceLocalIndex(Side<3>::north)];
-		}
-		const double *boundary_bottom = nullptr;
-		if (d.hasNbr(Side<3>::bottom)) {
-			boundary_bottom = &gamma_view[n * n * d.getIfaceLocalIndex(Side<3>::bottom)];
-		}
-		const double *boundary_top = nullptr;
-		if (d.hasNbr(Side<3>::top)) {
-			boundary_top = &gamma_view[n * n * d.getIfaceLocalIndex(Side<3>::top)];
-		}
+	const double *boundary_west   = getBoundary(patches, patch, Side<3>::west, gamma_view);
+	const double *boundary_east   = getBoundary(patches, patch, Side<3>::east, gamma_view);
+	const double *boundary_south  = getBoundary(patches, patch, Side<3>::south, gamma_view);
+	const double *boundary_north  = getBoundary(patches, patch, Side<3>::north, gamma_view);
+	const double *boundary_bottom = getBoundary(patches, patch, Side<3>::bottom, gamma_view);
+	const double *boundary_top    = getBoundary(patches, patch, Side<3>::top, gamma_view);
 
-		double center, north, east, south, west, bottom, top;
+	double sign_west   = ghostSign(patches, patch, Side<3>::west);
+	double sign_east   = ghostSign(patches, patch, Side<3>::east);
+	double sign_south  = ghostSign(patches, patch, Side<3>::south);
+	double sign_north  = ghostSign(patches, patch, Side<3>::north);
+	double sign_bottom = ghostSign(patches, patch, Side<3>::bottom);
+	double sign_top    = ghostSign(patches, patch, Side<3>::top);
 
-		// derive in x direction
-		// west
-		for (int zi = 0; zi < n; zi++) {
-			for (int yi = 0; yi < n; yi++) {
-				west = 0;
-				if (boundary_west != nullptr) { west = boundary_west[yi + zi * n]; }
-				center = u_ptr[index(n, 0, yi, zi)];
-				east   = u_ptr[index(n, 1, yi, zi)];
-				if (d.isNeumann(Side<3>::west) && !d.hasNbr(Side<3>::west)) {
-					f_ptr[index(n, 0, yi, zi)] = (-h_x * west - center + east) / (h_x * h_x);
-				} else {
-					f_ptr[index(n, 0, yi, zi)] = (2 * west - 3 * center + east) / (h_x * h_x);
-				}
-			}
-		}
-		// middle
-		for (int zi = 0; zi < n; zi++) {
-			for (int yi = 0; yi < n; yi++) {
-				for (int xi = 1; xi < n - 1; xi++) {
-					west   = u_ptr[index(n, xi - 1, yi, zi)];
-					center = u_ptr[index(n, xi, yi, zi)];
-					east   = u_ptr[index(n, xi + 1, yi, zi)];
+	double ih_x2 = 1.0 / (h_x * h_x);
+	double ih_y2 = 1.0 / (h_y * h_y);
+	double ih_z2 = 1.0 / (h_z * h_z);
 
-					f_ptr[index(n, xi, yi, zi)] = (west - 2 * center + east) / (h_x * h_x);
-				}
-			}
-		}
-		// east
-		for (int zi = 0; zi < n; zi++) {
-			for (int yi = 0; yi < n; yi++) {
-				west   = u_ptr[index(n, n - 2, yi, zi)];
-				center = u_ptr[index(n, n - 1, yi, zi)];
-				east   = 0;
-				if (boundary_east != nullptr) { east = boundary_east[yi + zi * n]; }
-				if (d.isNeumann(Side<3>::east) && !d.hasNbr(Side<3>::east)) {
-					f_ptr[index(n, n - 1, yi, zi)] = (west - center + h_x * east) / (h_x * h_x);
-				} else {
-					f_ptr[index(n, n - 1, yi, zi)] = (west - 3 * center + 2 * east) / (h_x * h_x);
-				}
-			}
-		}
+	// ghost rows for the faces perpendicular to the y and z axes, on the stack when the size is
+	// known at compile time
+	std::vector<double> ghost_storage(N == 0 ? 2 * n : 0);
+	double              ghost_fixed[N == 0 ? 1 : 2 * N];
+	double *            ghost_y = N == 0 ? ghost_storage.data() : ghost_fixed;
+	double *            ghost_z = ghost_y + n;
 
-		// derive in y direction
-		// south
-		for (int zi = 0; zi < n; zi++) {
-			for (int xi = 0; xi < n; xi++) {
-				south = 0;
-				if (boundary_south != nullptr) { south = boundary_south[xi + zi * n]; }
-				center = u_ptr[index(n, xi, 0, zi)];
-				north  = u_ptr[index(n, xi, 1, zi)];
-				if (d.isNeumann(Side<3>::south) && !d.hasNbr(Side<3>::south)) {
-					f_ptr[index(n, xi, 0, zi)] += (-h_y * south - center + north) / (h_y * h_y);
-				} else {
-					f_ptr[index(n, xi, 0, zi)] += (2 * south - 3 * center + north) / (h_y * h_y);
-				}
-			}
-		}
-		// middle
-		for (int zi = 0; zi < n; zi++) {
-			for (int yi = 1; yi < n - 1; yi++) {
-				for (int xi = 0; xi < n; xi++) {
-					south  = u_ptr[index(n, xi, yi - 1, zi)];
-					center = u_ptr[index(n, xi, yi, zi)];
-					north  = u_ptr[index(n, xi, yi + 1, zi)];
+	for (int zi = 0; zi < n; zi++) {
+		for (int yi = 0; yi < n; yi++) {
+			const double *row   = u_ptr + index(n, 0, yi, zi);
+			double *      f_row = f_ptr + index(n, 0, yi, zi);
 
-					f_ptr[index(n, xi, yi, zi)] += (south - 2 * center + north) / (h_y * h_y);
-				}
+			const double *south = ghost_y;
+			const double *north = ghost_y;
+			if (yi > 0) { south = row - n; }
+			if (yi < n - 1) { north = row + n; }
+			if (yi == 0) {
+				const double *b = boundary_south ? boundary_south + zi * n : nullptr;
+				fillGhostRow(n, sign_south, row, b, ghost_y);
+			} else if (yi == n - 1) {
+				const double *b = boundary_north ? boundary_north + zi * n : nullptr;
+				fillGhostRow(n, sign_north, row, b, ghost_y);
 			}
-		}
-		// north
-		for (int zi = 0; zi < n; zi++) {
-			for (int xi = 0; xi < n; xi++) {
-				south  = u_ptr[index(n, xi, n - 2, zi)];
-				center = u_ptr[index(n, xi, n - 1, zi)];
-				north  = 0;
-				if (boundary_north != nullptr) { north = boundary_north[xi + zi * n]; }
-				if (d.isNeumann(Side<3>::north) && !d.hasNbr(Side<3>::north)) {
-					f_ptr[index(n, xi, n - 1, zi)] += (south - center + h_y * north) / (h_y * h_y);
-				} else {
-					f_ptr[index(n, xi, n - 1, zi)]
-					+= (south - 3 * center + 2 * north) / (h_y * h_y);
-				}
+			const double *bottom = ghost_z;
+			const double *top    = ghost_z;
+			if (zi > 0) { bottom = row - n * n; }
+			if (zi < n - 1) { top = row + n * n; }
+			if (zi == 0) {
+				const double *b = boundary_bottom ? boundary_bottom + yi * n : nullptr;
+				fillGhostRow(n, sign_bottom, row, b, ghost_z);
+			} else if (zi == n - 1) {
+				const double *b = boundary_top ? boundary_top + yi * n : nullptr;
+				fillGhostRow(n, sign_top, row, b, ghost_z);
 			}
-		}
 
-		// derive in z direction
-		// bottom
-		for (int yi = 0; yi < n; yi++) {
-			for (int xi = 0; xi < n; xi++) {
-				bottom = 0;
-				if (boundary_bottom != nullptr) { bottom = boundary_bottom[xi + yi * n]; }
-				center = u_ptr[index(n, xi, yi, 0)];
-				top    = u_ptr[index(n, xi, yi, 1)];
-				if (d.isNeumann(Side<3>::bottom) && !d.hasNbr(Side<3>::bottom)) {
-					f_ptr[index(n, xi, yi, 0)] += (-h_y * bottom - center + top) / (h_y * h_y);
-				} else {
-					f_ptr[index(n, xi, yi, 0)] += (2 * bottom - 3 * center + top) / (h_y * h_y);
-				}
+			// interior of the row
+#pragma omp simd
+			for (int xi = 1; xi < n - 1; xi++) {
+				double center = row[xi];
+				f_row[xi]     = (row[xi - 1] - 2 * center + row[xi + 1]) * ih_x2
+				            + (south[xi] - 2 * center + north[xi]) * ih_y2
+				            + (bottom[xi] - 2 * center + top[xi]) * ih_z2;
 			}
-		}
-		// middle
-		for (int zi = 1; zi < n - 1; zi++) {
-			for (int yi = 0; yi < n; yi++) {
-				for (int xi = 0; xi < n; xi++) {
-					bottom = u_ptr[index(n, xi, yi, zi - 1)];
-					center = u_ptr[index(n, xi, yi, zi)];
-					top    = u_ptr[index(n, xi, yi, zi + 1)];
 
-					f_ptr[index(n, xi, yi, zi)] += (bottom - 2 * center + top) / (h_y * h_y);
-				}
-			}
+			// west and east cells
+			double west = sign_west * row[0];
+			if (boundary_west != nullptr) { west += 2 * boundary_west[yi + zi * n]; }
+			double east = sign_east * row[n - 1];
+			if (boundary_east != nullptr) { east += 2 * boundary_east[yi + zi * n]; }
+
+			double center = row[0];
+			f_row[0]      = (west - 2 * center + row[1]) * ih_x2
+			           + (south[0] - 2 * center + north[0]) * ih_y2
+			           + (bottom[0] - 2 * center + top[0]) * ih_z2;
+			center       = row[n - 1];
+			f_row[n - 1] = (row[n - 2] - 2 * center + east) * ih_x2
+			               + (south[n - 1] - 2 * center + north[n - 1]) * ih_y2
+			               + (bottom[n - 1] - 2 * center + top[n - 1]) * ih_z2;
 		}
-		// top
+	}
+}
+template <int N>
+inline void SevenPtPatchOperator::PaddedKernel<N>::run(const PatchTable<3> &patches, int patch,
+                                                       const PatchArray<3> &u, double *f_view)
+{
+	int           n       = Utils::patchSize<N>(patches.getN());
+	int           y_step  = n + 2;
+	int           z_step  = (n + 2) * (n + 2);
+	double        ih_x2   = 1.0 / (patches.getSpacing(patch, 0) * patches.getSpacing(patch, 0));
+	double        ih_y2   = 1.0 / (patches.getSpacing(patch, 1) * patches.getSpacing(patch, 1));
+	double        ih_z2   = 1.0 / (patches.getSpacing(patch, 2) * patches.getSpacing(patch, 2));
+	double *      f_ptr   = f_view + n * n * n * patches.getLocalIndex(patch);
+	const double *u_first = u.getPatch(patch);
+	for (int zi = 0; zi < n; zi++) {
 		for (int yi = 0; yi < n; yi++) {
+			const double *row   = u_first + yi * y_step + zi * z_step;
+			double *      f_row = f_ptr + Utils::index(n, 0, yi, zi);
+#pragma omp simd
 			for (int xi = 0; xi < n; xi++) {
-				bottom = u_ptr[index(n, xi, yi, n - 2)];
-				center = u_ptr[index(n, xi, yi, n - 1)];
-				top    = 0;
-				if (boundary_top != nullptr) { top = boundary_top[xi + yi * n]; }
-				if (d.isNeumann(Side<3>::top) && !d.hasNbr(Side<3>::top)) {
-					f_ptr[index(n, xi, yi, n - 1)] += (bottom - center + h_y * top) / (h_y * h_y);
-				} else {
-					f_ptr[index(n, xi, yi, n - 1)] += (bottom - 3 * center + 2 * top) / (h_y * h_y);
-				}
+				double center = row[xi];
+				f_row[xi]     = (row[xi - 1] - 2 * center + row[xi + 1]) * ih_x2
+				            + (row[xi - y_step] - 2 * center + row[xi + y_step]) * ih_y2
+				            + (row[xi - z_step] - 2 * center + row[xi + z_step]) * ih_z2;
 			}
 		}
-		VecRestoreArray(gamma, &gamma_view);
-		VecRestoreArrayRead(u, &u_view);
-		VecRestoreArray(f, &f_view);
 	}
-};
+}
 #endif
@@ -0,0 +1,235 @@
+/***************************************************************************
+ *  Thunderegg, a library for solving Poisson's equation on adaptively 
+ *  refined block-structured Cartesian grids
+ *
+ *  Copyright (C) 2019  Thunderegg Developers. See AUTHORS.md file at the
+ *  top-level directory.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef SPARSEEXCHANGE_H
+#define SPARSEEXCHANGE_H
+#include <algorithm>
+#include <map>
+#include <mpi.h>
+#include <vector>
+namespace Utils
+{
+/**
+ * @brief The private communicator that sparseExchange sends on for a user communicator, and the
+ * number of exchanges that have been done on it
+ */
+struct SparseExchangeComm {
+	MPI_Comm comm;
+	int      exchange_num;
+};
+/**
+ * @brief Free a SparseExchangeComm when the communicator it is attached to is freed
+ */
+inline int freeSparseExchangeComm(MPI_Comm comm, int keyval, void *attr, void *extra_state)
+{
+	SparseExchangeComm *exchange_comm = (SparseExchangeComm *) attr;
+	MPI_Comm_free(&exchange_comm->comm);
+	delete exchange_comm;
+	return MPI_SUCCESS;
+}
+/**
+ * @brief Get the SparseExchangeComm of a communicator. This is collective the first time it is
+ * called for a communicator.
+ *
+ * The private communicator is a duplicate of comm that is cached as an attribute of comm, so that
+ * the messages of sparseExchange can not match other messages on comm. It is not copied when comm
+ * is duplicated.
+ */
+inline SparseExchangeComm &getSparseExchangeComm(MPI_Comm comm)
+{
+	static int keyval = MPI_KEYVAL_INVALID;
+	if (keyval == MPI_KEYVAL_INVALID) {
+		MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, freeSparseExchangeComm, &keyval, nullptr);
+	}
+	SparseExchangeComm *exchange_comm;
+	int                 found;
+	MPI_Comm_get_attr(comm, keyval, &exchange_comm, &found);
+	if (!found) {
+		exchange_comm               = new SparseExchangeComm();
+		exchange_comm->exchange_num = 0;
+		MPI_Comm_dup(comm, &exchange_comm->comm);
+		MPI_Comm_set_attr(comm, keyval, exchange_comm);
+	}
+	return *exchange_comm;
+}
+/**
+ * @brief Send a buffer to each of a set of ranks that is only known to the sender, and receive
+ * the buffers that other ranks send to this one. This is collective.
+ *
+ * This uses the nonblocking consensus (NBX) algorithm: the buffers are sent with synchronous
+ * sends, incoming messages are received as they are probed, and once all of the sends on a rank
+ * have been matched it enters a nonblocking barrier. When the barrier completes every message has
+ * been received. The cost depends on the number of ranks that are communicated with, plus a
+ * barrier, rather than on the total number of ranks.
+ *
+ * @param sends the buffer for each destination rank
+ * @param comm the communicator
+ *
+ * @return the buffer from each rank that sent one
+ */
+inline std::map<int, std::vector<char>>
+sparseExchange(const std::map<int, std::vector<char>> &sends, MPI_Comm comm = MPI_COMM_WORLD)
+{
+	// alternate between two tags on the private communicator. A rank can still be probing in one
+	// exchange after another rank has left it, but a rank can only start a second exchange after
+	// every rank has entered the barrier of the previous one, so the messages of consecutive
+	// exchanges are never confused.
+	SparseExchangeComm &exchange_comm = getSparseExchangeComm(comm);
+	int                 tag           = exchange_comm.exchange_num % 2;
+	exchange_comm.exchange_num++;
+	comm = exchange_comm.comm;
+
+	std::vector<MPI_Request> send_requests;
+	send_requests.reserve(sends.size());
+	for (auto &p : sends) {
+		MPI_Request request;
+		MPI_Issend(const_cast<char *>(p.second.data()), p.second.size(), MPI_CHAR, p.first, tag,
+		           comm, &request);
+		send_requests.push_back(request);
+	}
+
+	std::map<int, std::vector<char>> recvs;
+	MPI_Request                      barrier;
+	bool                             in_barrier = false;
+	while (true) {
+		int        is_message;
+		MPI_Status status;
+		MPI_Iprobe(MPI_ANY_SOURCE, tag, comm, &is_message, &status);
+		if (is_message) {
+			int size;
+			MPI_Get_count(&status, MPI_CHAR, &size);
+			std::vector<char> &buffer = recvs[status.MPI_SOURCE];
+			buffer.resize(size);
+			MPI_Recv(buffer.data(), size, MPI_CHAR, status.MPI_SOURCE, tag, comm,
+			         MPI_STATUS_IGNORE);
+		}
+		if (in_barrier) {
+			int done;
+			MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+			if (done) { break; }
+		} else {
+			int sent;
+			MPI_Testall(send_requests.size(), send_requests.data(), &sent, MPI_STATUSES_IGNORE);
+			if (sent) {
+				MPI_Ibarrier(comm, &barrier);
+				in_barrier = true;
+			}
+		}
+	}
+	return recvs;
+}
+/**
+ * @brief sparseExchange for vectors of a trivially copyable type
+ *
+ * @param sends the values for each destination rank
+ * @param comm the communicator
+ *
+ * @return the values from each rank that sent any
+ */
+template <typename T>
+inline std::map<int, std::vector<T>> sparseExchange(const std::map<int, std::vector<T>> &sends,
+                                                    MPI_Comm comm = MPI_COMM_WORLD)
+{
+	std::map<int, std::vector<char>> byte_sends;
+	for (auto &p : sends) {
+		const char *begin = (const char *) p.second.data();
+		byte_sends[p.first].assign(begin, begin + p.second.size() * sizeof(T));
+	}
+	std::map<int, std::vector<T>> recvs;
+	for (auto &p : sparseExchange(byte_sends, comm)) {
+		std::vector<T> &values = recvs[p.first];
+		values.resize(p.second.size() / sizeof(T));
+		std::copy(p.second.begin(), p.second.end(), (char *) values.data());
+	}
+	return recvs;
+}
+/**
+ * @brief Look up the values of keys that may be owned by any rank. This is collective.
+ *
+ * Each key is registered with, and looked up from, the rank key % size, so only two sparse
+ * exchanges are needed and the work is spread over all of the ranks.
+ *
+ * @param owned the keys that this rank owns, and their values
+ * @param wanted the keys that this rank needs the values of
+ * @param comm the communicator
+ *
+ * @return the value of each wanted key
+ */
+inline std::map<int, int> sparseLookup(const std::map<int, int> &owned,
+                                       const std::vector<int> &wanted,
+                                       MPI_Comm comm = MPI_COMM_WORLD)
+{
+	int size;
+	MPI_Comm_size(comm, &size);
+
+	// each message is the number of owned pairs, the pairs, and then the wanted keys
+	std::map<int, std::vector<int>> pairs;
+	std::map<int, std::vector<int>> keys;
+	for (auto &p : owned) {
+		std::vector<int> &dest_pairs = pairs[p.first % size];
+		dest_pairs.push_back(p.first);
+		dest_pairs.push_back(p.second);
+	}
+	for (int key : wanted) {
+		keys[key % size].push_back(key);
+	}
+	std::map<int, std::vector<int>> requests;
+	for (auto &p : pairs) {
+		std::vector<int> &request = requests[p.first];
+		request.push_back(p.second.size() / 2);
+		request.insert(request.end(), p.second.begin(), p.second.end());
+	}
+	for (auto &p : keys) {
+		std::vector<int> &request = requests[p.first];
+		if (request.empty()) { request.push_back(0); }
+		request.insert(request.end(), p.second.begin(), p.second.end());
+	}
+	std::map<int, std::vector<int>> received = sparseExchange(requests, comm);
+
+	// register everything before answering, the owner of a key may not have sent it yet
+	std::map<int, int> directory;
+	for (auto &p : received) {
+		std::vector<int> &request   = p.second;
+		int               num_pairs = request[0];
+		for (int i = 0; i < num_pairs; i++) {
+			directory[request[1 + 2 * i]] = request[2 + 2 * i];
+		}
+	}
+	std::map<int, std::vector<int>> replies;
+	for (auto &p : received) {
+		std::vector<int> &request   = p.second;
+		int               num_pairs = request[0];
+		for (size_t i = 1 + 2 * num_pairs; i < request.size(); i++) {
+			replies[p.first].push_back(request[i]);
+			replies[p.first].push_back(directory.at(request[i]));
+		}
+	}
+
+	std::map<int, int> values;
+	for (auto &p : sparseExchange(replies, comm)) {
+		for (size_t i = 0; i < p.second.size(); i += 2) {
+			values[p.second[i]] = p.second[i + 1];
+		}
+	}
+	return values;
+}
+} // namespace Utils
+#endif
@@ -21,7 +21,9 @@
 
 #ifndef TIMER_H
 #define TIMER_H
+#include <algorithm>
 #include <chrono>
+#include <iostream>
 #include <map>
 #include <string>
 #include <vector>
@@ -36,6 +38,7 @@ class Timer
 	vector<string>                        order;
 	map<string, vector<double>>           times;
 	map<string, steady_clock::time_point> starts;
+	vector<pair<string, string>>          notes;
 
 	public:
 	void start(string name)
@@ -52,12 +55,25 @@ class Timer
 		if (std::find(order.begin(), order.end(), name) == order.end()) { order.push_back(name); }
 		if (verbose) { cout << "Stopped " << name << endl; }
 	}
+	/**
+	 * @brief Add a note that is printed along with the timing results, such as a setting that was
+	 * picked at run time.
+	 */
+	void addNote(string name, string note)
+	{
+		notes.push_back(make_pair(name, note));
+	}
 	friend ostream &operator<<(ostream &os, const Timer &timer)
 	{
 		os << endl;
 		os << "TIMING RESULTS" << endl;
 		os << "==============" << endl << endl;
 
+		for (const pair<string, string> &note : timer.notes) {
+			os << note.first << ": " << note.second << endl;
+		}
+		if (!timer.notes.empty()) { os << endl; }
+
 		for (string name : timer.order) {
 			vector<double> times = timer.times.at(name);
 
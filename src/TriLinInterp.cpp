@@ -22,142 +22,88 @@
 #include "TriLinInterp.h"
 #include "Utils.h"
 using namespace Utils;
-void TriLinInterp::interpolate(SchurDomain<3> &d, const Vec u, Vec interp)
+template <int N>
+template <int S>
+void TriLinInterp::InterpolateKernel<N>::visit()
 {
-	for (Side<3> s : Side<3>::getValues()) {
-		if (d.hasNbr(s)) {
-			std::deque<int>       idx;
-			std::deque<IfaceType> types;
-			d.getIfaceInfoPtr(s)->getIdxAndTypes(idx, types);
-			for (size_t i = 0; i < idx.size(); i++) {
-				interpolate(d, s, idx[i], types[i], u, interp);
-			}
-		}
-	}
-}
-void TriLinInterp::interpolate(SchurDomain<3> &d, Side<3> s, int local_index, IfaceType itype,
-                               const Vec u, Vec interp)
-{
-	int     n = d.n;
-	double *interp_view;
-	VecGetArray(interp, &interp_view);
-	double *      u_view;
-	const double *const_u_view;
-	VecGetArrayRead(u, &const_u_view);
-	u_view  = const_cast<double *>(const_u_view);
-	int idx = local_index * n * n;
+	// a compile-time constant in the specialized kernels
+	const int                       n = patchSize<N>(this->n);
+	FaceView<3, S, N, const double> face(patch, n);
+	// the quadrant of the coarse face that a fine face is on
+	int x_off = (itype.getOrthant() & 0b01) ? n : 0;
+	int y_off = (itype.getOrthant() & 0b10) ? n : 0;
 	switch (itype.toInt()) {
-		case IfaceType::normal: {
-			Slice<2> sl = getSlice(d, u_view, s);
+		case IfaceType::normal:
 			for (int yi = 0; yi < n; yi++) {
+#pragma omp simd
 				for (int xi = 0; xi < n; xi++) {
-					interp_view[idx + xi + yi * n] += 0.5 * sl({xi, yi});
+					interp[xi + yi * n] += 0.5 * face(xi, yi);
 				}
 			}
-		} break;
-		case IfaceType::fine_to_fine: {
-			Slice<2> sl = getSlice(d, u_view, s);
+			break;
+		case IfaceType::fine_to_fine:
 			for (int yi = 0; yi < n / 2; yi++) {
+				double *lower = interp + (yi * 2) * n;
+				double *upper = interp + (yi * 2 + 1) * n;
 				for (int xi = 0; xi < n / 2; xi++) {
-					double a = sl({xi * 2, yi * 2});
-					double b = sl({xi * 2 + 1, yi * 2});
-					double c = sl({xi * 2, yi * 2 + 1});
-					double d = sl({xi * 2 + 1, yi * 2 + 1});
-					interp_view[idx + (xi * 2) + (yi * 2) * n] += (11 * a - b - c - d) / 12.0;
-					interp_view[idx + (xi * 2 + 1) + (yi * 2) * n] += (-a + 11 * b - c - d) / 12.0;
-					interp_view[idx + (xi * 2) + (yi * 2 + 1) * n] += (-a - b + 11 * c - d) / 12.0;
-					interp_view[idx + (xi * 2 + 1) + (yi * 2 + 1) * n]
-					+= (-a - b - c + 11 * d) / 12.0;
+					double a = face(xi * 2, yi * 2);
+					double b = face(xi * 2 + 1, yi * 2);
+					double c = face(xi * 2, yi * 2 + 1);
+					double d = face(xi * 2 + 1, yi * 2 + 1);
+					lower[xi * 2] += (11 * a - b - c - d) / 12.0;
+					lower[xi * 2 + 1] += (-a + 11 * b - c - d) / 12.0;
+					upper[xi * 2] += (-a - b + 11 * c - d) / 12.0;
+					upper[xi * 2 + 1] += (-a - b - c + 11 * d) / 12.0;
 				}
 			}
-		} break;
+			break;
 		case IfaceType::coarse_to_fine:
-			switch (itype.getOrthant()) {
-				case 0: {
-					Slice<2> sl = getSlice(d, u_view, s);
-					for (int yi = 0; yi < n; yi++) {
-						for (int xi = 0; xi < n; xi++) {
-							interp_view[idx + xi + yi * n] += 4.0 * sl({(xi) / 2, (yi) / 2}) / 12.0;
-						}
-					}
-				} break;
-				case 1: {
-					Slice<2> sl = getSlice(d, u_view, s);
-					for (int yi = 0; yi < n; yi++) {
-						for (int xi = 0; xi < n; xi++) {
-							interp_view[idx + xi + yi * n]
-							+= 4.0 * sl({(xi + n) / 2, (yi) / 2}) / 12.0;
-						}
-					}
-				} break;
-				case 2: {
-					Slice<2> sl = getSlice(d, u_view, s);
-					for (int yi = 0; yi < n; yi++) {
-						for (int xi = 0; xi < n; xi++) {
-							interp_view[idx + xi + yi * n]
-							+= 4.0 * sl({(xi) / 2, (yi + n) / 2}) / 12.0;
-						}
-					}
-				} break;
-				case 3: {
-					Slice<2> sl = getSlice(d, u_view, s);
-					for (int yi = 0; yi < n; yi++) {
-						for (int xi = 0; xi < n; xi++) {
-							interp_view[idx + xi + yi * n]
-							+= 4.0 * sl({(xi + n) / 2, (yi + n) / 2}) / 12.0;
-						}
-					}
-				} break;
+			for (int yi = 0; yi < n; yi++) {
+				for (int xi = 0; xi < n; xi++) {
+					interp[xi + yi * n] += 4.0 * face((xi + x_off) / 2, (yi + y_off) / 2) / 12.0;
+				}
 			}
 			break;
-		case IfaceType::coarse_to_coarse: {
-			Slice<2> sl = getSlice(d, u_view, s);
+		case IfaceType::coarse_to_coarse:
 			for (int yi = 0; yi < n; yi++) {
+#pragma omp simd
 				for (int xi = 0; xi < n; xi++) {
-					interp_view[idx + xi + yi * n] += 2.0 / 6.0 * sl({xi, yi});
+					interp[xi + yi * n] += 2.0 / 6.0 * face(xi, yi);
 				}
 			}
-		} break;
+			break;
 		case IfaceType::fine_to_coarse:
-			switch (itype.getOrthant()) {
-				case 0: {
-					Slice<2> sl = getSlice(d, u_view, s);
-					for (int yi = 0; yi < n; yi++) {
-						for (int xi = 0; xi < n; xi++) {
-							interp_view[idx + (xi) / 2 + (yi) / 2 * n] += 1.0 / 6.0 * sl({xi, yi});
-						}
-					}
-				} break;
-				case 1: {
-					Slice<2> sl = getSlice(d, u_view, s);
-					for (int yi = 0; yi < n; yi++) {
-						for (int xi = 0; xi < n; xi++) {
-							interp_view[idx + (xi + n) / 2 + (yi) / 2 * n]
-							+= 1.0 / 6.0 * sl({xi, yi});
-						}
-					}
-				} break;
-				case 2: {
-					Slice<2> sl = getSlice(d, u_view, s);
-					for (int yi = 0; yi < n; yi++) {
-						for (int xi = 0; xi < n; xi++) {
-							interp_view[idx + (xi) / 2 + (yi + n) / 2 * n]
-							+= 1.0 / 6.0 * sl({xi, yi});
-						}
-					}
-				} break;
-				case 3: {
-					Slice<2> sl = getSlice(d, u_view, s);
-					for (int yi = 0; yi < n; yi++) {
-						for (int xi = 0; xi < n; xi++) {
-							interp_view[idx + (xi + n) / 2 + (yi + n) / 2 * n]
-							+= 1.0 / 6.0 * sl({xi, yi});
-						}
-					}
-				} break;
+			for (int yi = 0; yi < n; yi++) {
+				double *out = interp + (yi + y_off) / 2 * n;
+				for (int xi = 0; xi < n; xi++) {
+					out[(xi + x_off) / 2] += 1.0 / 6.0 * face(xi, yi);
+				}
 			}
 			break;
 	}
-	VecRestoreArray(interp, &interp_view);
-	VecRestoreArrayRead(u, &const_u_view);
+}
+template <int N>
+void TriLinInterp::InterpolateKernel<N>::run(int n, const PatchTable<3>::FacePlan &plan,
+                                             IfaceType itype, const double *u_view,
+                                             double *interp_view)
+{
+	InterpolateKernel<N> kernel
+	= {patchSize<N>(n), itype, u_view + plan.patch_start, interp_view + plan.interp_start};
+	visitSide(plan.side, kernel);
+}
+void TriLinInterp::interpolatePatch(const PatchTable<3> &patches, int patch,
+                                    const double *u_view, double *interp_view)
+{
+	int                            n      = patches.getN();
+	InterpolateKernel<0>::Function kernel = getKernel<InterpolateKernel>(n, specialized);
+	for (int i = patches.interpBegin(patch); i < patches.interpEnd(patch); i++) {
+		kernel(n, patches.getInterpPlan(i), patches.getInterpType(i), u_view, interp_view);
+	}
+}
+void TriLinInterp::interpolateIface(const PatchTable<3> &patches, int patch, Side<3> s,
+                                    int local_index, IfaceType itype, const double *u_view,
+                                    double *interp_view)
+{
+	getKernel<InterpolateKernel>(patches.getN(), specialized)(
+	patches.getN(), patches.getFacePlan(patch, s, local_index), itype, u_view, interp_view);
 }
@@ -21,12 +21,73 @@
 
 #ifndef UTILS_H
 #define UTILS_H
+#include "PatchTable.h"
 #include "SchurDomain.h"
 #include <array>
 #include <numeric>
 #include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 namespace Utils
 {
+/**
+ * @brief Get the number of the calling thread, always 0 when not built with OpenMP
+ */
+inline int getThreadNum()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+/**
+ * @brief Get the maximum number of threads that a parallel region will use
+ */
+inline int getMaxThreads()
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+/**
+ * @brief The patch size that a kernel compiled for size N works on
+ *
+ * @tparam N the compiled patch size, or 0 for a kernel that takes the size at runtime
+ * @param n the runtime patch size
+ */
+template <int N> inline int patchSize(int n)
+{
+	return N == 0 ? n : N;
+}
+/**
+ * @brief Select the version of a kernel that is compiled for a patch size
+ *
+ * Kernel<N>::run is the kernel for patches with N cells in each direction, and Kernel<0>::run is
+ * the generic kernel that reads the size at runtime. Kernel<0>::Function is the type of run.
+ * Kernels are compiled for the patch sizes 8, 16 and 32, other sizes use the generic kernel.
+ *
+ * @param n the patch size
+ * @param specialized false to always use the generic kernel
+ */
+template <template <int> class Kernel>
+inline typename Kernel<0>::Function getKernel(int n, bool specialized = true)
+{
+	if (specialized) {
+		switch (n) {
+			case 8:
+				return &Kernel<8>::run;
+			case 16:
+				return &Kernel<16>::run;
+			case 32:
+				return &Kernel<32>::run;
+		}
+	}
+	return &Kernel<0>::run;
+}
 inline int index(const int &n, const int &xi, const int &yi, const int &zi)
 {
 	return xi + yi * n + zi * n * n;
@@ -35,47 +96,235 @@ inline int index(const int &n, const int &xi, const int &yi)
 {
 	return xi + yi * n;
 }
-template <size_t D>
-class Slice
+/**
+ * @brief A view of the cells on one side of a patch
+ *
+ * The side and, optionally, the patch size are template parameters, so the strides are
+ * compile-time constants and the iterator only increments a pointer. The cells are visited in the
+ * same order as the interface values: the axes of the patch in order, with the axis of the side
+ * left out, and the lowest axis the fastest.
+ *
+ * @tparam D the dimension of the patch, 2 or 3
+ * @tparam S the side, as given by Side<D>::toInt
+ * @tparam N the number of cells in each direction, or 0 if it is only known at runtime
+ * @tparam T double, or const double for a view that is only read
+ */
+template <size_t D, int S, int N = 0, typename T = double> class FaceView
 {
+	static_assert(D == 2 || D == 3, "faces are only implemented for 2d and 3d patches");
+	static_assert(S >= 0 && S < (int) (2 * D), "not a side of the patch");
+
 	private:
-	double *start;
-    std::array<int,D> strides;
+	T * start;
+	int n;
+
+	static int power(int n, int k)
+	{
+		int retval = 1;
+		for (int i = 0; i < k; i++) {
+			retval *= n;
+		}
+		return retval;
+	}
 
 	public:
-	inline Slice() {}
-	inline Slice(double *start, std::array<int,D> strides)
+	/**
+	 * @brief The axis of the patch that the side is on
+	 */
+	static constexpr int axis = S / 2;
+	/**
+	 * @brief Create a view of one side of a patch
+	 *
+	 * @param patch the first cell of the patch
+	 * @param n the number of cells in each direction
+	 */
+	FaceView(T *patch, int n) : n(patchSize<N>(n))
+	{
+		start = patch + ((S & 0x1) ? (this->n - 1) * power(this->n, axis) : 0);
+	}
+	int getN() const
+	{
+		return n;
+	}
+	/**
+	 * @brief Get the number of cells in the face
+	 */
+	int size() const
+	{
+		return power(n, D - 1);
+	}
+	/**
+	 * @brief Get the distance between neighboring cells along an axis of the face
+	 */
+	int getStride(int face_axis) const
+	{
+		return power(n, face_axis < axis ? face_axis : face_axis + 1);
+	}
+	T &operator()(int xi) const
 	{
-		this->start   = start;
-		this->strides = strides;
+		return start[xi * getStride(0)];
 	}
-	inline double &operator()(std::array<int,D> coord)
+	T &operator()(int xi, int yi) const
 	{
-		return start[std::inner_product(strides.begin(),strides.end(),coord.begin(),0)];
+		return start[xi * getStride(0) + yi * getStride(1)];
 	}
+	/**
+	 * @brief Visits the cells of the face in order, rows along the first axis of the face
+	 */
+	class iterator
+	{
+		private:
+		T * ptr;
+		int col;
+		int n;
+		int col_stride;
+		int row_step;
+
+		public:
+		iterator(T *ptr, int n, int col_stride, int row_step)
+		: ptr(ptr), col(0), n(n), col_stride(col_stride), row_step(row_step)
+		{
+		}
+		T &operator*() const
+		{
+			return *ptr;
+		}
+		iterator &operator++()
+		{
+			ptr += col_stride;
+			if (++col == n) {
+				col = 0;
+				ptr += row_step;
+			}
+			return *this;
+		}
+		bool operator!=(const iterator &other) const
+		{
+			return ptr != other.ptr;
+		}
+	};
+	iterator begin() const
+	{
+		return iterator(start, n, getStride(0), rowStep());
+	}
+	iterator end() const
+	{
+		return iterator(start + n * getStride(D - 2), n, getStride(0), rowStep());
+	}
+
+	private:
+	/**
+	 * @brief The step from the end of one row of the face to the start of the next
+	 */
+	int rowStep() const
+	{
+		return D == 2 ? 0 : getStride(D - 2) - n * getStride(0);
+	}
+};
+/**
+ * @brief Calls visitor.template visit<S>() for the side S that a runtime side is
+ */
+template <size_t D, int S = 0, bool end = (S == 2 * D)> struct SideSwitch {
+	template <class Visitor> static void visit(Side<D> s, Visitor &visitor)
+	{
+		if (s.toInt() == S) {
+			visitor.template visit<S>();
+		} else {
+			SideSwitch<D, S + 1>::visit(s, visitor);
+		}
+	}
+};
+template <size_t D, int S> struct SideSwitch<D, S, true> {
+	template <class Visitor> static void visit(Side<D>, Visitor &) {}
 };
-template <size_t D>
-inline Slice<D> getSlice(double *u_view, int n, Side<D+1> s)
+/**
+ * @brief Call visitor.template visit<S>() with the side as a compile-time constant, so that the
+ * visitor can use a FaceView
+ */
+template <size_t D, class Visitor> inline void visitSide(Side<D> s, Visitor &visitor)
+{
+	SideSwitch<D>::visit(s, visitor);
+}
+/**
+ * @brief Adds scale * values to the cells of one side of a patch
+ */
+template <size_t D, int N = 0> struct FaceAdder {
+	double *      patch;
+	int           n;
+	double        scale;
+	const double *values;
+	template <int S> void visit()
+	{
+		const double *value = values;
+		for (double &cell : FaceView<D, S, N>(patch, n)) {
+			cell += scale * *value++;
+		}
+	}
+};
+/**
+ * @brief Copies values into the cells of one side of a patch
+ */
+template <size_t D, int N = 0> struct FaceWriter {
+	double *      patch;
+	int           n;
+	const double *values;
+	template <int S> void visit()
+	{
+		const double *value = values;
+		for (double &cell : FaceView<D, S, N>(patch, n)) {
+			cell = *value++;
+		}
+	}
+};
+/**
+ * @brief Copies the cells of one side of a patch into values
+ */
+template <size_t D, int N = 0> struct FaceReader {
+	const double *patch;
+	int           n;
+	double *      values;
+	template <int S> void visit()
+	{
+		double *value = values;
+		for (const double &cell : FaceView<D, S, N, const double>(patch, n)) {
+			*value++ = cell;
+		}
+	}
+};
+/**
+ * @brief Add scale * values to the cells on one side of a patch, the values are in the order of
+ * FaceView
+ *
+ * @tparam N the patch size if it is known at compile time, otherwise 0
+ * @param patch the first cell of the patch
+ * @param n the number of cells in each direction
+ * @param s the side
+ * @param scale the scale of the values
+ * @param values the values, one for each cell of the face
+ */
+template <size_t D, int N = 0>
+inline void addToFace(double *patch, int n, Side<D> s, double scale, const double *values)
+{
+	FaceAdder<D, N> adder = {patch, n, scale, values};
+	visitSide(s, adder);
+}
+/**
+ * @brief Set the cells on one side of a patch, the values are in the order of FaceView
+ */
+template <size_t D, int N = 0>
+inline void copyToFace(double *patch, int n, Side<D> s, const double *values)
 {
-	Slice<D> retval;
-    std::array<int,D> strides;
-    for(int i=0;i<s.toInt()/2;i++){
-        strides[i]=std::pow(n,i);
-    }
-    for(int i = s.toInt()/2;i<(int)D;i++){
-        strides[i]=std::pow(n,i+1);
-    }
-    if(s.isLowerOnAxis()){
-        retval = Slice<D>(&u_view[0],strides);
-    }else{
-        retval = Slice<D>(&u_view[(n-1)*(int)std::pow(n,s.toInt()/2)],strides);
-    }
-	return retval;
+	FaceWriter<D, N> writer = {patch, n, values};
+	visitSide(s, writer);
 }
-template <size_t D> inline Slice<D-1> getSlice(SchurDomain<D> &d, double *u_view, Side<D> s)
+/**
+ * @brief Copy the cells on one side of a patch out, the values are in the order of FaceView
+ */
+template <size_t D, int N = 0>
+inline void copyFromFace(const double *patch, int n, Side<D> s, double *values)
 {
-	int start = d.local_index * std::pow(d.n,D);
-	return getSlice<D-1>(&u_view[start], d.n, s);
+	FaceReader<D, N> reader = {patch, n, values};
+	visitSide(s, reader);
 }
 } // namespace Utils
 #endif
@@ -0,0 +1,116 @@
+#include "../IdIndex.h"
+#include "catch.hpp"
+#include <climits>
+#include <vector>
+using namespace std;
+/**
+ * @brief the slot that IdIndex tries first for a key, for a table of 16 slots
+ */
+static size_t homeSlot(int key)
+{
+	uint64_t hash = (uint64_t)(uint32_t) key * 11400714819323198485ull;
+	return (hash >> 32) & 15;
+}
+/**
+ * @brief find keys that start probing at the same slot of a table of 16 slots
+ */
+static vector<int> getKeysInSlot(size_t slot, size_t count)
+{
+	vector<int> keys;
+	for (int key = 0; keys.size() < count; key++) {
+		if (homeSlot(key) == slot) { keys.push_back(key); }
+	}
+	return keys;
+}
+TEST_CASE("IdIndex is empty when created", "[IdIndex]")
+{
+	IdIndex index;
+	CHECK(index.size() == 0);
+	CHECK(index.count(0) == 0);
+	CHECK(index.count(-1) == 0);
+	CHECK_THROWS_AS(index.at(0), std::out_of_range);
+}
+TEST_CASE("IdIndex operator[] inserts a key once", "[IdIndex]")
+{
+	IdIndex index;
+	CHECK(index[5] == 0);
+	CHECK(index.size() == 1);
+	index[5] = 3;
+	CHECK(index[5] == 3);
+	CHECK(index.size() == 1);
+	CHECK(index.count(5) == 1);
+	CHECK(index.at(5) == 3);
+	CHECK(index.count(6) == 0);
+	CHECK_THROWS_AS(index.at(6), std::out_of_range);
+}
+TEST_CASE("IdIndex handles keys that collide", "[IdIndex]")
+{
+	// 7 keys fit in 16 slots without growing
+	vector<int> keys = getKeysInSlot(3, 7);
+	IdIndex     index;
+	for (size_t i = 0; i < 6; i++) {
+		index[keys[i]] = 100 + i;
+	}
+	CHECK(index.size() == 6);
+	for (size_t i = 0; i < 6; i++) {
+		CHECK(index.count(keys[i]) == 1);
+		CHECK(index.at(keys[i]) == 100 + (int) i);
+	}
+	// a missing key has to probe past all of the keys in the slot
+	CHECK(index.count(keys[6]) == 0);
+	CHECK_THROWS_AS(index.at(keys[6]), std::out_of_range);
+}
+TEST_CASE("IdIndex wraps around at the end of the table", "[IdIndex]")
+{
+	vector<int> keys      = getKeysInSlot(15, 4);
+	vector<int> keys_in_0 = getKeysInSlot(0, 1);
+	IdIndex     index;
+	for (size_t i = 0; i < 3; i++) {
+		index[keys[i]] = 200 + i;
+	}
+	// the wrapped keys are in slots 0 and 1, so a key that starts at 0 has to probe past them
+	index[keys_in_0[0]] = 300;
+	CHECK(index.size() == 4);
+	for (size_t i = 0; i < 3; i++) {
+		CHECK(index.at(keys[i]) == 200 + (int) i);
+	}
+	CHECK(index.at(keys_in_0[0]) == 300);
+	CHECK(index.count(keys[3]) == 0);
+	CHECK_THROWS_AS(index.at(keys[3]), std::out_of_range);
+}
+TEST_CASE("IdIndex keeps its values when it grows", "[IdIndex]")
+{
+	IdIndex index;
+	int     num_keys = 10000;
+	for (int i = 0; i < num_keys; i++) {
+		// spread out keys, negative keys, and the largest key
+		int key    = i == 0 ? INT_MAX : (i % 2 == 0 ? 7 * i : -i);
+		index[key] = i;
+		if (i % 1000 == 0) { REQUIRE(index.size() == (size_t) i + 1); }
+	}
+	CHECK(index.size() == (size_t) num_keys);
+	for (int i = 0; i < num_keys; i++) {
+		int key = i == 0 ? INT_MAX : (i % 2 == 0 ? 7 * i : -i);
+		REQUIRE(index.count(key) == 1);
+		REQUIRE(index.at(key) == i);
+	}
+	CHECK(index.count(7 * 10001) == 0);
+	CHECK(index.count(-10001) == 0);
+}
+TEST_CASE("IdIndex keeps its values when more room is reserved", "[IdIndex]")
+{
+	IdIndex index(4);
+	for (int i = 0; i < 4; i++) {
+		index[i * 16] = i + 1;
+	}
+	index.reserve(1000);
+	CHECK(index.size() == 4);
+	for (int i = 0; i < 4; i++) {
+		CHECK(index.at(i * 16) == i + 1);
+	}
+	// reserving less room than there is does not shrink the table
+	index.reserve(1);
+	for (int i = 0; i < 4; i++) {
+		CHECK(index.at(i * 16) == i + 1);
+	}
+}
@@ -0,0 +1,123 @@
+#include "../BalancedLevelsGenerator.h"
+#include "../FivePtPatchOperator.h"
+#include "../PatchSolvers/DftPatchSolver.h"
+#include "../SchurHelper.h"
+#include "../SevenPtPatchOperator.h"
+#include "catch.hpp"
+using namespace std;
+/**
+ * @brief An operator with only the direct stencil, so the padded path uses the default
+ * applyPaddedPatch
+ */
+template <size_t D, class Op> class DirectOnly : public PatchOperator<D>
+{
+	private:
+	Op op;
+
+	public:
+	void applyPatch(const PatchTable<D> &patches, int patch, const double *u_view,
+	                const double *gamma_view, double *f_view)
+	{
+		op.applyPatch(patches, patch, u_view, gamma_view, f_view);
+	}
+};
+/**
+ * @brief Check that the padded path gives the same f as the direct one, on random u and gamma
+ */
+template <size_t D>
+static void checkPadded(PatchOperator<D> &op, Tree<D> t, int n, bool neumann)
+{
+	BalancedLevelsGenerator<D> blg(t, n);
+	DomainCollection<D>        dc(blg.levels[t.num_levels - 1], n);
+	if (neumann) { dc.setNeumann(); }
+	shared_ptr<PatchSolver<D>> solver(new DftPatchSolver<D>(dc));
+	SchurHelper<D>             sch(dc, solver, nullptr, nullptr);
+
+	const PatchTable<D> &table    = sch.getPatchTable();
+	PW<Vec>              u        = dc.getNewDomainVec();
+	PW<Vec>              gamma    = sch.getNewSchurDistVec();
+	PW<Vec>              f        = dc.getNewDomainVec();
+	PW<Vec>              f_padded = dc.getNewDomainVec();
+	VecSetRandom(u, nullptr);
+	VecSetRandom(gamma, nullptr);
+	PatchArray<D> padded(n, table.size());
+
+	op.apply(table, u, gamma, f);
+	op.apply(table, padded, u, gamma, f_padded);
+
+	double f_norm, diff_norm;
+	VecNorm(f, NORM_INFINITY, &f_norm);
+	VecAXPY(f_padded, -1.0, f);
+	VecNorm(f_padded, NORM_INFINITY, &diff_norm);
+	CHECK(diff_norm <= 1e-13 * f_norm);
+}
+TEST_CASE("Padded FivePtPatchOperator agrees with the direct one", "[PatchOperator]")
+{
+	FivePtPatchOperator                op;
+	DirectOnly<2, FivePtPatchOperator> direct_only;
+	for (bool neumann : {false, true}) {
+		// 8 has a compiled kernel, 6 uses the generic one
+		checkPadded(op, Tree<2>("2d2ref.bin"), 8, neumann);
+		checkPadded(op, Tree<2>("2d2ref.bin"), 6, neumann);
+		checkPadded(direct_only, Tree<2>("2d2ref.bin"), 6, neumann);
+	}
+}
+TEST_CASE("Padded SevenPtPatchOperator agrees with the direct one", "[PatchOperator]")
+{
+	SevenPtPatchOperator                op;
+	DirectOnly<3, SevenPtPatchOperator> direct_only;
+	for (bool neumann : {false, true}) {
+		checkPadded(op, Tree<3>("2refine.bin"), 8, neumann);
+		checkPadded(op, Tree<3>("2refine.bin"), 6, neumann);
+		checkPadded(direct_only, Tree<3>("2refine.bin"), 6, neumann);
+	}
+}
+TEST_CASE("PatchArray fills the ghost cells from gamma and the boundary", "[PatchArray]")
+{
+	// one 2D patch with an interface on the west side and neumann on the east side
+	int            n = 3;
+	SchurDomain<2> sd;
+	sd.n                              = n;
+	sd.domain.lengths[0]              = 1;
+	sd.domain.lengths[1]              = 1;
+	sd.neumann[Side<2>::east]         = true;
+	NormalIfaceInfo<2> west;
+	sd.getIfaceInfoPtr(Side<2>::west) = &west;
+	PatchTable<2> table;
+	table.addDomain(sd);
+
+	PW<Vec> u, gamma;
+	VecCreateSeq(PETSC_COMM_SELF, n * n, &u);
+	VecCreateSeq(PETSC_COMM_SELF, n, &gamma);
+	double *u_view, *gamma_view;
+	VecGetArray(u, &u_view);
+	for (int i = 0; i < n * n; i++) {
+		u_view[i] = i + 1;
+	}
+	VecRestoreArray(u, &u_view);
+	VecGetArray(gamma, &gamma_view);
+	for (int i = 0; i < n; i++) {
+		gamma_view[i] = 10 * (i + 1);
+	}
+	VecRestoreArray(gamma, &gamma_view);
+
+	PatchArray<2> padded(n, 1);
+	padded.fill(table, u, gamma);
+	const double *patch  = padded.getPatch(0);
+	int           y_step = padded.getStride(1);
+	for (int yi = 0; yi < n; yi++) {
+		const double *row = patch + yi * y_step;
+		for (int xi = 0; xi < n; xi++) {
+			CHECK(row[xi] == xi + yi * n + 1);
+		}
+		// west: -u + 2 gamma
+		CHECK(row[-1] == -row[0] + 2 * 10 * (yi + 1));
+		// east: neumann, u
+		CHECK(row[n] == row[n - 1]);
+	}
+	for (int xi = 0; xi < n; xi++) {
+		// south and north: dirichlet, -u
+		CHECK(patch[xi - y_step] == -patch[xi]);
+		CHECK(patch[xi + n * y_step] == -patch[xi + (n - 1) * y_step]);
+	}
+}
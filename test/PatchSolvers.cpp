@@ -0,0 +1,252 @@
+#include "../PatchSolvers/DftPatchSolver.h"
+#include "../PatchSolvers/FacrPatchSolver.h"
+#include "../PatchSolvers/FftwPatchSolver.h"
+#include "catch.hpp"
+#include <cmath>
+#include <deque>
+using namespace std;
+/**
+ * @brief Stand alone patches with every mix of Dirichlet, Neumann, and interface sides.
+ *
+ * Each mix is repeated for a few patches in a row, so that the batched solvers have runs of
+ * patches to batch. A side with an interface gets its own slice of gamma.
+ */
+template <size_t D> struct MixedPatches {
+	int                       n;
+	DomainCollection<D>       dc;
+	deque<SchurDomain<D>>     domains;
+	PW<Vec>                   f;
+	PW<Vec>                   gamma;
+	deque<NormalIfaceInfo<D>> ifaces;
+
+	MixedPatches(int n, int repeat = 3) : dc(map<int, shared_ptr<Domain<D>>>(), n)
+	{
+		this->n        = n;
+		int num_mixes  = pow(3, 2 * D);
+		int patch_size = pow(n, D);
+		int face_size  = pow(n, D - 1);
+		for (int mix = 0; mix < num_mixes; mix++) {
+			// 0 is dirichlet, 1 is neumann, and 2 is an interface
+			int  types[2 * D];
+			bool all_neumann = true;
+			for (size_t s = 0; s < 2 * D; s++) {
+				types[s] = mix / (int) pow(3, s) % 3;
+				all_neumann &= types[s] == 1;
+			}
+			// the pure neumann problem is only solvable up to a constant
+			if (all_neumann) { continue; }
+			for (int r = 0; r < repeat; r++) {
+				SchurDomain<D> sd;
+				sd.n           = n;
+				sd.local_index = domains.size();
+				for (size_t i = 0; i < D; i++) {
+					sd.domain.lengths[i] = 1.0 / (1 + (mix + i) % 2);
+				}
+				for (size_t s = 0; s < 2 * D; s++) {
+					sd.neumann[s] = types[s] == 1;
+					if (types[s] == 2) {
+						ifaces.emplace_back();
+						ifaces.back().local_index = ifaces.size() - 1;
+						sd.iface_info[s]          = &ifaces.back();
+					}
+				}
+				domains.push_back(sd);
+			}
+		}
+		VecCreateSeq(PETSC_COMM_SELF, domains.size() * patch_size, &f);
+		VecCreateSeq(PETSC_COMM_SELF, max(1, (int) ifaces.size()) * face_size, &gamma);
+		fill(f, 1.0);
+		fill(gamma, 2.0);
+	}
+	MixedPatches(const MixedPatches &) = delete;
+	MixedPatches &operator=(const MixedPatches &) = delete;
+	static void fill(Vec vec, double freq)
+	{
+		double *view;
+		int     size;
+		VecGetLocalSize(vec, &size);
+		VecGetArray(vec, &view);
+		for (int i = 0; i < size; i++) {
+			view[i] = sin(freq * i) + cos(0.1 * freq * i);
+		}
+		VecRestoreArray(vec, &view);
+	}
+	PW_explicit<Vec> getNewDomainVec()
+	{
+		PW<Vec> u;
+		VecDuplicate(f, &u);
+		VecSet(u, 0.0);
+		return u;
+	}
+	void solve(PatchSolver<D> &solver, Vec u)
+	{
+		for (SchurDomain<D> &sd : domains) {
+			solver.addDomain(sd);
+		}
+		solver.domainSolve(domains, f, u, gamma);
+	}
+};
+/**
+ * @brief Get the largest difference between two vectors, relative to the largest entry of a
+ */
+static double relDiff(Vec a, Vec b)
+{
+	double a_norm, diff_norm;
+	VecNorm(a, NORM_INFINITY, &a_norm);
+	PW<Vec> diff;
+	VecDuplicate(a, &diff);
+	VecCopy(a, diff);
+	VecAXPY(diff, -1.0, b);
+	VecNorm(diff, NORM_INFINITY, &diff_norm);
+	return diff_norm / a_norm;
+}
+template <size_t D> static void checkFacr()
+{
+	// 14 = 2 * 7 is a size that FACR is meant for
+	MixedPatches<D> patches(14, 1);
+	PW<Vec>         u_fftw = patches.getNewDomainVec();
+	PW<Vec>         u_facr = patches.getNewDomainVec();
+
+	FftwPatchSolver<D> fftw(patches.dc);
+	FacrPatchSolver<D> facr(patches.dc);
+	patches.solve(fftw, u_fftw);
+	patches.solve(facr, u_facr);
+
+	CHECK(relDiff(u_fftw, u_facr) < 1e-10);
+}
+TEST_CASE("FacrPatchSolver agrees with FftwPatchSolver on mixed sides", "[PatchSolver]")
+{
+	SECTION("2D")
+	{
+		checkFacr<2>();
+	}
+	SECTION("3D")
+	{
+		checkFacr<3>();
+	}
+}
+template <size_t D> static void checkDft()
+{
+	MixedPatches<D> patches(6);
+	PW<Vec>         u_batched   = patches.getNewDomainVec();
+	PW<Vec>         u_per_patch = patches.getNewDomainVec();
+	PW<Vec>         u_fftw      = patches.getNewDomainVec();
+
+	DftPatchSolver<D> dft(patches.dc);
+	patches.solve(dft, u_batched);
+	for (SchurDomain<D> &sd : patches.domains) {
+		dft.solve(sd, patches.f, u_per_patch, patches.gamma);
+	}
+	FftwPatchSolver<D> fftw(patches.dc);
+	patches.solve(fftw, u_fftw);
+
+	CHECK(relDiff(u_per_patch, u_batched) < 1e-12);
+	CHECK(relDiff(u_fftw, u_batched) < 1e-10);
+}
+TEST_CASE("DftPatchSolver batches agree with single patch solves", "[PatchSolver]")
+{
+	SECTION("2D")
+	{
+		checkDft<2>();
+	}
+	SECTION("3D")
+	{
+		checkDft<3>();
+	}
+}
+template <size_t D> static void checkFftwBatched(int n)
+{
+	MixedPatches<D> patches(n);
+	PW<Vec>         u_batched   = patches.getNewDomainVec();
+	PW<Vec>         u_per_patch = patches.getNewDomainVec();
+
+	FftwPatchSolver<D> batched(patches.dc);
+	batched.setBatched(true, 2);
+	patches.solve(batched, u_batched);
+	FftwPatchSolver<D> per_patch(patches.dc);
+	per_patch.setBatched(false);
+	patches.solve(per_patch, u_per_patch);
+
+	CHECK(relDiff(u_per_patch, u_batched) < 1e-12);
+}
+TEST_CASE("FftwPatchSolver batched plans agree with per patch plans", "[PatchSolver]")
+{
+	SECTION("2D")
+	{
+		checkFftwBatched<2>(6);
+		// a size that the kernels are compiled for
+		checkFftwBatched<2>(8);
+	}
+	SECTION("3D")
+	{
+		checkFftwBatched<3>(6);
+		checkFftwBatched<3>(8);
+	}
+}
+/**
+ * @brief Check that a trace solve agrees with a full solve with a zero rhs on the cells next to
+ * the sides with interfaces, which are the cells that the trace solve sets
+ */
+template <size_t D> static void checkTrace(PatchSolver<D> &solver, MixedPatches<D> &patches)
+{
+	int     n       = patches.n;
+	PW<Vec> zero    = patches.getNewDomainVec();
+	PW<Vec> u       = patches.getNewDomainVec();
+	PW<Vec> u_trace = patches.getNewDomainVec();
+	// the solve with f adds the domains to the solver, and leaves a nonzero u to overwrite
+	patches.solve(solver, u);
+	solver.domainSolve(patches.domains, zero, u, patches.gamma);
+	solver.domainTraceSolve(patches.domains, u_trace, patches.gamma);
+
+	double *u_view, *u_trace_view;
+	VecGetArray(u, &u_view);
+	VecGetArray(u_trace, &u_trace_view);
+	int            patch_size = pow(n, D);
+	int            face_size  = pow(n, D - 1);
+	vector<double> face(face_size), face_trace(face_size);
+	for (SchurDomain<D> &sd : patches.domains) {
+		for (Side<D> s : Side<D>::getValues()) {
+			if (!sd.hasNbr(s)) { continue; }
+			Utils::copyFromFace<D>(u_view + sd.local_index * patch_size, n, s, &face[0]);
+			Utils::copyFromFace<D>(u_trace_view + sd.local_index * patch_size, n, s,
+			                       &face_trace[0]);
+			for (int i = 0; i < face_size; i++) {
+				REQUIRE(face_trace[i] == Approx(face[i]).margin(1e-10));
+			}
+		}
+	}
+	VecRestoreArray(u, &u_view);
+	VecRestoreArray(u_trace, &u_trace_view);
+}
+template <size_t D> static void checkTraces()
+{
+	// every patch has an interface, and a mix of dirichlet and neumann sides
+	MixedPatches<D> patches(6, 1);
+	SECTION("FftwPatchSolver")
+	{
+		FftwPatchSolver<D> solver(patches.dc);
+		checkTrace(solver, patches);
+	}
+	SECTION("FftwPatchSolver with compiled kernels")
+	{
+		MixedPatches<D>    patches_8(8, 1);
+		FftwPatchSolver<D> solver(patches_8.dc);
+		checkTrace(solver, patches_8);
+	}
+	SECTION("default full solve")
+	{
+		DftPatchSolver<D> solver(patches.dc);
+		checkTrace(solver, patches);
+	}
+}
+TEST_CASE("domainTraceSolve agrees with domainSolve next to the interfaces", "[PatchSolver]")
+{
+	SECTION("2D")
+	{
+		checkTraces<2>();
+	}
+	SECTION("3D")
+	{
+		checkTraces<3>();
+	}
+}
@@ -0,0 +1,56 @@
+#include "../BalancedLevelsGenerator.h"
+#include "../PatchSolvers/DftPatchSolver.h"
+#include "../SchurHelper.h"
+#include "catch.hpp"
+#include <set>
+using namespace std;
+/**
+ * @brief Check that the patches of each color of a table never interpolate to the same interface
+ * value, and that every patch has exactly one color
+ */
+template <size_t D> static void checkColors(const PatchTable<D> &table)
+{
+	vector<int> num_colors(table.size(), 0);
+	for (int color = 0; color < table.getNumColors(); color++) {
+		set<int> ifaces;
+		for (int patch : table.getColorPatches(color)) {
+			num_colors[patch]++;
+			// the interfaces of a patch that has a coarse neighbor can be listed more than once
+			set<int> patch_ifaces;
+			for (int i = table.interpBegin(patch); i < table.interpEnd(patch); i++) {
+				patch_ifaces.insert(table.getInterpLocalIndex(i));
+			}
+			for (int local_index : patch_ifaces) {
+				INFO("color " << color << " patch " << patch << " interface " << local_index);
+				REQUIRE(ifaces.count(local_index) == 0);
+				ifaces.insert(local_index);
+			}
+		}
+	}
+	for (int patch = 0; patch < table.size(); patch++) {
+		REQUIRE(num_colors[patch] == 1);
+	}
+}
+template <size_t D> static void checkRefinedMesh(Tree<D> t)
+{
+	int                        n = 4;
+	BalancedLevelsGenerator<D> blg(t, n);
+	DomainCollection<D>        dc(blg.levels[t.num_levels - 1], n);
+	// the op and interpolator are not needed for the table
+	shared_ptr<PatchSolver<D>> solver(new DftPatchSolver<D>(dc));
+	SchurHelper<D>             sch(dc, solver, nullptr, nullptr);
+
+	const PatchTable<D> &table = sch.getPatchTable();
+	REQUIRE(table.size() == (int) dc.domains.size());
+	// a refined mesh needs more colors than the two of a checkerboard
+	CHECK(table.getNumColors() > 2);
+	checkColors(table);
+}
+TEST_CASE("PatchTable colors on a refined 2D mesh", "[PatchTable]")
+{
+	checkRefinedMesh(Tree<2>("2d2ref.bin"));
+}
+TEST_CASE("PatchTable colors on a refined 3D mesh", "[PatchTable]")
+{
+	checkRefinedMesh(Tree<3>("2refine.bin"));
+}
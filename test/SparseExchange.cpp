@@ -0,0 +1,116 @@
+#include "../SparseExchange.h"
+#include "catch.hpp"
+using namespace std;
+// these run on any number of ranks, run the tests with mpirun to cover more than a self send
+TEST_CASE("sparseExchange with nothing to send", "[SparseExchange]")
+{
+	map<int, vector<int>> sends;
+	map<int, vector<int>> recvs = Utils::sparseExchange(sends);
+	CHECK(recvs.empty());
+}
+TEST_CASE("sparseExchange sends to the same rank", "[SparseExchange]")
+{
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	map<int, vector<int>> sends;
+	sends[rank] = {rank, 1, 2, 3};
+	map<int, vector<int>> recvs = Utils::sparseExchange(sends);
+	REQUIRE(recvs.size() == 1);
+	CHECK(recvs[rank] == sends[rank]);
+}
+/**
+ * @brief the values that src sends to dest, even ranks send to the next rank and three ranks on,
+ * odd ranks only send to rank 0, and the sizes differ between pairs
+ */
+static vector<int> getMessage(int src, int dest, int size)
+{
+	vector<int> message;
+	bool        sends;
+	if (src % 2 == 0) {
+		sends = dest == (src + 1) % size || dest == (src + 3) % size;
+	} else {
+		sends = dest == 0;
+	}
+	if (sends) {
+		for (int i = 0; i < src + dest + 1; i++) {
+			message.push_back(src * 1000 + dest * 10 + i);
+		}
+	}
+	return message;
+}
+TEST_CASE("sparseExchange with an asymmetric pattern", "[SparseExchange]")
+{
+	int rank, size;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	map<int, vector<int>> sends;
+	for (int dest = 0; dest < size; dest++) {
+		vector<int> message = getMessage(rank, dest, size);
+		if (!message.empty()) { sends[dest] = message; }
+	}
+	map<int, vector<int>> expected;
+	for (int src = 0; src < size; src++) {
+		vector<int> message = getMessage(src, rank, size);
+		if (!message.empty()) { expected[src] = message; }
+	}
+	CHECK(Utils::sparseExchange(sends) == expected);
+}
+TEST_CASE("sparseExchange keeps consecutive exchanges apart", "[SparseExchange]")
+{
+	int rank, size;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	MPI_Comm dup;
+	MPI_Comm_dup(MPI_COMM_WORLD, &dup);
+	for (int i = 0; i < 10; i++) {
+		// every rank sends to the next rank in one exchange, and to the previous one in the next
+		int                   dest = (rank + (i % 2 == 0 ? 1 : size - 1)) % size;
+		int                   src  = (rank + (i % 2 == 0 ? size - 1 : 1)) % size;
+		MPI_Comm              comm = i % 3 == 0 ? dup : MPI_COMM_WORLD;
+		map<int, vector<int>> sends;
+		sends[dest]                 = {i, rank};
+		map<int, vector<int>> recvs = Utils::sparseExchange(sends, comm);
+		REQUIRE(recvs.size() == 1);
+		CHECK(recvs[src] == vector<int>({i, src}));
+	}
+	MPI_Comm_free(&dup);
+}
+TEST_CASE("sparseExchange sends empty buffers", "[SparseExchange]")
+{
+	int rank, size;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	map<int, vector<char>> sends;
+	sends[(rank + 1) % size];
+	map<int, vector<char>> recvs = Utils::sparseExchange(sends);
+	REQUIRE(recvs.size() == 1);
+	CHECK(recvs[(rank + size - 1) % size].empty());
+}
+TEST_CASE("sparseLookup finds keys that are owned by any rank", "[SparseExchange]")
+{
+	int rank, size;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	// each rank owns a few keys that are not registered on it, and wants the keys of the next rank
+	// and some of its own
+	int           num_keys = 5;
+	map<int, int> owned;
+	vector<int>   wanted;
+	for (int i = 0; i < num_keys; i++) {
+		int key    = rank * num_keys + i;
+		owned[key] = 10 * key + 7;
+		wanted.push_back(((rank + 1) % size) * num_keys + i);
+	}
+	wanted.push_back(rank * num_keys);
+	map<int, int> values = Utils::sparseLookup(owned, wanted);
+	CHECK(values.size() == (size == 1 ? num_keys : num_keys + 1));
+	for (int key : wanted) {
+		REQUIRE(values.count(key) == 1);
+		CHECK(values[key] == 10 * key + 7);
+	}
+}
+TEST_CASE("sparseLookup with nothing owned or wanted", "[SparseExchange]")
+{
+	map<int, int> values = Utils::sparseLookup(map<int, int>(), vector<int>());
+	CHECK(values.empty());
+}
@@ -1,64 +1,206 @@
 #include "../Utils.h"
 #include "catch.hpp"
+#include <vector>
 using namespace std;
-TEST_CASE("getSlice getNbrType works", "[Domain]")
+TEST_CASE("FaceView indexes every side of a cube", "[Domain]")
 {
 	vector<double> cube(4 * 4 * 4);
 	for (int i = 0; i < 4 * 4 * 4; i++) {
 		cube[i] = i;
 	}
 	{
-		auto slice = Utils::getSlice<2>(&cube[0], 4, Side<3>::bottom);
+		Utils::FaceView<3, Side<3>::bottom, 0> face(&cube[0], 4);
 		for (int xi = 0; xi < 4; xi++) {
 			for (int yi = 0; yi < 4; yi++) {
-				std::array<int, 2> coords = {{xi, yi}};
-				CHECK(slice(coords) == xi + yi * 4);
+				CHECK(face(xi, yi) == xi + yi * 4);
 			}
 		}
 	}
 	{
-		auto slice = Utils::getSlice<2>(&cube[0], 4, Side<3>::top);
+		Utils::FaceView<3, Side<3>::top, 0> face(&cube[0], 4);
 		for (int xi = 0; xi < 4; xi++) {
 			for (int yi = 0; yi < 4; yi++) {
-				std::array<int, 2> coords = {{xi, yi}};
-				CHECK(slice(coords) == 4 * 4 * 3 + xi + yi * 4);
+				CHECK(face(xi, yi) == 4 * 4 * 3 + xi + yi * 4);
 			}
 		}
 	}
 	{
-		auto slice = Utils::getSlice<2>(&cube[0], 4, Side<3>::west);
+		Utils::FaceView<3, Side<3>::west, 0> face(&cube[0], 4);
 		for (int xi = 0; xi < 4; xi++) {
 			for (int yi = 0; yi < 4; yi++) {
-				std::array<int, 2> coords = {{xi, yi}};
-				CHECK(slice(coords) == xi*4 + yi * 4*4);
+				CHECK(face(xi, yi) == xi*4 + yi * 4*4);
 			}
 		}
 	}
 	{
-		auto slice = Utils::getSlice<2>(&cube[0], 4, Side<3>::east);
+		Utils::FaceView<3, Side<3>::east, 0> face(&cube[0], 4);
 		for (int xi = 0; xi < 4; xi++) {
 			for (int yi = 0; yi < 4; yi++) {
-				std::array<int, 2> coords = {{xi, yi}};
-				CHECK(slice(coords) ==3+ xi*4 + yi * 4*4);
+				CHECK(face(xi, yi) ==3+ xi*4 + yi * 4*4);
 			}
 		}
 	}
 	{
-		auto slice = Utils::getSlice<2>(&cube[0], 4, Side<3>::south);
+		Utils::FaceView<3, Side<3>::south, 0> face(&cube[0], 4);
 		for (int xi = 0; xi < 4; xi++) {
 			for (int yi = 0; yi < 4; yi++) {
-				std::array<int, 2> coords = {{xi, yi}};
-				CHECK(slice(coords) == xi + yi * 4*4);
+				CHECK(face(xi, yi) == xi + yi * 4*4);
 			}
 		}
 	}
 	{
-		auto slice = Utils::getSlice<2>(&cube[0], 4, Side<3>::north);
+		Utils::FaceView<3, Side<3>::north, 0> face(&cube[0], 4);
 		for (int xi = 0; xi < 4; xi++) {
 			for (int yi = 0; yi < 4; yi++) {
-				std::array<int, 2> coords = {{xi, yi}};
-				CHECK(slice(coords) == 4*3+xi + yi * 4*4);
+				CHECK(face(xi, yi) == 4*3+xi + yi * 4*4);
 			}
 		}
 	}
 }
+TEST_CASE("FaceView indexes every side of a square", "[Utils]")
+{
+	vector<double> square(4 * 4);
+	for (int i = 0; i < 4 * 4; i++) {
+		square[i] = i;
+	}
+	{
+		Utils::FaceView<2, Side<2>::west, 0> face(&square[0], 4);
+		for (int xi = 0; xi < 4; xi++) {
+			CHECK(face(xi) == xi * 4);
+		}
+	}
+	{
+		Utils::FaceView<2, Side<2>::east, 0> face(&square[0], 4);
+		for (int xi = 0; xi < 4; xi++) {
+			CHECK(face(xi) == 3 + xi * 4);
+		}
+	}
+	{
+		Utils::FaceView<2, Side<2>::south, 0> face(&square[0], 4);
+		for (int xi = 0; xi < 4; xi++) {
+			CHECK(face(xi) == xi);
+		}
+	}
+	{
+		Utils::FaceView<2, Side<2>::north, 0> face(&square[0], 4);
+		for (int xi = 0; xi < 4; xi++) {
+			CHECK(face(xi) == 4 * 3 + xi);
+		}
+	}
+}
+/**
+ * @brief Checks that the iterator of a FaceView visits the same cells as operator(), in order
+ */
+template <size_t D, int N> struct IteratorCheck {
+	double *patch;
+	int     n;
+	template <int S> void visit()
+	{
+		Utils::FaceView<D, S, N> face(patch, n);
+		vector<double *>         cells;
+		for (double &cell : face) {
+			cells.push_back(&cell);
+		}
+		REQUIRE(cells.size() == (size_t) face.size());
+		if (D == 2) {
+			for (int xi = 0; xi < n; xi++) {
+				CHECK(cells[xi] == &face(xi));
+			}
+		} else {
+			for (int yi = 0; yi < n; yi++) {
+				for (int xi = 0; xi < n; xi++) {
+					CHECK(cells[xi + yi * n] == &face(xi, yi));
+				}
+			}
+		}
+	}
+};
+template <size_t D, int N> void checkIterator(int n)
+{
+	int size = 1;
+	for (size_t i = 0; i < D; i++) {
+		size *= n;
+	}
+	vector<double>      patch(size);
+	IteratorCheck<D, N> check = {&patch[0], n};
+	for (Side<D> s : Side<D>::getValues()) {
+		Utils::visitSide(s, check);
+	}
+}
+TEST_CASE("FaceView iterator visits the cells in the order of operator()", "[Utils]")
+{
+	checkIterator<2, 0>(4);
+	checkIterator<2, 0>(5);
+	checkIterator<2, 4>(4);
+	checkIterator<3, 0>(4);
+	checkIterator<3, 0>(5);
+	checkIterator<3, 4>(4);
+}
+/**
+ * @brief The index in the patch of cell i of a side, with the other axes in order and the lowest
+ * axis the fastest
+ */
+template <size_t D> int faceCellIndex(int n, Side<D> s, int i)
+{
+	int axis   = s.toInt() / 2;
+	int index  = 0;
+	int stride = 1;
+	for (size_t a = 0; a < D; a++) {
+		if ((int) a == axis) {
+			index += (s.isLowerOnAxis() ? 0 : n - 1) * stride;
+		} else {
+			index += (i % n) * stride;
+			i /= n;
+		}
+		stride *= n;
+	}
+	return index;
+}
+template <size_t D, int N> void checkFaceCopies(int n)
+{
+	int size      = 1;
+	int face_size = 1;
+	for (size_t i = 0; i < D; i++) {
+		size *= n;
+	}
+	for (size_t i = 0; i < D - 1; i++) {
+		face_size *= n;
+	}
+	for (Side<D> s : Side<D>::getValues()) {
+		INFO("side " << s.toInt());
+		vector<double> patch(size);
+		for (int i = 0; i < size; i++) {
+			patch[i] = i;
+		}
+		vector<double> values(face_size);
+		Utils::copyFromFace<D, N>(&patch[0], n, s, &values[0]);
+		for (int i = 0; i < face_size; i++) {
+			CHECK(values[i] == faceCellIndex<D>(n, s, i));
+		}
+
+		for (int i = 0; i < face_size; i++) {
+			values[i] = -1 - i;
+		}
+		Utils::copyToFace<D, N>(&patch[0], n, s, &values[0]);
+		Utils::addToFace<D, N>(&patch[0], n, s, 2.0, &values[0]);
+		vector<bool> on_face(size, false);
+		for (int i = 0; i < face_size; i++) {
+			int index      = faceCellIndex<D>(n, s, i);
+			on_face[index] = true;
+			CHECK(patch[index] == 3 * values[i]);
+		}
+		// the rest of the patch is untouched
+		for (int i = 0; i < size; i++) {
+			if (!on_face[i]) { CHECK(patch[i] == i); }
+		}
+	}
+}
+TEST_CASE("copyFromFace, copyToFace, and addToFace use every side in FaceView order", "[Utils]")
+{
+	checkFaceCopies<2, 0>(4);
+	checkFaceCopies<2, 0>(5);
+	checkFaceCopies<2, 4>(4);
+	checkFaceCopies<3, 0>(4);
+	checkFaceCopies<3, 0>(5);
+	checkFaceCopies<3, 4>(4);
+}